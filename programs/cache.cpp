@@ -0,0 +1,420 @@
+#include "cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace chime {
+namespace cache {
+
+// File name suffix of cache entries.
+const std::string kSuffix = ".chime";
+
+// Layout version. Must be bumped whenever the entry layout changes.
+constexpr std::uint32_t kVersion = 1;
+
+// Fixed size entry header. Metadata and payload follow, each starting at a
+// multiple of 64 bytes.
+struct EntryHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t key;
+  std::uint64_t metadata_size;
+  std::uint64_t payload_size;
+  std::uint64_t checksum;
+  char padding[16];
+};
+static_assert(sizeof(EntryHeader) == 64, "unexpected header size");
+
+const char kMagic[8] = {'C', 'H', 'I', 'M', 'E', 'C', 'E', '\0'};
+
+std::size_t RoundUp64(const std::size_t& size) { return (size + 63) & ~63ul; }
+
+std::string DefaultCacheDirectory()
+{
+  const char* xdg = std::getenv("XDG_CACHE_HOME");
+  if ((xdg != nullptr) && (*xdg != '\0')) {
+    return std::string(xdg) + "/chime";
+  }
+  const char* home = std::getenv("HOME");
+  if ((home != nullptr) && (*home != '\0')) {
+    return std::string(home) + "/.cache/chime";
+  }
+  return ".chime-cache";
+}
+
+std::uint64_t Hash64(const void* data, const std::size_t& size,
+                     const std::uint64_t& seed)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  std::uint64_t hash = seed;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//////////////////////////////// KeyBuilder ///////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+KeyBuilder::KeyBuilder(const std::string& kind)
+    : kind_(kind), hash_(Hash64(kind.data(), kind.size()))
+{
+  const std::uint32_t version = kVersion;
+  hash_ = Hash64(&version, sizeof(version), hash_);
+}
+
+KeyBuilder& KeyBuilder::Add(const int& value)
+{
+  const std::int64_t wide = value;
+  hash_ = Hash64(&wide, sizeof(wide), hash_);
+  return *this;
+}
+
+KeyBuilder& KeyBuilder::Add(const double& value)
+{
+  hash_ = Hash64(&value, sizeof(value), hash_);
+  return *this;
+}
+
+KeyBuilder& KeyBuilder::Add(const std::string& value)
+{
+  Add(int(value.size()));
+  hash_ = Hash64(value.data(), value.size(), hash_);
+  return *this;
+}
+
+KeyBuilder& KeyBuilder::Add(const std::vector<int>& values)
+{
+  Add(int(values.size()));
+  for (const int& value : values) {
+    Add(value);
+  }
+  return *this;
+}
+
+std::string KeyBuilder::str() const
+{
+  std::ostringstream stream;
+  stream << kind_ << "-" << std::hex << std::setw(16) << std::setfill('0')
+         << hash_;
+  return stream.str();
+}
+
+///////////////////////////////////////////////////////////////////////////
+//////////////////////////////// MappedFile ///////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat info;
+  if ((fstat(fd, &info) != 0) || (info.st_size == 0)) {
+    close(fd);
+    return nullptr;
+  }
+  const std::size_t size = info.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::shared_ptr<const MappedFile>(
+      new MappedFile(static_cast<const char*>(data), size));
+}
+
+MappedFile::~MappedFile()
+{
+  munmap(const_cast<char*>(data_), size_);
+}
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////// Entries /////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+// Creates directory `path` and its parents. Returns false on failure.
+bool MakeDirectories(const std::string& path)
+{
+  std::string partial;
+  std::istringstream stream(path);
+  std::string component;
+  if (!path.empty() && (path[0] == '/')) {
+    partial = "/";
+  }
+  while (std::getline(stream, component, '/')) {
+    if (component.empty()) {
+      continue;
+    }
+    partial += component + "/";
+    if ((mkdir(partial.c_str(), 0755) != 0) && (errno != EEXIST)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string EntryPath(const CacheParameters& params, const KeyBuilder& key)
+{
+  return params.directory + "/" + key.str() + kSuffix;
+}
+
+// Entries kept in process memory, by entry path, with their size in bytes
+// and their position in the use order, most recently used first.
+struct MemoryEntry {
+  Entry entry;
+  std::size_t bytes;
+  std::list<std::string>::iterator use;
+};
+std::mutex memory_mutex;
+std::map<std::string, MemoryEntry> memory_entries;
+std::list<std::string> memory_use_order;
+std::size_t memory_bytes = 0;
+
+bool LoadMemoryEntry(const std::string& path, Entry& entry)
+{
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  const auto it = memory_entries.find(path);
+  if (it == memory_entries.end()) {
+    return false;
+  }
+  memory_use_order.splice(memory_use_order.begin(), memory_use_order,
+                          it->second.use);
+  entry = it->second.entry;
+  return true;
+}
+
+// Keeps `entry` in memory, and drops the least recently used entries until
+// the entries in memory hold at most `max_bytes`. Entries still in use stay
+// valid, as their payload is owned by the entry.
+void KeepInMemory(const std::string& path, const Entry& entry,
+                  const std::size_t& max_bytes)
+{
+  const std::size_t bytes = entry.metadata.size() * sizeof(std::int64_t)
+                            + entry.payload_size * sizeof(double);
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  const auto it = memory_entries.find(path);
+  if (it != memory_entries.end()) {
+    memory_bytes -= it->second.bytes;
+    memory_use_order.erase(it->second.use);
+    memory_entries.erase(it);
+  }
+  if (bytes > max_bytes) {
+    return;
+  }
+  while (memory_bytes + bytes > max_bytes) {
+    const auto oldest = memory_entries.find(memory_use_order.back());
+    memory_bytes -= oldest->second.bytes;
+    memory_entries.erase(oldest);
+    memory_use_order.pop_back();
+  }
+  memory_use_order.push_front(path);
+  memory_entries[path] = {entry, bytes, memory_use_order.begin()};
+  memory_bytes += bytes;
+}
+
+std::uint64_t EntryChecksum(const std::vector<std::int64_t>& metadata,
+                            const double* payload,
+                            const std::size_t& payload_size)
+{
+  std::uint64_t checksum =
+      Hash64(metadata.data(), metadata.size() * sizeof(std::int64_t));
+  return Hash64(payload, payload_size * sizeof(double), checksum);
+}
+
+bool LoadEntry(const CacheParameters& params, const KeyBuilder& key,
+               Entry& entry)
+{
+  const std::string path = EntryPath(params, key);
+  if (params.memory && LoadMemoryEntry(path, entry)) {
+    return true;
+  }
+  if (!params.enabled) {
+    return false;
+  }
+  std::shared_ptr<const MappedFile> mapping = MappedFile::Open(path);
+  if (!mapping) {
+    return false;
+  }
+
+  // Validate header.
+  if (mapping->size() < sizeof(EntryHeader)) {
+    return false;
+  }
+  EntryHeader header;
+  std::memcpy(&header, mapping->data(), sizeof(header));
+  const std::size_t metadata_offset = sizeof(EntryHeader);
+  const std::size_t payload_offset =
+      metadata_offset
+      + RoundUp64(header.metadata_size * sizeof(std::int64_t));
+  if ((std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+      || (header.version != kVersion) || (header.key != key.hash())
+      || (mapping->size()
+          != payload_offset + header.payload_size * sizeof(double))) {
+    std::cout << "  Ignoring malformed cache entry " << path << "\n";
+    return false;
+  }
+
+  // Validate checksum.
+  std::vector<std::int64_t> metadata(header.metadata_size);
+  std::memcpy(metadata.data(), mapping->data() + metadata_offset,
+              metadata.size() * sizeof(std::int64_t));
+  const double* payload =
+      reinterpret_cast<const double*>(mapping->data() + payload_offset);
+  if (EntryChecksum(metadata, payload, header.payload_size)
+      != header.checksum) {
+    std::cout << "  Ignoring corrupted cache entry " << path << "\n";
+    return false;
+  }
+
+  // Mark as recently used.
+  utime(path.c_str(), nullptr);
+
+  entry.metadata = std::move(metadata);
+  entry.payload = payload;
+  entry.payload_size = header.payload_size;
+  entry.owner = std::move(mapping);
+  if (params.memory) {
+    KeepInMemory(path, entry, params.max_bytes);
+  }
+  return true;
+}
+
+bool StoreEntry(const CacheParameters& params, const KeyBuilder& key,
+                const std::vector<std::int64_t>& metadata,
+                const double* payload, const std::size_t& payload_size)
+{
+  const std::string path = EntryPath(params, key);
+  if (params.memory) {
+    auto copy =
+        std::make_shared<std::vector<double>>(payload, payload + payload_size);
+    Entry entry;
+    entry.metadata = metadata;
+    entry.payload = copy->data();
+    entry.payload_size = payload_size;
+    entry.owner = std::move(copy);
+    KeepInMemory(path, entry, params.max_bytes);
+  }
+  if (!params.enabled) {
+    return params.memory;
+  }
+  const std::size_t metadata_bytes = metadata.size() * sizeof(std::int64_t);
+  const std::size_t payload_bytes = payload_size * sizeof(double);
+  if (sizeof(EntryHeader) + RoundUp64(metadata_bytes) + payload_bytes
+      > params.max_bytes) {
+    return false;
+  }
+  if (!MakeDirectories(params.directory)) {
+    std::cout << "  Cannot create cache directory " << params.directory
+              << "\n";
+    return false;
+  }
+
+  EntryHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.key = key.hash();
+  header.metadata_size = metadata.size();
+  header.payload_size = payload_size;
+  header.checksum = EntryChecksum(metadata, payload, payload_size);
+
+  // Unique per thread, as jobs of a batch may store the same entry.
+  const std::size_t thread_hash =
+      std::hash<std::thread::id>()(std::this_thread::get_id());
+  const std::string temporary_path = path + ".tmp" + std::to_string(getpid())
+                                     + "." + std::to_string(thread_hash);
+  {
+    std::ofstream file(temporary_path, std::ios::binary);
+    const std::vector<char> padding(
+        RoundUp64(metadata_bytes) - metadata_bytes, 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(metadata.data()),
+               metadata_bytes);
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(payload), payload_bytes);
+    if (!file.good()) {
+      std::remove(temporary_path.c_str());
+      std::cout << "  Cannot write cache entry " << path << "\n";
+      return false;
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    std::remove(temporary_path.c_str());
+    return false;
+  }
+
+  EnforceSizeLimit(params);
+  return true;
+}
+
+void EnforceSizeLimit(const CacheParameters& params)
+{
+  struct CachedFile {
+    std::string path;
+    std::size_t size;
+    time_t mtime;
+  };
+  std::vector<CachedFile> files;
+  std::size_t total_size = 0;
+
+  DIR* directory = opendir(params.directory.c_str());
+  if (directory == nullptr) {
+    return;
+  }
+  while (const dirent* file_entry = readdir(directory)) {
+    const std::string name = file_entry->d_name;
+    if ((name.size() <= kSuffix.size())
+        || (name.compare(name.size() - kSuffix.size(), kSuffix.size(),
+                         kSuffix)
+            != 0)) {
+      continue;
+    }
+    const std::string path = params.directory + "/" + name;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+      files.push_back({path, std::size_t(info.st_size), info.st_mtime});
+      total_size += info.st_size;
+    }
+  }
+  closedir(directory);
+
+  // Delete least recently used entries first.
+  std::sort(files.begin(), files.end(),
+            [](const CachedFile& a, const CachedFile& b) {
+              return a.mtime < b.mtime;
+            });
+  for (const auto& file : files) {
+    if (total_size <= params.max_bytes) {
+      break;
+    }
+    if (std::remove(file.path.c_str()) == 0) {
+      total_size -= file.size;
+    }
+  }
+}
+
+}  // namespace cache
+}  // namespace chime
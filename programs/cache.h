@@ -0,0 +1,128 @@
+/*******************************************************************************
+ cache.h
+
+ Defines a local on-disk cache for precomputed tables. Entries are content
+ addressed: the file name is a hash of everything the table depends on. Each
+ entry carries a header with its key, a small integer metadata record
+ describing the shape of the table, and a checksum of metadata and payload.
+ Entries are memory mapped read-only when loaded.
+
+ The total size of the cache directory is kept below a limit by deleting the
+ least recently used entries.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace chime {
+namespace cache {
+
+// Parameters controlling the use of the cache.
+struct CacheParameters {
+  bool enabled = false;
+  std::string directory;
+  std::size_t max_bytes = std::size_t(4) << 30;  // 4 GiB
+
+  // Also keep loaded and stored entries in process memory, up to
+  // `max_bytes` with the least recently used entries dropped first, so that
+  // later loads in the same process skip the file system. Works with or
+  // without the on-disk cache.
+  bool memory = false;
+};
+
+// Default cache directory, $XDG_CACHE_HOME/chime or $HOME/.cache/chime.
+std::string DefaultCacheDirectory();
+
+// Calculates the 64 bit FNV-1a hash of `size` bytes.
+std::uint64_t Hash64(const void* data, const std::size_t& size,
+                     const std::uint64_t& seed = 14695981039346656037ULL);
+
+// Accumulates the parameters a table depends on into a cache key. Doubles
+// are hashed by their exact bit pattern.
+class KeyBuilder {
+ public:
+  explicit KeyBuilder(const std::string& kind);
+
+  KeyBuilder& Add(const int& value);
+  KeyBuilder& Add(const double& value);
+  KeyBuilder& Add(const std::string& value);
+  KeyBuilder& Add(const std::vector<int>& values);
+
+  // Kind of table, used as file name prefix.
+  const std::string& kind() const { return kind_; }
+
+  // Hash of all added parameters.
+  std::uint64_t hash() const { return hash_; }
+
+  // File name stem, e.g. "radial-0123456789abcdef".
+  std::string str() const;
+
+ private:
+  std::string kind_;
+  std::uint64_t hash_;
+};
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  // Maps the file at `path`. Returns nullptr if the file cannot be mapped.
+  static std::shared_ptr<const MappedFile> Open(const std::string& path);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  MappedFile(const char* data, const std::size_t& size)
+      : data_(data), size_(size)
+  {
+  }
+
+  const char* data_;
+  std::size_t size_;
+};
+
+// A loaded cache entry. The payload points into the file mapping or the
+// in-memory copy held by `owner`, which must be kept alive as long as the
+// payload is used.
+struct Entry {
+  std::vector<std::int64_t> metadata;
+  const double* payload = nullptr;
+  std::size_t payload_size = 0;  // number of doubles
+  std::shared_ptr<const void> owner;
+};
+
+// Loads the entry with key `key`. Returns false if caching is disabled, the
+// entry does not exist, or it fails the integrity checks.
+bool LoadEntry(const CacheParameters& params, const KeyBuilder& key,
+               Entry& entry);
+
+// Stores an entry with key `key`, and evicts least recently used entries to
+// respect the size limit. Returns false if caching is disabled or the entry
+// could not be written. The entry is written to a temporary file and renamed,
+// so that concurrent runs never see partial entries.
+bool StoreEntry(const CacheParameters& params, const KeyBuilder& key,
+                const std::vector<std::int64_t>& metadata,
+                const double* payload, const std::size_t& payload_size);
+
+// Deletes least recently used entries until the cache directory holds at
+// most `params.max_bytes`.
+void EnforceSizeLimit(const CacheParameters& params);
+
+}  // namespace cache
+}  // namespace chime
+
+#endif
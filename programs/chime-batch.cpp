@@ -0,0 +1,441 @@
+/*******************************************************************************
+ chime-batch.cpp
+
+ Runs a batch of operator calculations in one process.
+
+ Usage:
+   chime-batch [--jobs=N] [radial options] job.ini...
+
+ The radial options are those of relative-gen, see options.h, except
+ --plan, --calibration, --sector-file, --compress and --lab-frame, which
+ apply to single runs. --jobs sets the number of jobs run concurrently
+ (default 1); the OpenMP threads are divided among them. With --numa, the
+ workers are assigned to the NUMA nodes round robin, each with its share of
+ the CPUs of its node.
+
+ Job files (see the .ini files in input/):
+   key = value lines, with # or ; comments. Keys before the first [section]
+   are defaults; each [section] describes one job, and a file without
+   sections describes a single job. A comma separated value describes a
+   sweep, and a section expands to the cartesian product of its sweeps.
+
+   name        operator, mm (or m1)
+   order       chiral order, lo, nlo or n2lo
+   Abody       1 or 2 body current
+   hw          oscillator energy in MeV
+   Nmax        basis truncation
+   Jmax        relative angular momentum truncation (relative operators)
+   T0_min      isospin components
+   T0_max
+   regularize  true to use the LENPIC SCS regulator
+   regulator   regulator R in fm
+   has_cm      true for relative-cm operators
+   output      output file prefix (default name_order_Abody)
+
+ Each job is written to <output>_<has_cm ? relcm : rel>_Nmax<Nmax>_hw<hw>
+ _R<R>.dat, with the sidecar index <...>.dat.index of its sectors, see
+ partition.h.
+
+ Jobs sharing the harmonic oscillator basis functions, i.e. the basis
+ truncation, are grouped and run in sequence by one worker, in order of hw
+ and R. Cache entries are kept in memory for the whole batch, in addition to
+ the on-disk cache, so that later jobs reuse the basis functions and radial
+ integrals of earlier ones.
+
+ With --report, a run report summed over all jobs is written to
+ chime-batch.report.json, and with --trace, a trace of all jobs to
+ chime-batch.trace.json. With --perf, the hardware counts of the phases of
+ concurrent jobs overlap in the report.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "instrument.h"
+#include "libchime.h"
+#include "numa.h"
+#include "options.h"
+#include "partition.h"
+
+// Parameters of one job.
+struct Job {
+  std::string output;
+  chime::OperatorRequest request;
+  basis::OperatorLabelsJT labels;
+  int Nmax;
+  int Jmax;
+  bool has_cm;
+};
+
+// Outcome of one job.
+struct JobResult {
+  bool success = false;
+  std::string error;
+  std::size_t num_elements = 0;
+  double seconds = 0;
+};
+
+typedef std::map<std::string, std::string> KeyValues;
+
+std::string Trim(const std::string& text)
+{
+  const std::size_t begin = text.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  const std::size_t end = text.find_last_not_of(" \t\r");
+  return text.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string> SplitList(const std::string& value)
+{
+  std::vector<std::string> result;
+  std::istringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(Trim(item));
+  }
+  return result;
+}
+
+// Reads the sections of a job file, each merged with the defaults.
+std::vector<KeyValues> ReadSections(const std::string& filename)
+{
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("cannot open job file " + filename);
+  }
+
+  KeyValues defaults;
+  std::vector<KeyValues> sections;
+  KeyValues* current = &defaults;
+  std::string line;
+  int line_count = 0;
+  while (std::getline(file, line)) {
+    ++line_count;
+    line = Trim(line.substr(0, line.find_first_of("#;")));
+    if (line.empty()) {
+      continue;
+    }
+    if (line.front() == '[') {
+      sections.push_back(defaults);
+      current = &sections.back();
+      continue;
+    }
+    const std::size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      throw std::runtime_error(filename + ":" + std::to_string(line_count)
+                               + ": expected key = value");
+    }
+    (*current)[Trim(line.substr(0, equals))] = Trim(line.substr(equals + 1));
+  }
+  if (sections.empty()) {
+    sections.push_back(defaults);
+  }
+  return sections;
+}
+
+// Expands the sweeps of a section into single valued sections.
+std::vector<KeyValues> ExpandSweeps(const KeyValues& section)
+{
+  std::vector<KeyValues> result{KeyValues()};
+  for (const auto& key_value : section) {
+    std::vector<KeyValues> expanded;
+    for (const std::string& value : SplitList(key_value.second)) {
+      for (KeyValues job : result) {
+        job[key_value.first] = value;
+        expanded.push_back(job);
+      }
+    }
+    result = std::move(expanded);
+  }
+  return result;
+}
+
+template <typename T>
+T GetValue(const KeyValues& values, const std::string& key, const T& fallback)
+{
+  const auto it = values.find(key);
+  if (it == values.end()) {
+    return fallback;
+  }
+  std::istringstream stream(it->second);
+  T result;
+  if (!(stream >> std::boolalpha >> result)) {
+    throw std::runtime_error("invalid value for " + key + ": " + it->second);
+  }
+  return result;
+}
+
+Job MakeJob(const KeyValues& values)
+{
+  Job job;
+  job.request.name = GetValue<std::string>(values, "name", "mm");
+  if (job.request.name == "m1") {
+    job.request.name = "mm";
+  }
+  job.request.order = GetValue<std::string>(values, "order", "nlo");
+  job.request.abody = GetValue<int>(values, "Abody", 2);
+  job.request.hbomega = GetValue<double>(values, "hw", 0);
+  job.request.R = GetValue<bool>(values, "regularize", false)
+                      ? GetValue<double>(values, "regulator", 0)
+                      : 0;
+
+  job.labels.J0 = 1;
+  job.labels.g0 = 0;
+  job.labels.T0_min = GetValue<int>(values, "T0_min", 1);
+  job.labels.T0_max = GetValue<int>(values, "T0_max", 1);
+  job.labels.symmetry_phase_mode = basis::SymmetryPhaseMode::kHermitian;
+  job.Nmax = GetValue<int>(values, "Nmax", 0);
+  job.Jmax = GetValue<int>(values, "Jmax", job.Nmax + 1);
+  job.has_cm = GetValue<bool>(values, "has_cm", false);
+
+  std::ostringstream output;
+  output << GetValue<std::string>(values, "output",
+                                  job.request.name + "_" + job.request.order
+                                      + "_" + std::to_string(job.request.abody))
+         << "_" << (job.has_cm ? "relcm" : "rel") << "_Nmax" << job.Nmax
+         << "_hw" << job.request.hbomega << "_R" << job.request.R << ".dat";
+  job.output = output.str();
+  return job;
+}
+
+// Constructs and writes the operator of `job`.
+JobResult RunJob(const Job& job, const chime::radial::RadialParameters& radial)
+{
+  JobResult result;
+  const auto start = std::chrono::steady_clock::now();
+  try {
+    if (job.has_cm) {
+      basis::RelativeCMOperatorParametersLSJT params;
+      static_cast<basis::OperatorLabelsJT&>(params) = job.labels;
+      params.Nmax = job.Nmax;
+      params.Jmax = job.Jmax;
+      chime::RelativeCMOperator op;
+      chime::ConstructRelativeCMOperator(params, job.request, op, radial);
+      chime::instrument::ScopedPhase phase(
+          chime::instrument::Phase::kWrite);
+      basis::WriteRelativeCMOperatorLSJT(job.output, op.space, op.params,
+                                         op.sectors, op.matrices, true);
+      chime::partition::IndexTextOperator(job.output, op);
+      for (const auto& matrices : op.matrices) {
+        for (const auto& matrix : matrices) {
+          result.num_elements += matrix.size();
+        }
+      }
+    }
+    else {
+      basis::RelativeOperatorParametersLSJT params;
+      static_cast<basis::OperatorLabelsJT&>(params) = job.labels;
+      params.Nmax = job.Nmax;
+      params.Jmax = job.Jmax;
+      chime::RelativeOperator op;
+      chime::ConstructRelativeOperator(params, job.request, op, radial);
+      chime::instrument::ScopedPhase phase(
+          chime::instrument::Phase::kWrite);
+      basis::WriteRelativeOperatorLSJT(job.output, op.space, op.params,
+                                       op.sectors, op.matrices, true);
+      chime::partition::IndexTextOperator(job.output, op);
+      for (const auto& matrices : op.matrices) {
+        for (const auto& matrix : matrices) {
+          result.num_elements += matrix.size();
+        }
+      }
+    }
+    result.success = true;
+  }
+  catch (const std::exception& error) {
+    result.error = error.what();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  // Separate job files and --jobs from the radial options.
+  int num_workers = 1;
+  std::vector<std::string> filenames;
+  std::vector<char*> option_args{argv[0]};
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 7, "--jobs=") == 0) {
+      num_workers = std::atoi(arg.c_str() + 7);
+      if (num_workers <= 0) {
+        std::cerr << argv[0] << ": invalid value for --jobs: " << arg << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+    else if (arg.compare(0, 2, "--") == 0) {
+      option_args.push_back(argv[i]);
+    }
+    else {
+      filenames.push_back(arg);
+    }
+  }
+  chime::RunOptions run_options =
+      chime::ParseRunOptions(int(option_args.size()), option_args.data());
+  if (run_options.plan) {
+    std::cerr << argv[0]
+              << ": --plan and --calibration apply to single runs only\n";
+    return EXIT_FAILURE;
+  }
+  if (run_options.sector_file || run_options.lab_frame) {
+    std::cerr << argv[0] << ": --sector-file, --compress and --lab-frame"
+              << " apply to single runs only\n";
+    return EXIT_FAILURE;
+  }
+  run_options.radial.cache.memory = true;
+  // Hardware counters are inherited only by threads created after they are
+  // opened, so they are opened before any OpenMP region.
+  if (run_options.perf) {
+    if (!chime::instrument::EnablePerf()) {
+      std::cerr << "WARNING: hardware performance counters unavailable\n";
+    }
+  }
+  else if (run_options.report) {
+    chime::instrument::Enable();
+  }
+  if (run_options.trace) {
+    chime::instrument::EnableTracing();
+  }
+  const chime::numa::Topology topology = chime::numa::ReadTopology();
+  if (run_options.numa && !chime::numa::Enable(topology)) {
+    std::cerr << "WARNING: threads could not be pinned\n";
+  }
+  if (filenames.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--jobs=N] [radial options] job.ini...\n";
+    return EXIT_FAILURE;
+  }
+
+  // Read jobs.
+  std::vector<Job> jobs;
+  try {
+    for (const std::string& filename : filenames) {
+      for (const KeyValues& section : ReadSections(filename)) {
+        for (const KeyValues& values : ExpandSweeps(section)) {
+          jobs.push_back(MakeJob(values));
+        }
+      }
+    }
+  }
+  catch (const std::exception& error) {
+    std::cerr << argv[0] << ": " << error.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  // Group jobs by basis truncation, ordered by hw and R within a group.
+  std::map<std::tuple<bool, int, int>, std::vector<std::size_t>> groups_by_key;
+  for (std::size_t job_index = 0; job_index < jobs.size(); ++job_index) {
+    const Job& job = jobs[job_index];
+    groups_by_key[std::make_tuple(job.has_cm, job.Nmax,
+                                  job.has_cm ? 0 : job.Jmax)]
+        .push_back(job_index);
+  }
+  std::vector<std::vector<std::size_t>> groups;
+  for (auto& key_group : groups_by_key) {
+    std::vector<std::size_t>& group = key_group.second;
+    std::stable_sort(group.begin(), group.end(),
+                     [&](const std::size_t& a, const std::size_t& b) {
+                       return std::make_tuple(jobs[a].request.hbomega,
+                                              jobs[a].request.R)
+                              < std::make_tuple(jobs[b].request.hbomega,
+                                                jobs[b].request.R);
+                     });
+    groups.push_back(group);
+  }
+  num_workers = std::min<int>(num_workers, groups.size());
+  std::cout << "Running " << jobs.size() << " jobs in " << groups.size()
+            << " groups on " << num_workers << " workers\n";
+
+  // Run groups on a pool of workers.
+  int threads_per_worker = 1;
+#ifdef _OPENMP
+  threads_per_worker = std::max(1, omp_get_max_threads() / num_workers);
+#endif
+  std::vector<JobResult> results(jobs.size());
+  std::atomic<std::size_t> next_group(0);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int worker = 0; worker < num_workers; ++worker) {
+    workers.emplace_back([&, worker]() {
+#ifdef _OPENMP
+      omp_set_num_threads(threads_per_worker);
+#endif
+      // Each worker's threads on its share of the CPUs.
+      if (chime::numa::Enabled()) {
+        chime::numa::PinThreads(
+            chime::numa::Share(topology, worker, num_workers));
+      }
+      for (std::size_t group_index = next_group++; group_index < groups.size();
+           group_index = next_group++) {
+        for (const std::size_t job_index : groups[group_index]) {
+          results[job_index] = RunJob(jobs[job_index], run_options.radial);
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // Throughput summary.
+  int num_failed = 0;
+  std::size_t num_elements = 0;
+  double job_seconds = 0;
+  std::cout << "\n"
+            << std::setw(6) << "job" << std::setw(12) << "seconds"
+            << std::setw(14) << "elements" << "  output\n";
+  for (std::size_t job_index = 0; job_index < jobs.size(); ++job_index) {
+    const JobResult& result = results[job_index];
+    std::cout << std::setw(6) << job_index << std::setw(12) << std::fixed
+              << std::setprecision(3) << result.seconds << std::setw(14)
+              << result.num_elements << "  " << jobs[job_index].output;
+    if (!result.success) {
+      std::cout << "  FAILED: " << result.error;
+      ++num_failed;
+    }
+    std::cout << "\n";
+    num_elements += result.num_elements;
+    job_seconds += result.seconds;
+  }
+  std::cout << "\n"
+            << jobs.size() - num_failed << " of " << jobs.size()
+            << " jobs succeeded in " << std::setprecision(3)
+            << elapsed.count() << " s (" << job_seconds
+            << " s summed over jobs)\n"
+            << std::setprecision(2) << jobs.size() / elapsed.count()
+            << " jobs/s, " << std::scientific << std::setprecision(3)
+            << num_elements / elapsed.count() << " matrix elements/s\n";
+  if (run_options.report) {
+    chime::instrument::WriteReport("chime-batch.report.json");
+  }
+  if (run_options.trace) {
+    chime::instrument::WriteTrace("chime-batch.trace.json");
+  }
+  return (num_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
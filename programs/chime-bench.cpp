@@ -0,0 +1,510 @@
+/*******************************************************************************
+ chime-bench.cpp
+
+ Benchmark suite. Times the construction of the relative and relative-cm
+ 2n NLO magnetic moment operators over a grid of basis truncations, radial
+ meshes and thread counts, and microbenchmarks of the building blocks:
+
+   CCSpinTensorProductRME  relative-cm spin tensor product RMEs
+   Wigner9J                9j symbols of the angular momentum library
+   chime::Wigner9J         9j symbols of wigner.h
+   SplineIntegrate         spline radial integral of quadpp
+   FusedProductSums        fused radial integration kernels, per
+                           instruction set and number of kernels
+
+ Results are written as JSON, for tracking regressions between versions;
+ progress output goes to standard error. Each timing is the minimum over the
+ repetitions. The radial integral cache is disabled.
+
+ Usage:
+   chime-bench [options]
+
+ Options (lists are comma separated):
+   --Nmax=LIST         basis truncations (default 10,20)
+   --Jmax=LIST         relative angular momentum truncations (default 5)
+   --npts=LIST         radial mesh points (default 1001,3001)
+   --threads=LIST      OpenMP threads (default 1 and all)
+   --hw=HW             oscillator energy in MeV (default 20)
+   --R=R               regulator in fm, 0 for the analytic path (default 1)
+   --repetitions=N     repetitions of each timing (default 3)
+   --output=FILE       JSON output file (default standard output)
+   --no-operators      skip the operator benchmarks
+   --no-micro          skip the microbenchmarks
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "am/wigner_gsl.h"
+#include "libchime.h"
+#include "quadpp/quadpp.h"
+#include "quadpp/spline.h"
+#include "simd.h"
+#include "tprme.h"
+#include "wigner.h"
+
+// Benchmark settings.
+struct BenchOptions {
+  std::vector<int> Nmax{10, 20};
+  std::vector<int> Jmax{5};
+  std::vector<int> npts{1001, 3001};
+  std::vector<int> threads;
+  double hw = 20;
+  double R = 1;
+  int repetitions = 3;
+  std::string output;
+  bool operators = true;
+  bool micro = true;
+};
+
+// Minimal JSON object writer for flat records.
+class JsonRecord {
+ public:
+  JsonRecord& Add(const std::string& key, const std::string& value)
+  {
+    return AddRaw(key, "\"" + value + "\"");
+  }
+  JsonRecord& Add(const std::string& key, const double& value)
+  {
+    std::ostringstream stream;
+    stream.precision(std::numeric_limits<double>::max_digits10);
+    stream << value;
+    return AddRaw(key, stream.str());
+  }
+  JsonRecord& Add(const std::string& key, const int& value)
+  {
+    return AddRaw(key, std::to_string(value));
+  }
+  JsonRecord& Add(const std::string& key, const std::size_t& value)
+  {
+    return AddRaw(key, std::to_string(value));
+  }
+
+  std::string str() const { return "{" + fields_ + "}"; }
+
+ private:
+  JsonRecord& AddRaw(const std::string& key, const std::string& value)
+  {
+    fields_ += (fields_.empty() ? "\"" : ", \"") + key + "\": " + value;
+    return *this;
+  }
+
+  std::string fields_;
+};
+
+// Prints the invalid value of option `name` and exits.
+void InvalidValue(const std::string& name, const std::string& value)
+{
+  std::cerr << "chime-bench: invalid value for " << name << ": " << value
+            << "\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// Parses a nonempty comma separated list of positive integers.
+std::vector<int> ParseList(const std::string& name, const std::string& value)
+{
+  std::vector<int> result;
+  std::istringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    char* end = nullptr;
+    const long number = std::strtol(item.c_str(), &end, 10);
+    if (item.empty() || (*end != '\0') || (number <= 0)) {
+      InvalidValue(name, value);
+    }
+    result.push_back(int(number));
+  }
+  if (result.empty()) {
+    InvalidValue(name, value);
+  }
+  return result;
+}
+
+// Parses a nonnegative floating point number, or a positive one unless
+// `allow_zero`.
+double ParseDouble(const std::string& name, const std::string& value,
+                   const bool& allow_zero)
+{
+  char* end = nullptr;
+  const double result = std::strtod(value.c_str(), &end);
+  if (value.empty() || (*end != '\0') || !(result >= 0)
+      || (!allow_zero && (result == 0))) {
+    InvalidValue(name, value);
+  }
+  return result;
+}
+
+BenchOptions ParseBenchOptions(const int& argc, char** argv)
+{
+  BenchOptions options;
+  options.threads = {1, int(std::max(1u, std::thread::hardware_concurrency()))};
+#ifdef _OPENMP
+  options.threads.back() = omp_get_max_threads();
+#endif
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const std::size_t equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        (equals == std::string::npos) ? "" : arg.substr(equals + 1);
+    if (name == "--Nmax") {
+      options.Nmax = ParseList(name, value);
+    }
+    else if (name == "--Jmax") {
+      options.Jmax = ParseList(name, value);
+    }
+    else if (name == "--npts") {
+      options.npts = ParseList(name, value);
+    }
+    else if (name == "--threads") {
+      options.threads = ParseList(name, value);
+    }
+    else if (name == "--hw") {
+      options.hw = ParseDouble(name, value, false);
+    }
+    else if (name == "--R") {
+      options.R = ParseDouble(name, value, true);
+    }
+    else if (name == "--repetitions") {
+      const std::vector<int> repetitions = ParseList(name, value);
+      if (repetitions.size() != 1) {
+        InvalidValue(name, value);
+      }
+      options.repetitions = repetitions.front();
+    }
+    else if (name == "--output") {
+      options.output = value;
+    }
+    else if (name == "--no-operators") {
+      options.operators = false;
+    }
+    else if (name == "--no-micro") {
+      options.micro = false;
+    }
+    else {
+      std::cerr << "chime-bench: unknown option " << arg << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  options.threads.erase(
+      std::unique(options.threads.begin(), options.threads.end()),
+      options.threads.end());
+  return options;
+}
+
+void SetNumThreads(const int& num_threads)
+{
+#ifdef _OPENMP
+  omp_set_num_threads(num_threads);
+#endif
+}
+
+// Minimum wall time in seconds of `repetitions` calls of `f`.
+template <typename F>
+double MinimumTime(const int& repetitions, const F& f)
+{
+  double result = std::numeric_limits<double>::infinity();
+  for (int rep = 0; rep < repetitions; ++rep) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    result = std::min(result, elapsed.count());
+  }
+  return result;
+}
+
+template <typename OperatorType>
+std::size_t NumMatrixElements(const OperatorType& op)
+{
+  std::size_t result = 0;
+  for (const auto& matrices : op.matrices) {
+    for (const auto& matrix : matrices) {
+      result += matrix.size();
+    }
+  }
+  return result;
+}
+
+// Times the operator builders over the grid of `options`.
+std::vector<std::string> OperatorBenchmarks(const BenchOptions& options)
+{
+  std::vector<std::string> records;
+  chime::OperatorRequest request;
+  request.hbomega = options.hw;
+  request.R = options.R;
+  chime::radial::RadialParameters radial_params;
+  radial_params.cache.enabled = false;
+
+  for (const int& npts : options.npts) {
+    radial_params.npts = npts;
+    for (const int& num_threads : options.threads) {
+      SetNumThreads(num_threads);
+      for (const int& Nmax : options.Nmax) {
+        for (const int& Jmax : options.Jmax) {
+          basis::RelativeOperatorParametersLSJT params;
+          params.J0 = 1;
+          params.g0 = 0;
+          params.T0_min = params.T0_max = 1;
+          params.symmetry_phase_mode = basis::SymmetryPhaseMode::kHermitian;
+          params.Nmax = Nmax;
+          params.Jmax = Jmax;
+          std::size_t num_elements = 0;
+          const double seconds = MinimumTime(options.repetitions, [&]() {
+            chime::RelativeOperator op;
+            chime::ConstructRelativeOperator(params, request, op,
+                                             radial_params);
+            num_elements = NumMatrixElements(op);
+          });
+          records.push_back(JsonRecord()
+                                .Add("operator", std::string("relative"))
+                                .Add("Nmax", Nmax)
+                                .Add("Jmax", Jmax)
+                                .Add("npts", npts)
+                                .Add("threads", num_threads)
+                                .Add("seconds", seconds)
+                                .Add("matrix_elements", num_elements)
+                                .str());
+        }
+
+        basis::RelativeCMOperatorParametersLSJT params;
+        params.J0 = 1;
+        params.g0 = 0;
+        params.T0_min = params.T0_max = 1;
+        params.symmetry_phase_mode = basis::SymmetryPhaseMode::kHermitian;
+        params.Nmax = Nmax;
+        params.Jmax = Nmax;
+        std::size_t num_elements = 0;
+        const double seconds = MinimumTime(options.repetitions, [&]() {
+          chime::RelativeCMOperator op;
+          chime::ConstructRelativeCMOperator(params, request, op,
+                                             radial_params);
+          num_elements = NumMatrixElements(op);
+        });
+        records.push_back(JsonRecord()
+                              .Add("operator", std::string("relativecm"))
+                              .Add("Nmax", Nmax)
+                              .Add("npts", npts)
+                              .Add("threads", num_threads)
+                              .Add("seconds", seconds)
+                              .Add("matrix_elements", num_elements)
+                              .str());
+      }
+    }
+  }
+  return records;
+}
+
+// Record of a microbenchmark of `calls` calls in `seconds`.
+std::string MicroRecord(const std::string& name, const std::size_t& calls,
+                        const double& seconds, const double& checksum)
+{
+  return JsonRecord()
+      .Add("name", name)
+      .Add("calls", calls)
+      .Add("seconds", seconds)
+      .Add("ns_per_call", seconds / calls * 1e9)
+      .Add("checksum", checksum)
+      .str();
+}
+
+// Times the building blocks on a single thread.
+std::vector<std::string> MicroBenchmarks(const BenchOptions& options)
+{
+  std::vector<std::string> records;
+  SetNumThreads(1);
+  double checksum = 0;
+
+  // Spin tensor products between all states of a few relative-cm
+  // subspaces.
+  {
+    const basis::RelativeCMSpaceLSJT space(4);
+    std::vector<basis::RelativeCMStateLSJT> states;
+    for (std::size_t subspace_index = 0;
+         subspace_index < std::min<std::size_t>(space.size(), 8);
+         ++subspace_index) {
+      const basis::RelativeCMSubspaceLSJT& subspace =
+          space.GetSubspace(subspace_index);
+      for (std::size_t index = 0; index < subspace.size(); ++index) {
+        states.emplace_back(subspace, index);
+      }
+    }
+    std::size_t calls = 0;
+    const double seconds = MinimumTime(options.repetitions, [&]() {
+      calls = 0;
+      checksum = 0;
+      for (const auto& bra : states) {
+        for (const auto& ket : states) {
+          checksum +=
+              chime::tp::CCSpinTensorProductRME<1, 1, 2, 2, 1>(bra, ket);
+          ++calls;
+        }
+      }
+    });
+    records.push_back(
+        MicroRecord("CCSpinTensorProductRME", calls, seconds, checksum));
+  }
+
+  // 9j symbols with all arguments up to 2.
+  {
+    std::size_t calls = 0;
+    const double seconds = MinimumTime(options.repetitions, [&]() {
+      calls = 0;
+      checksum = 0;
+      for (int index = 0; index < 19683; ++index) {  // 3^9 argument sets
+        int j[9];
+        for (int k = 0, rest = index; k < 9; ++k, rest /= 3) {
+          j[k] = rest % 3;
+        }
+        checksum += am::Wigner9J(j[0], j[1], j[2], j[3], j[4], j[5], j[6],
+                                 j[7], j[8]);
+        ++calls;
+      }
+    });
+    records.push_back(MicroRecord("Wigner9J", calls, seconds, checksum));
+  }
+
+  // 9j symbols of wigner.h, on the same arguments.
+  {
+    std::size_t calls = 0;
+    const double seconds = MinimumTime(options.repetitions, [&]() {
+      calls = 0;
+      checksum = 0;
+      for (int index = 0; index < 19683; ++index) {  // 3^9 argument sets
+        int j[9];
+        for (int k = 0, rest = index; k < 9; ++k, rest /= 3) {
+          j[k] = rest % 3;
+        }
+        checksum += chime::wigner::Wigner9J(j[0], j[1], j[2], j[3], j[4], j[5],
+                                            j[6], j[7], j[8]);
+        ++calls;
+      }
+    });
+    records.push_back(MicroRecord("chime::Wigner9J", calls, seconds, checksum));
+  }
+
+  // Spline integrals and fused kernels on each radial mesh.
+  for (const int& npts : options.npts) {
+    Eigen::ArrayXd x, r, jac;
+    quadpp::SemiInfiniteIntegralMesh(npts, 0, 1, x, r, jac);
+    const Eigen::ArrayXd y = r * r * jac * Eigen::exp(-r * r);
+    const int spline_calls = 200;
+    const double spline_seconds = MinimumTime(options.repetitions, [&]() {
+      checksum = 0;
+      for (int call = 0; call < spline_calls; ++call) {
+        checksum += quadpp::spline::Integrate(x, y);
+      }
+    });
+    records.push_back(MicroRecord("SplineIntegrate/" + std::to_string(npts),
+                                  spline_calls, spline_seconds, checksum));
+
+    // Wave functions and weights only need realistic sizes.
+    constexpr int max_kernels = 4;
+    const Eigen::ArrayXd a = Eigen::ArrayXd::Random(npts);
+    const Eigen::ArrayXd b = Eigen::ArrayXd::Random(npts);
+    const Eigen::ArrayXXd weights = Eigen::ArrayXXd::Random(npts, max_kernels);
+    std::vector<const double*> weight_ptrs;
+    for (int k = 0; k < max_kernels; ++k) {
+      weight_ptrs.push_back(weights.col(k).data());
+    }
+    const int fused_calls = 20000;
+    for (const auto& isa : {chime::simd::InstructionSet::kScalar,
+                            chime::simd::InstructionSet::kAVX2,
+                            chime::simd::InstructionSet::kAVX512}) {
+      if (!chime::simd::Supported(isa)) {
+        continue;
+      }
+      for (int num_kernels : {2, 4}) {
+        std::vector<double> sums(num_kernels);
+        const double seconds = MinimumTime(options.repetitions, [&]() {
+          checksum = 0;
+          for (int call = 0; call < fused_calls; ++call) {
+            chime::simd::FusedProductSums(isa, a.data(), b.data(),
+                                          weight_ptrs.data(), num_kernels, 1,
+                                          npts - 1, sums.data());
+            checksum += sums[0];
+          }
+        });
+        records.push_back(MicroRecord(
+            "FusedProductSums/" + chime::simd::InstructionSetName(isa) + "/"
+                + std::to_string(num_kernels) + "/" + std::to_string(npts),
+            fused_calls, seconds, checksum));
+      }
+    }
+  }
+  return records;
+}
+
+void WriteArray(std::ostream& stream, const std::string& key,
+                const std::vector<std::string>& records)
+{
+  stream << "  \"" << key << "\": [";
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    stream << (i ? ",\n" : "\n") << "    " << records[i];
+  }
+  stream << (records.empty() ? "]" : "\n  ]");
+}
+
+int main(int argc, char** argv)
+{
+  const BenchOptions options = ParseBenchOptions(argc, argv);
+
+  // The progress output of the builders goes to standard error, so that
+  // standard output only holds the JSON document.
+  std::ostream json_stdout(std::cout.rdbuf());
+  std::cout.rdbuf(std::cerr.rdbuf());
+
+  std::vector<std::string> micro, operators;
+  if (options.micro) {
+    micro = MicroBenchmarks(options);
+  }
+  if (options.operators) {
+    operators = OperatorBenchmarks(options);
+  }
+
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+  }
+  std::ostream& stream = options.output.empty() ? json_stdout : file;
+
+#ifdef VCS_REVISION
+  const std::string revision = VCS_REVISION;
+#else
+  const std::string revision = "unknown";
+#endif
+  const JsonRecord context =
+      JsonRecord()
+          .Add("revision", revision)
+          .Add("timestamp", std::size_t(std::time(nullptr)))
+          .Add("hardware_threads",
+               std::size_t(std::thread::hardware_concurrency()))
+          .Add("instruction_set", chime::simd::InstructionSetName(
+                                      chime::simd::ActiveInstructionSet()))
+          .Add("hw", options.hw)
+          .Add("R", options.R)
+          .Add("repetitions", options.repetitions);
+  stream << "{\n  \"context\": " << context.str() << ",\n";
+  WriteArray(stream, "micro", micro);
+  stream << ",\n";
+  WriteArray(stream, "operators", operators);
+  stream << "\n}\n";
+  return stream.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -11,6 +11,7 @@
 #ifndef CHIME_H_
 #define CHIME_H_
 
+#include <Eigen/Dense>
 #include <cmath>
 #include <fstream>
 #include "basis/jt_operator.h"
@@ -45,6 +46,17 @@ inline double SCSRegulator(const double& r, const double& R)
   return result;
 }
 
+// Calculates the LENPIC SCS regulator on a mesh. Uses the vectorized array
+// functions of Eigen.
+inline Eigen::ArrayXd SCSRegulator(const Eigen::ArrayXd& r, const double& R)
+{
+  if (R == 0) {
+    return Eigen::ArrayXd::Ones(r.size());
+  }
+  Eigen::ArrayXd result = Eigen::pow(1. - Eigen::exp(-(r * r) / (R * R)), 6);
+  return result;
+}
+
 }  // namespace chime
 
 #endif
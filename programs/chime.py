@@ -0,0 +1,236 @@
+"""Python bindings of the chime operator builders.
+
+The bindings load the shared library libchime.so through ctypes. The library
+is built by `make programs/libchime.so`, see module.mk, and is looked up in
+$CHIME_LIBRARY and then next to this file.
+
+ctypes releases the GIL for the duration of each library call, so operators
+can be constructed in a background thread while the interpreter keeps
+running. Blocks are returned as NumPy views of the memory of the library,
+without copies. Each view keeps its operator alive.
+
+Example:
+
+    import chime
+
+    op = chime.Operator.relative(Nmax=20, Jmax=11, hbomega=20.0)
+    for sector in op.sectors():
+        block = op.block(sector.index)  # (rows, cols) view, Fortran order
+"""
+
+import collections
+import ctypes
+import os
+
+import numpy as np
+
+API_VERSION = 1
+
+
+class _Request(ctypes.Structure):
+    _fields_ = [
+        ("name", ctypes.c_char_p),
+        ("order", ctypes.c_char_p),
+        ("abody", ctypes.c_int),
+        ("J0", ctypes.c_int),
+        ("g0", ctypes.c_int),
+        ("T0_min", ctypes.c_int),
+        ("T0_max", ctypes.c_int),
+        ("Nmax", ctypes.c_int),
+        ("Jmax", ctypes.c_int),
+        ("hbomega", ctypes.c_double),
+        ("R", ctypes.c_double),
+        ("npts", ctypes.c_int),
+        ("tolerance", ctypes.c_double),
+        ("screening_threshold", ctypes.c_double),
+        ("analytic", ctypes.c_int),
+        ("cache_directory", ctypes.c_char_p),
+    ]
+
+
+class _SectorInfo(ctypes.Structure):
+    _fields_ = [
+        ("bra_subspace_index", ctypes.c_size_t),
+        ("ket_subspace_index", ctypes.c_size_t),
+        ("rows", ctypes.c_size_t),
+        ("cols", ctypes.c_size_t),
+    ]
+
+
+class _SubspaceInfo(ctypes.Structure):
+    _fields_ = [
+        ("L", ctypes.c_int),
+        ("S", ctypes.c_int),
+        ("J", ctypes.c_int),
+        ("T", ctypes.c_int),
+        ("g", ctypes.c_int),
+        ("size", ctypes.c_size_t),
+    ]
+
+
+class _StateInfo(ctypes.Structure):
+    _fields_ = [
+        ("Nr", ctypes.c_int),
+        ("lr", ctypes.c_int),
+        ("Nc", ctypes.c_int),
+        ("lc", ctypes.c_int),
+    ]
+
+
+Subspace = collections.namedtuple("Subspace", "index L S J T g size")
+State = collections.namedtuple("State", "Nr lr Nc lc")
+Sector = collections.namedtuple(
+    "Sector", "index bra_subspace_index ket_subspace_index rows cols"
+)
+
+
+def _load_library():
+    path = os.environ.get("CHIME_LIBRARY")
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            "libchime.so")
+    lib = ctypes.CDLL(path)
+
+    handle = ctypes.c_void_p
+    lib.chime_api_version.restype = ctypes.c_int
+    lib.chime_last_error.restype = ctypes.c_char_p
+    lib.chime_operator_request_init.argtypes = [ctypes.POINTER(_Request)]
+    lib.chime_operator_request_init.restype = None
+    for create in (lib.chime_relative_operator_create,
+                   lib.chime_relativecm_operator_create):
+        create.argtypes = [ctypes.POINTER(_Request), ctypes.POINTER(handle)]
+        create.restype = ctypes.c_int
+    lib.chime_operator_destroy.argtypes = [handle]
+    lib.chime_operator_destroy.restype = None
+    lib.chime_operator_num_subspaces.argtypes = [handle]
+    lib.chime_operator_num_subspaces.restype = ctypes.c_size_t
+    lib.chime_operator_subspace.argtypes = [
+        handle, ctypes.c_size_t, ctypes.POINTER(_SubspaceInfo)]
+    lib.chime_operator_subspace.restype = ctypes.c_int
+    lib.chime_operator_state.argtypes = [
+        handle, ctypes.c_size_t, ctypes.c_size_t, ctypes.POINTER(_StateInfo)]
+    lib.chime_operator_state.restype = ctypes.c_int
+    lib.chime_operator_num_sectors.argtypes = [handle, ctypes.c_int]
+    lib.chime_operator_num_sectors.restype = ctypes.c_size_t
+    lib.chime_operator_sector.argtypes = [
+        handle, ctypes.c_int, ctypes.c_size_t, ctypes.POINTER(_SectorInfo)]
+    lib.chime_operator_sector.restype = ctypes.c_int
+    lib.chime_operator_block.argtypes = [handle, ctypes.c_int,
+                                         ctypes.c_size_t]
+    lib.chime_operator_block.restype = ctypes.c_void_p
+
+    if lib.chime_api_version() != API_VERSION:
+        raise ImportError("libchime API version {} does not match {}".format(
+            lib.chime_api_version(), API_VERSION))
+    return lib
+
+
+_lib = _load_library()
+
+
+def _check(status):
+    if status != 0:
+        raise RuntimeError(_lib.chime_last_error().decode())
+
+
+class Operator:
+    """Operator built by libchime, see libchime_c.h.
+
+    Use Operator.relative or Operator.relativecm to construct one.
+    """
+
+    def __init__(self, create, Nmax, hbomega, R=0.0, Jmax=0, name="mm",
+                 order="nlo", abody=2, J0=1, g0=0, T0_min=1, T0_max=1,
+                 npts=None, tolerance=0.0, screening_threshold=0.0,
+                 analytic=True, cache_directory=None):
+        request = _Request()
+        _lib.chime_operator_request_init(ctypes.byref(request))
+        request.name = name.encode()
+        request.order = order.encode()
+        request.abody = abody
+        request.J0, request.g0 = J0, g0
+        request.T0_min, request.T0_max = T0_min, T0_max
+        request.Nmax, request.Jmax = Nmax, Jmax
+        request.hbomega, request.R = hbomega, R
+        if npts is not None:
+            request.npts = npts
+        request.tolerance = tolerance
+        request.screening_threshold = screening_threshold
+        request.analytic = int(analytic)
+        if cache_directory is not None:
+            request.cache_directory = cache_directory.encode()
+
+        self._handle = ctypes.c_void_p()
+        self.T0_min, self.T0_max = T0_min, T0_max
+        _check(create(ctypes.byref(request), ctypes.byref(self._handle)))
+
+    @classmethod
+    def relative(cls, Nmax, Jmax, hbomega, **kwargs):
+        return cls(_lib.chime_relative_operator_create, Nmax, hbomega,
+                   Jmax=Jmax, **kwargs)
+
+    @classmethod
+    def relativecm(cls, Nmax, hbomega, **kwargs):
+        return cls(_lib.chime_relativecm_operator_create, Nmax, hbomega,
+                   **kwargs)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.chime_operator_destroy(self._handle)
+            self._handle = None
+
+    def subspaces(self):
+        result = []
+        for index in range(_lib.chime_operator_num_subspaces(self._handle)):
+            info = _SubspaceInfo()
+            _check(_lib.chime_operator_subspace(self._handle, index,
+                                                ctypes.byref(info)))
+            result.append(Subspace(index, info.L, info.S, info.J, info.T,
+                                   info.g, info.size))
+        return result
+
+    def states(self, subspace_index):
+        info = _SubspaceInfo()
+        _check(_lib.chime_operator_subspace(self._handle, subspace_index,
+                                            ctypes.byref(info)))
+        result = []
+        for index in range(info.size):
+            state = _StateInfo()
+            _check(_lib.chime_operator_state(self._handle, subspace_index,
+                                             index, ctypes.byref(state)))
+            result.append(State(state.Nr, state.lr, state.Nc, state.lc))
+        return result
+
+    def sectors(self, T0=None):
+        T0 = self.T0_min if T0 is None else T0
+        result = []
+        for index in range(_lib.chime_operator_num_sectors(self._handle, T0)):
+            info = _SectorInfo()
+            _check(_lib.chime_operator_sector(self._handle, T0, index,
+                                              ctypes.byref(info)))
+            result.append(Sector(index, info.bra_subspace_index,
+                                 info.ket_subspace_index, info.rows,
+                                 info.cols))
+        return result
+
+    def block(self, sector_index, T0=None):
+        """Read-only view of a block of reduced matrix elements."""
+        T0 = self.T0_min if T0 is None else T0
+        info = _SectorInfo()
+        _check(_lib.chime_operator_sector(self._handle, T0, sector_index,
+                                          ctypes.byref(info)))
+        size = info.rows * info.cols
+        if size == 0:
+            return np.zeros((info.rows, info.cols), order="F")
+        address = _lib.chime_operator_block(self._handle, T0, sector_index)
+        if not address:
+            raise RuntimeError(_lib.chime_last_error().decode())
+
+        # The ctypes array refers to the operator, and the NumPy array to the
+        # ctypes array.
+        buffer = (ctypes.c_double * size).from_address(address)
+        buffer._owner = self
+        view = np.frombuffer(buffer, dtype=np.float64)
+        view = view.reshape((info.rows, info.cols), order="F")
+        view.flags.writeable = False
+        return view
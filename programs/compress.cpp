@@ -0,0 +1,149 @@
+#include "compress.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace chime {
+namespace compress {
+
+namespace {
+
+constexpr std::size_t kMinMatch = 4;
+constexpr int kHashBits = 14;
+
+// Hash of the four bytes at `data`.
+std::uint32_t Hash(const unsigned char* data)
+{
+  std::uint32_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return (word * 2654435761u) >> (32 - kHashBits);
+}
+
+void PutVarint(std::uint64_t value, std::vector<char>& out)
+{
+  while (value >= 0x80) {
+    out.push_back(char((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(char(value));
+}
+
+// Reads a varint at `position` of `data` of `size` bytes, and advances
+// `position` past it.
+std::uint64_t GetVarint(const unsigned char* data, const std::size_t& size,
+                        std::size_t& position)
+{
+  std::uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (position == size) {
+      break;
+    }
+    const unsigned char byte = data[position++];
+    value |= std::uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw std::runtime_error("corrupt compressed block");
+}
+
+// Literals from `begin` to `end` of `in`, and the match that follows them.
+void PutSequence(const unsigned char* in, const std::size_t& begin,
+                 const std::size_t& end, const std::size_t& length,
+                 const std::size_t& distance, std::vector<char>& out)
+{
+  PutVarint(end - begin, out);
+  out.insert(out.end(), in + begin, in + end);
+  PutVarint(length ? length - kMinMatch + 1 : 0, out);
+  if (length) {
+    PutVarint(distance, out);
+  }
+}
+
+}  // namespace
+
+std::vector<char> Encode(const double* values, const std::size_t& count)
+{
+  // Byte planes.
+  const std::size_t size = count * sizeof(double);
+  std::vector<unsigned char> planes(size);
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+  for (std::size_t index = 0; index < count; ++index) {
+    for (std::size_t byte = 0; byte < sizeof(double); ++byte) {
+      planes[byte * count + index] = bytes[index * sizeof(double) + byte];
+    }
+  }
+
+  // Greedy LZ77 with the last position of each hash as match candidate.
+  const unsigned char* in = planes.data();
+  std::vector<char> out;
+  out.reserve(size / 4 + 16);
+  std::vector<std::size_t> last(std::size_t(1) << kHashBits, size);
+  std::size_t anchor = 0, position = 0;
+  while (position + kMinMatch <= size) {
+    const std::uint32_t hash = Hash(in + position);
+    const std::size_t candidate = last[hash];
+    last[hash] = position;
+    if ((candidate == size)
+        || (std::memcmp(in + candidate, in + position, kMinMatch) != 0)) {
+      ++position;
+      continue;
+    }
+    std::size_t length = kMinMatch;
+    while ((position + length < size)
+           && (in[candidate + length] == in[position + length])) {
+      ++length;
+    }
+    PutSequence(in, anchor, position, length, position - candidate, out);
+    position += length;
+    anchor = position;
+  }
+  PutSequence(in, anchor, size, 0, 0, out);
+  return out;
+}
+
+void Decode(const char* data, const std::size_t& size, double* values,
+            const std::size_t& count)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+  const std::size_t planes_size = count * sizeof(double);
+  std::vector<unsigned char> planes(planes_size);
+  std::size_t position = 0, out = 0;
+  while (true) {
+    const std::uint64_t literals = GetVarint(in, size, position);
+    if ((literals > size - position) || (literals > planes_size - out)) {
+      throw std::runtime_error("corrupt compressed block");
+    }
+    std::memcpy(planes.data() + out, in + position, literals);
+    position += literals;
+    out += literals;
+
+    const std::uint64_t length_code = GetVarint(in, size, position);
+    if (length_code == 0) {
+      break;
+    }
+    const std::uint64_t length = length_code + kMinMatch - 1;
+    const std::uint64_t distance = GetVarint(in, size, position);
+    if ((distance == 0) || (distance > out)
+        || (length > planes_size - out)) {
+      throw std::runtime_error("corrupt compressed block");
+    }
+    // Byte by byte, as the match may overlap its own output.
+    for (std::uint64_t byte = 0; byte < length; ++byte, ++out) {
+      planes[out] = planes[out - distance];
+    }
+  }
+  if ((position != size) || (out != planes_size)) {
+    throw std::runtime_error("corrupt compressed block");
+  }
+
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(values);
+  for (std::size_t index = 0; index < count; ++index) {
+    for (std::size_t byte = 0; byte < sizeof(double); ++byte) {
+      bytes[index * sizeof(double) + byte] = planes[byte * count + index];
+    }
+  }
+}
+
+}  // namespace compress
+}  // namespace chime
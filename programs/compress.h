@@ -0,0 +1,54 @@
+/*******************************************************************************
+ compress.h
+
+ Defines the lossless codec of operator blocks in sector files. Blocks are
+ mostly zeros, or smooth in their indices, so that the bytes of neighboring
+ values agree in sign and exponent but not in mantissa. The codec shuffles
+ the bytes of the values into planes, all first bytes, then all second
+ bytes, etc., which groups the repetitive bytes together, and compresses the
+ planes with an LZ77 codec.
+
+ Compressed stream, a sequence of
+   varint         number of literal bytes
+   char           literal bytes
+   varint         match length - 3, 0 at the end of the stream
+   varint         match distance, if not at the end of the stream
+ with varints of 7 bits per byte, least significant first. Matches may
+ overlap their own output, so that a run of zeros is a single match.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace chime {
+namespace compress {
+
+// Codec of a stored block.
+enum class Codec : std::uint64_t {
+  kNone = 0,       // values, native byte order
+  kShuffleLZ = 1,  // byte-shuffled values, LZ77 compressed
+  kText = 2,       // lines of a text operator file, see partition.h
+};
+
+// Compresses `count` values with the shuffle and LZ codec.
+std::vector<char> Encode(const double* values, const std::size_t& count);
+
+// Decompresses `size` bytes of `data` to `count` values.
+//
+// Throws:
+//   std::runtime_error if `data` is not a compressed stream of `count`
+//   values
+void Decode(const char* data, const std::size_t& size, double* values,
+            const std::size_t& count);
+
+}  // namespace compress
+}  // namespace chime
+
+#endif
@@ -0,0 +1,102 @@
+/*******************************************************************************
+ compress_test.cpp
+
+ Checks that the block codec restores values exactly, including the special
+ values and blocks of zero and one values, reports the compression ratios of
+ vanishing, smooth and random blocks, and checks that corrupt streams are
+ rejected.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+
+#include "compress.h"
+
+// Whether `values` survive the codec bit for bit, with the compressed size
+// in `size`.
+bool RoundTrip(const Eigen::ArrayXd& values, std::size_t& size)
+{
+  const std::vector<char> data =
+      chime::compress::Encode(values.data(), values.size());
+  size = data.size();
+  Eigen::ArrayXd decoded(values.size());
+  chime::compress::Decode(data.data(), data.size(), decoded.data(),
+                          decoded.size());
+  return std::memcmp(values.data(), decoded.data(),
+                     values.size() * sizeof(double))
+         == 0;
+}
+
+int main()
+{
+  bool passed = true;
+  const int n = 4096;
+
+  Eigen::ArrayXd smooth(n);
+  for (int index = 0; index < n; ++index) {
+    smooth(index) = std::exp(-0.001 * index) * std::cos(0.01 * index);
+  }
+  Eigen::ArrayXd special(6);
+  special << 0., -0., std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN(),
+      std::numeric_limits<double>::denorm_min(), 1.;
+  const struct {
+    const char* name;
+    Eigen::ArrayXd values;
+  } cases[] = {
+      {"empty", Eigen::ArrayXd()},
+      {"single", Eigen::ArrayXd::Constant(1, 3.5)},
+      {"special", special},
+      {"zero", Eigen::ArrayXd::Zero(n)},
+      {"smooth", smooth},
+      {"random", Eigen::ArrayXd::Random(n)},
+  };
+  for (const auto& test : cases) {
+    std::size_t size = 0;
+    const bool identical = RoundTrip(test.values, size);
+    std::cout << "Block " << test.name << " of "
+              << test.values.size() * sizeof(double) << " bytes compressed to "
+              << size << ", "
+              << (identical ? "identical" : "DIFFERENT") << "\n";
+    passed &= identical;
+  }
+
+  // A vanishing block compresses to a few bytes, smooth values by the
+  // repeated sign and exponent bytes.
+  std::size_t size = 0;
+  RoundTrip(Eigen::ArrayXd::Zero(n), size);
+  passed &= (size < 16);
+  RoundTrip(smooth, size);
+  passed &= (size < 0.9 * n * sizeof(double));
+
+  // Truncated and overlong streams.
+  const std::vector<char> data = chime::compress::Encode(smooth.data(), n);
+  Eigen::ArrayXd decoded(n);
+  for (const std::size_t& length : {data.size() / 2, data.size() + 1}) {
+    std::vector<char> corrupt(data);
+    corrupt.resize(length, 0);
+    bool rejected = false;
+    try {
+      chime::compress::Decode(corrupt.data(), corrupt.size(), decoded.data(),
+                              n);
+    }
+    catch (const std::runtime_error&) {
+      rejected = true;
+    }
+    std::cout << "Corrupt stream of " << length << " bytes "
+              << (rejected ? "rejected" : "ACCEPTED") << "\n";
+    passed &= rejected;
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
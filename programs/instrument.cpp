@@ -0,0 +1,437 @@
+#include "instrument.h"
+
+#include <sys/resource.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace chime {
+namespace instrument {
+
+bool enabled = false;
+bool perf = false;
+bool tracing = false;
+
+void Enable() { enabled = true; }
+
+void EnableTracing()
+{
+  tracing = true;
+  TraceClock();
+}
+
+const char* PhaseName(const Phase& phase)
+{
+  static const char* const names[kNumPhases] = {
+      "mesh",      "wave_functions", "kernels",   "radial_integrals",
+      "zero_init", "sector_loop",    "brackets",  "lab_frame",
+      "write"};
+  return names[int(phase)];
+}
+
+const char* CounterName(const Counter& counter)
+{
+  static const char* const names[kNumCounters] = {
+      "sectors_visited", "sectors_skipped", "state_pairs", "integrals",
+      "wigner_9j",       "flops_estimate"};
+  return names[int(counter)];
+}
+
+const char* HardwareCounterName(const HardwareCounter& counter)
+{
+  static const char* const names[kNumHardwareCounters] = {
+      "cycles", "instructions", "l1d_misses", "llc_misses", "flops"};
+  return names[int(counter)];
+}
+
+namespace {
+
+std::mutex registry_mutex;
+
+// Counter blocks of all threads that have counted. Blocks outlive their
+// threads, so that the counts of finished threads are kept.
+std::vector<std::unique_ptr<CounterBlock>> counter_blocks;
+
+// Trace buffers of all threads that have traced. The index of the buffer of
+// a thread is its track in the trace.
+std::vector<std::unique_ptr<std::vector<TraceEvent>>> trace_buffers;
+
+// Phase totals.
+std::array<double, kNumPhases> phase_wall{};
+std::array<double, kNumPhases> phase_cpu{};
+std::array<std::uint64_t, kNumPhases> phase_calls{};
+std::array<HardwareCounts, kNumPhases> phase_hardware{};
+
+// An open hardware counter. Its counts are multiplied by `weight`, the
+// floating point operations per instruction of the FP_ARITH events.
+struct PerfCounter {
+  HardwareCounter counter;
+  int fd;
+  double weight;
+};
+
+std::vector<PerfCounter> perf_counters;
+bool hardware_flops = false;
+
+#ifdef __linux__
+// Opens a counter of user space events of this process and of the threads
+// it creates from now on.
+int OpenPerfCounter(const std::uint32_t& type, const std::uint64_t& config)
+{
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+bool IntelProcessor()
+{
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 9, "vendor_id") == 0) {
+      return line.find("GenuineIntel") != std::string::npos;
+    }
+  }
+  return false;
+}
+#endif
+
+double ProcessCPUTime()
+{
+  timespec time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+}  // namespace
+
+std::int64_t TraceClock()
+{
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::vector<TraceEvent>& ThreadTrace()
+{
+  thread_local std::vector<TraceEvent>* buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    trace_buffers.emplace_back(new std::vector<TraceEvent>);
+    buffer = trace_buffers.back().get();
+    buffer->reserve(4096);
+  }
+  return *buffer;
+}
+
+bool EnablePerf()
+{
+  Enable();
+  perf = true;
+#ifdef __linux__
+  const std::uint64_t l1d_read_miss =
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  const struct {
+    HardwareCounter counter;
+    std::uint32_t type;
+    std::uint64_t config;
+  } events[] = {
+      {HardwareCounter::kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {HardwareCounter::kInstructions, PERF_TYPE_HARDWARE,
+       PERF_COUNT_HW_INSTRUCTIONS},
+      {HardwareCounter::kL1DMisses, PERF_TYPE_HW_CACHE, l1d_read_miss},
+      {HardwareCounter::kLLCMisses, PERF_TYPE_HARDWARE,
+       PERF_COUNT_HW_CACHE_MISSES}};
+  for (const auto& event : events) {
+    const int fd = OpenPerfCounter(event.type, event.config);
+    if (fd >= 0) {
+      perf_counters.push_back({event.counter, fd, 1.});
+    }
+  }
+
+  // FP_ARITH_INST_RETIRED (event 0xc7) for scalar, 128, 256 and 512 bit
+  // packed double precision instructions. Fused multiply-adds count twice.
+  if (IntelProcessor()) {
+    const std::uint64_t umasks[] = {0x01, 0x04, 0x10, 0x40};
+    const double widths[] = {1., 2., 4., 8.};
+    std::vector<PerfCounter> flops;
+    for (int i = 0; i < 4; ++i) {
+      const int fd = OpenPerfCounter(PERF_TYPE_RAW, 0xc7 | (umasks[i] << 8));
+      if (fd < 0) {
+        break;
+      }
+      flops.push_back({HardwareCounter::kFlops, fd, widths[i]});
+    }
+    if (flops.size() == 4) {
+      perf_counters.insert(perf_counters.end(), flops.begin(), flops.end());
+      hardware_flops = true;
+    }
+    else {
+      for (const PerfCounter& counter : flops) {
+        close(counter.fd);
+      }
+    }
+  }
+#endif
+  return !perf_counters.empty();
+}
+
+std::array<bool, kNumHardwareCounters> HardwareAvailable()
+{
+  std::array<bool, kNumHardwareCounters> available{};
+  for (const PerfCounter& counter : perf_counters) {
+    available[int(counter.counter)] = true;
+  }
+  available[int(HardwareCounter::kFlops)] = true;
+  return available;
+}
+
+bool HardwareFlops() { return hardware_flops; }
+
+HardwareCounts ReadHardware()
+{
+  HardwareCounts counts{};
+#ifdef __linux__
+  for (const PerfCounter& counter : perf_counters) {
+    std::uint64_t values[3];  // count, time enabled, time running
+    if ((read(counter.fd, values, sizeof(values)) == sizeof(values))
+        && (values[2] > 0)) {
+      counts[int(counter.counter)] +=
+          counter.weight * values[0] * (double(values[1]) / values[2]);
+    }
+  }
+#endif
+  if (!hardware_flops) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& block : counter_blocks) {
+      counts[int(HardwareCounter::kFlops)] +=
+          block->counts[int(Counter::kFlops)];
+    }
+  }
+  return counts;
+}
+
+CounterBlock& ThreadCounters()
+{
+  thread_local CounterBlock* block = nullptr;
+  if (block == nullptr) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    counter_blocks.emplace_back(new CounterBlock);
+    block = counter_blocks.back().get();
+  }
+  return *block;
+}
+
+ScopedPhase::ScopedPhase(const Phase& phase)
+    : phase_(phase),
+      active_(enabled),
+      cpu_start_(0),
+      hardware_start_{},
+      span_(PhaseName(phase))
+{
+  if (active_) {
+    if (perf) {
+      hardware_start_ = ReadHardware();
+    }
+    wall_start_ = std::chrono::steady_clock::now();
+    cpu_start_ = ProcessCPUTime();
+  }
+}
+
+ScopedPhase::~ScopedPhase()
+{
+  if (!active_) {
+    return;
+  }
+  const std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - wall_start_;
+  const double cpu = ProcessCPUTime() - cpu_start_;
+  const HardwareCounts hardware = perf ? ReadHardware() : hardware_start_;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  phase_wall[int(phase_)] += wall.count();
+  phase_cpu[int(phase_)] += cpu;
+  ++phase_calls[int(phase_)];
+  for (int h = 0; h < kNumHardwareCounters; ++h) {
+    phase_hardware[int(phase_)][h] += hardware[h] - hardware_start_[h];
+  }
+}
+
+Report CollectReport()
+{
+  Report report;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    report.wall_seconds = phase_wall;
+    report.cpu_seconds = phase_cpu;
+    report.calls = phase_calls;
+    report.hardware = phase_hardware;
+    for (const auto& block : counter_blocks) {
+      for (int c = 0; c < kNumCounters; ++c) {
+        report.counts[c] += block->counts[c];
+      }
+      if (block->node >= 0) {
+        if (int(report.node_counts.size()) <= block->node) {
+          report.node_counts.resize(block->node + 1);
+        }
+        for (int c = 0; c < kNumCounters; ++c) {
+          report.node_counts[block->node][c] += block->counts[c];
+        }
+      }
+    }
+  }
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    report.peak_rss_kib = usage.ru_maxrss;  // KiB on Linux
+  }
+  return report;
+}
+
+namespace {
+
+// Writes the hardware counts of a phase, and the IPC and GFLOP/s derived
+// from them. Counters that could not be opened are written as null.
+void WriteHardware(std::ostream& file, const HardwareCounts& counts,
+                   const double& wall_seconds)
+{
+  const std::array<bool, kNumHardwareCounters> available = HardwareAvailable();
+  file << ", \"hardware\": {";
+  for (int h = 0; h < kNumHardwareCounters; ++h) {
+    file << (h ? ", \"" : "\"") << HardwareCounterName(HardwareCounter(h))
+         << "\": ";
+    if (available[h]) {
+      file << counts[h];
+    }
+    else {
+      file << "null";
+    }
+  }
+  const double cycles = counts[int(HardwareCounter::kCycles)];
+  const double instructions = counts[int(HardwareCounter::kInstructions)];
+  file << ", \"ipc\": ";
+  if (available[int(HardwareCounter::kCycles)]
+      && available[int(HardwareCounter::kInstructions)] && (cycles > 0)) {
+    file << instructions / cycles;
+  }
+  else {
+    file << "null";
+  }
+  file << ", \"gflops\": ";
+  if (wall_seconds > 0) {
+    file << 1e-9 * counts[int(HardwareCounter::kFlops)] / wall_seconds;
+  }
+  else {
+    file << "null";
+  }
+  file << "}";
+}
+
+// Writes the counters of each NUMA node, and the throughput of the node in
+// the radial integral and sector loop phases.
+void WriteNodes(std::ostream& file, const Report& report)
+{
+  const double integral_seconds =
+      report.wall_seconds[int(Phase::kRadialIntegrals)];
+  const double sector_seconds = report.wall_seconds[int(Phase::kSectorLoop)];
+  file << "\n  \"nodes\": [";
+  for (std::size_t node = 0; node < report.node_counts.size(); ++node) {
+    const auto& counts = report.node_counts[node];
+    file << (node ? ",\n" : "\n") << "    {\"node\": " << node;
+    for (int c = 0; c < kNumCounters; ++c) {
+      file << ", \"" << CounterName(Counter(c)) << "\": " << counts[c];
+    }
+    file << ", \"integrals_per_second\": "
+         << ((integral_seconds > 0)
+                 ? counts[int(Counter::kIntegrals)] / integral_seconds
+                 : 0)
+         << ", \"state_pairs_per_second\": "
+         << ((sector_seconds > 0)
+                 ? counts[int(Counter::kStatePairs)] / sector_seconds
+                 : 0)
+         << "}";
+  }
+  file << "\n  ],";
+}
+
+}  // namespace
+
+bool WriteReport(const std::string& filename)
+{
+  const Report report = CollectReport();
+  std::ofstream file(filename);
+  file << std::setprecision(6) << "{\n  \"phases\": {";
+  for (int p = 0; p < kNumPhases; ++p) {
+    file << (p ? ",\n" : "\n") << "    \"" << PhaseName(Phase(p))
+         << "\": {\"wall_seconds\": " << report.wall_seconds[p]
+         << ", \"cpu_seconds\": " << report.cpu_seconds[p]
+         << ", \"calls\": " << report.calls[p];
+    if (perf) {
+      WriteHardware(file, report.hardware[p], report.wall_seconds[p]);
+    }
+    file << "}";
+  }
+  file << "\n  },\n  \"counters\": {";
+  for (int c = 0; c < kNumCounters; ++c) {
+    file << (c ? ",\n" : "\n") << "    \"" << CounterName(Counter(c))
+         << "\": " << report.counts[c];
+  }
+  file << "\n  },";
+  if (!report.node_counts.empty()) {
+    WriteNodes(file, report);
+  }
+  if (perf) {
+    file << "\n  \"flops_source\": \""
+         << (hardware_flops ? "hardware" : "estimate") << "\",";
+  }
+  file << "\n  \"peak_rss_kib\": " << report.peak_rss_kib << "\n}\n";
+  return file.good();
+}
+
+bool WriteTrace(const std::string& filename)
+{
+  std::ofstream file(filename);
+  file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  bool first = true;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (std::size_t tid = 0; tid < trace_buffers.size(); ++tid) {
+    file << (first ? "\n" : ",\n")
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+         << tid << ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+    first = false;
+    for (const TraceEvent& event : *trace_buffers[tid]) {
+      file << ",\n{\"name\": \"" << event.name
+           << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+           << ", \"ts\": " << 1e-3 * event.begin
+           << ", \"dur\": " << 1e-3 * (event.end - event.begin);
+      if (event.arg >= 0) {
+        file << ", \"args\": {\"index\": " << event.arg << "}";
+      }
+      file << "}";
+    }
+  }
+  file << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+  return file.good();
+}
+
+}  // namespace instrument
+}  // namespace chime
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ instrument.h
+
+ Defines the instrumentation of the operator builders: wall and CPU time of
+ the phases of a calculation, counts of the work done, and the peak resident
+ set size, written as a JSON run report.
+
+ Instrumentation is disabled by default. While disabled, each probe costs a
+ test of a global flag. Counters are accumulated in per-thread blocks, so
+ that the OpenMP loops never contend for them.
+
+ Hardware performance counters, enabled separately on Linux, are read with
+ perf_event_open around each phase: cycles, instructions, L1 data cache and
+ last level cache misses, and floating point operations, from which the
+ report derives the IPC and the achieved GFLOP/s of each phase. The counters
+ are process wide and inherited by threads created after they are opened,
+ so they must be enabled before the first OpenMP region; phases running
+ concurrently, e.g., jobs of the batch driver, are included in each other's
+ counts. Floating point operations are read from the FP_ARITH events on
+ Intel processors. Elsewhere, or if these cannot be opened, they are
+ estimated from the work done by the radial quadrature.
+
+ Tracing, enabled separately, records a timeline of spans: the phases, each
+ sector, the share of each thread in the parallel loop of a sector, each
+ batch of radial integrals. Each thread appends to its own buffer without
+ locking, and the timeline is written in the Chrome trace event format, for
+ chrome://tracing or Perfetto.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef INSTRUMENT_H_
+#define INSTRUMENT_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chime {
+namespace instrument {
+
+enum class Phase {
+  kMesh,             // radial mesh
+  kWaveFunctions,    // harmonic oscillator radial functions
+  kKernels,          // integral kernels and quadrature weights
+  kRadialIntegrals,  // radial integral tables
+  kZeroInit,         // zero initialization of the operator
+  kSectorLoop,       // reduced matrix elements
+  kBrackets,         // Moshinsky bracket table
+  kLabFrame,         // lab-frame two-body transformation, with its output
+  kWrite,            // operator output
+  kNumPhases
+};
+
+enum class Counter {
+  kSectorsVisited,  // sectors whose block is calculated
+  kSectorsSkipped,  // sectors vanishing by selection rules
+  kStatePairs,      // reduced matrix elements calculated
+  kIntegrals,       // radial integrals evaluated
+  kWigner9J,        // 9j symbols evaluated
+  kFlops,           // floating point operations of the quadrature, estimated
+  kNumCounters
+};
+
+enum class HardwareCounter {
+  kCycles,
+  kInstructions,
+  kL1DMisses,  // L1 data cache read misses
+  kLLCMisses,  // last level cache misses
+  kFlops,      // double precision floating point operations
+  kNumHardwareCounters
+};
+
+constexpr int kNumPhases = int(Phase::kNumPhases);
+constexpr int kNumCounters = int(Counter::kNumCounters);
+constexpr int kNumHardwareCounters =
+    int(HardwareCounter::kNumHardwareCounters);
+
+using HardwareCounts = std::array<double, kNumHardwareCounters>;
+
+const char* PhaseName(const Phase& phase);
+const char* CounterName(const Counter& counter);
+const char* HardwareCounterName(const HardwareCounter& counter);
+
+// Whether instrumentation is enabled. Set before any instrumented work.
+extern bool enabled;
+
+inline bool Enabled() { return enabled; }
+void Enable();
+
+// Counters of a thread. Padded to keep the blocks of different threads on
+// different cache lines. Threads pinned to a NUMA node (see numa.h) record
+// their node, so that the report also sums the counters per node.
+struct CounterBlock {
+  std::array<std::uint64_t, kNumCounters> counts{};
+  int node = -1;
+  char padding[64];
+};
+
+// Counters of the calling thread.
+CounterBlock& ThreadCounters();
+
+// Adds `n` to `counter`.
+inline void Count(const Counter& counter, const std::uint64_t& n = 1)
+{
+  if (enabled) {
+    ThreadCounters().counts[int(counter)] += n;
+  }
+}
+
+// Whether hardware counters are read. Set before any instrumented work.
+extern bool perf;
+
+// Enables instrumentation and opens the hardware counters. Returns false if
+// none of them can be opened, e.g., for lack of permission, in which case
+// only the instrumentation is enabled.
+bool EnablePerf();
+
+// Whether each hardware counter could be opened. Floating point operations
+// are always available, as an estimate if not measured.
+std::array<bool, kNumHardwareCounters> HardwareAvailable();
+
+// Whether floating point operations are measured rather than estimated.
+bool HardwareFlops();
+
+// Current values of the hardware counters, scaled for multiplexing.
+HardwareCounts ReadHardware();
+
+// Whether tracing is enabled. Set before any traced work.
+extern bool tracing;
+
+inline bool Tracing() { return tracing; }
+void EnableTracing();
+
+// A completed span of the timeline, in nanoseconds since the start of the
+// process.
+struct TraceEvent {
+  const char* name;  // static string
+  std::int64_t arg;  // index of the traced item, or -1
+  std::int64_t begin;
+  std::int64_t end;
+};
+
+// Nanoseconds since the start of the process.
+std::int64_t TraceClock();
+
+// Trace events of the calling thread.
+std::vector<TraceEvent>& ThreadTrace();
+
+// Records a span from construction to destruction, if tracing is enabled.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name, const std::int64_t& arg = -1)
+      : name_(name), arg_(arg), begin_(tracing ? TraceClock() : -1)
+  {
+  }
+  ~TraceSpan()
+  {
+    if (begin_ >= 0) {
+      ThreadTrace().push_back({name_, arg_, begin_, TraceClock()});
+    }
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  std::int64_t arg_;
+  std::int64_t begin_;
+};
+
+// Times a phase from construction to destruction, and traces it. Nested
+// phases are included in the time of the enclosing phase.
+class ScopedPhase {
+ public:
+  explicit ScopedPhase(const Phase& phase);
+  ~ScopedPhase();
+  ScopedPhase(const ScopedPhase&) = delete;
+  ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+ private:
+  Phase phase_;
+  bool active_;
+  std::chrono::steady_clock::time_point wall_start_;
+  double cpu_start_;
+  HardwareCounts hardware_start_;
+  TraceSpan span_;
+};
+
+// Totals over all threads.
+struct Report {
+  std::array<double, kNumPhases> wall_seconds{};
+  std::array<double, kNumPhases> cpu_seconds{};
+  std::array<std::uint64_t, kNumPhases> calls{};
+  std::array<std::uint64_t, kNumCounters> counts{};
+  std::array<HardwareCounts, kNumPhases> hardware{};
+  // Counters by NUMA node, empty unless threads are pinned.
+  std::vector<std::array<std::uint64_t, kNumCounters>> node_counts;
+  long peak_rss_kib = 0;
+};
+
+Report CollectReport();
+
+// Writes the JSON run report. Returns false if the file cannot be written.
+bool WriteReport(const std::string& filename);
+
+// Writes the trace in the Chrome trace event format, with one track per
+// thread. Returns false if the file cannot be written.
+bool WriteTrace(const std::string& filename);
+
+}  // namespace instrument
+}  // namespace chime
+
+#endif
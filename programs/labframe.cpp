@@ -0,0 +1,438 @@
+#include "labframe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "am/am.h"
+#include "am/halfint.h"
+#include "am/wigner_gsl.h"
+#include "instrument.h"
+
+namespace chime {
+namespace labframe {
+
+namespace {
+
+const char kMagic[8] = {'C', 'H', 'I', 'M', 'E', 'J', 'J', 'T'};
+const std::uint64_t kVersion = 2;
+
+// Overlaps of the states of one relative-cm subspace (rows) with those of a
+// two-body subspace (columns).
+struct Overlaps {
+  std::size_t subspace_index;
+  Eigen::MatrixXd matrix;
+};
+
+// Sector indices of a relative-cm operator by bra and ket subspace index,
+// for each T0.
+using SectorLookup =
+    std::array<std::map<std::pair<std::size_t, std::size_t>, std::size_t>, 3>;
+
+SectorLookup ConstructSectorLookup(const RelativeCMOperator& op)
+{
+  SectorLookup lookup;
+  for (int T0 = op.params.T0_min; T0 <= op.params.T0_max; ++T0) {
+    for (std::size_t sector_index = 0; sector_index < op.sectors[T0].size();
+         ++sector_index) {
+      const auto& sector = op.sectors[T0].GetSector(sector_index);
+      lookup[T0][{sector.bra_subspace_index(), sector.ket_subspace_index()}] =
+          sector_index;
+    }
+  }
+  return lookup;
+}
+
+// Overlaps of the relative-cm subspaces of `op` with the two-body subspace
+// `subspace`. Relative-cm subspaces without overlap are omitted.
+std::vector<Overlaps> ConstructOverlaps(
+    const TwoBodySpace& space, const TwoBodySubspace& subspace,
+    const RelativeCMOperator& op, const moshinsky::BracketTable& brackets)
+{
+  std::vector<Overlaps> overlaps;
+  for (std::size_t subspace_index = 0; subspace_index < op.space.size();
+       ++subspace_index) {
+    const basis::RelativeCMSubspaceLSJT& relcm_subspace =
+        op.space.GetSubspace(subspace_index);
+    if ((relcm_subspace.J() != subspace.J)
+        || (relcm_subspace.T() != subspace.T)
+        || (relcm_subspace.g() != subspace.g)) {
+      continue;
+    }
+    const int L = relcm_subspace.L();
+    const int S = relcm_subspace.S();
+
+    Eigen::MatrixXd matrix =
+        Eigen::MatrixXd::Zero(relcm_subspace.size(), subspace.states.size());
+    for (std::size_t ket_index = 0; ket_index < subspace.states.size();
+         ++ket_index) {
+      const Orbital& a = space.orbitals[subspace.states[ket_index].first];
+      const Orbital& b = space.orbitals[subspace.states[ket_index].second];
+      if (!am::AllowedTriangle(a.l, b.l, L)) {
+        continue;
+      }
+
+      // LS to jj recoupling, and normalization of the antisymmetrized state.
+      const double recoupling =
+          std::sqrt((a.twice_j + 1.) * (b.twice_j + 1.)) * Hat(L) * Hat(S)
+          * am::Wigner9J(HalfInt(a.l), HalfInt(1, 2), HalfInt(a.twice_j, 2),
+                         HalfInt(b.l), HalfInt(1, 2), HalfInt(b.twice_j, 2),
+                         HalfInt(L), HalfInt(S), HalfInt(subspace.J))
+          * std::sqrt(2. / (1. + (subspace.states[ket_index].first
+                                  == subspace.states[ket_index].second)));
+      if (recoupling == 0) {
+        continue;
+      }
+      const moshinsky::OrbitalPair two_particle{(a.N - a.l) / 2, a.l,
+                                                (b.N - b.l) / 2, b.l};
+      for (std::size_t bra_index = 0; bra_index < relcm_subspace.size();
+           ++bra_index) {
+        const basis::RelativeCMStateLSJT state(relcm_subspace, bra_index);
+        if (state.Nr() + state.Nc() != a.N + b.N) {
+          continue;
+        }
+        const moshinsky::OrbitalPair relative_cm{
+            (state.Nr() - state.lr()) / 2, state.lr(),
+            (state.Nc() - state.lc()) / 2, state.lc()};
+        matrix(bra_index, ket_index) =
+            recoupling * brackets.Bracket(relative_cm, two_particle, L);
+      }
+    }
+    if (!matrix.isZero(0)) {
+      overlaps.push_back({subspace_index, std::move(matrix)});
+    }
+  }
+  return overlaps;
+}
+
+// Block of the two-body sector `sector`, from the blocks of `op` between the
+// relative-cm subspaces overlapping with its bra and ket subspaces.
+Eigen::MatrixXd TransformSector(
+    const TwoBodySpace& space, const TwoBodySector& sector,
+    const RelativeCMOperator& op, const SectorLookup& lookup,
+    const std::vector<std::vector<Overlaps>>& overlaps)
+{
+  const TwoBodySubspace& bra_subspace =
+      space.subspaces[sector.bra_subspace_index];
+  const TwoBodySubspace& ket_subspace =
+      space.subspaces[sector.ket_subspace_index];
+  Eigen::MatrixXd block = Eigen::MatrixXd::Zero(bra_subspace.states.size(),
+                                                ket_subspace.states.size());
+  const auto& sectors = lookup[sector.T0];
+  for (const Overlaps& bra : overlaps[sector.bra_subspace_index]) {
+    for (const Overlaps& ket : overlaps[sector.ket_subspace_index]) {
+      auto position =
+          sectors.find({bra.subspace_index, ket.subspace_index});
+      if (position != sectors.end()) {
+        block.noalias() += bra.matrix.transpose()
+                           * BlockMap(op, sector.T0, position->second)
+                           * ket.matrix;
+        continue;
+      }
+
+      // Sector below the diagonal, from its Hermitian conjugate.
+      position = sectors.find({ket.subspace_index, bra.subspace_index});
+      if (position != sectors.end()) {
+        const basis::RelativeCMSubspaceLSJT& bra_relcm =
+            op.space.GetSubspace(bra.subspace_index);
+        const basis::RelativeCMSubspaceLSJT& ket_relcm =
+            op.space.GetSubspace(ket.subspace_index);
+        const double phase =
+            ParitySign(bra_relcm.J() - ket_relcm.J() + bra_relcm.T()
+                       - ket_relcm.T())
+            * Hat(ket_relcm.J()) / Hat(bra_relcm.J()) * Hat(ket_relcm.T())
+            / Hat(bra_relcm.T());
+        block.noalias() +=
+            phase * bra.matrix.transpose()
+            * BlockMap(op, sector.T0, position->second).transpose()
+            * ket.matrix;
+      }
+    }
+  }
+  return block;
+}
+
+template <typename T>
+void WriteValues(std::ofstream& file, const std::vector<T>& values)
+{
+  file.write(reinterpret_cast<const char*>(values.data()),
+             values.size() * sizeof(T));
+}
+
+template <typename T>
+std::vector<T> ReadValues(std::ifstream& file, const std::size_t& count)
+{
+  std::vector<T> values(count);
+  file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+  return values;
+}
+
+// Header and index of a two-body file, with the blocks of `sectors` in
+// order after it.
+void WriteHeader(std::ofstream& file, const TwoBodySpace& space,
+                 const basis::OperatorLabelsJT& params,
+                 const std::vector<TwoBodySector>& sectors)
+{
+  file.write(kMagic, sizeof(kMagic));
+  WriteValues(file, std::vector<std::uint64_t>{kVersion});
+  WriteValues(file, std::vector<std::int64_t>{params.J0, params.g0,
+                                              params.T0_min, params.T0_max,
+                                              space.Nmax});
+  WriteValues(file, std::vector<std::uint64_t>{space.orbitals.size()});
+  for (const Orbital& orbital : space.orbitals) {
+    WriteValues(file, std::vector<std::int64_t>{orbital.N, orbital.l,
+                                                orbital.twice_j});
+  }
+  WriteValues(file, std::vector<std::uint64_t>{space.subspaces.size()});
+  for (const TwoBodySubspace& subspace : space.subspaces) {
+    WriteValues(file,
+                std::vector<std::int64_t>{subspace.J, subspace.T, subspace.g});
+    WriteValues(file, std::vector<std::uint64_t>{subspace.states.size()});
+    for (const auto& state : subspace.states) {
+      WriteValues(file, std::vector<std::uint64_t>{
+                            std::uint64_t(state.first),
+                            std::uint64_t(state.second)});
+    }
+  }
+  WriteValues(file, std::vector<std::uint64_t>{sectors.size()});
+
+  std::vector<TwoBodySectorRecord> records;
+  for (const TwoBodySector& sector : sectors) {
+    records.push_back(
+        {std::uint64_t(sector.T0), sector.bra_subspace_index,
+         sector.ket_subspace_index,
+         space.subspaces[sector.bra_subspace_index].states.size(),
+         space.subspaces[sector.ket_subspace_index].states.size(), 0});
+  }
+  std::uint64_t offset = std::uint64_t(file.tellp())
+                         + records.size() * sizeof(TwoBodySectorRecord);
+  for (TwoBodySectorRecord& record : records) {
+    record.offset = offset;
+    offset += record.rows * record.cols * sizeof(double);
+  }
+  WriteValues(file, records);
+}
+
+}  // namespace
+
+TwoBodySpace ConstructTwoBodySpace(const int& Nmax)
+{
+  TwoBodySpace space;
+  space.Nmax = Nmax;
+  for (int N = 0; N <= Nmax; ++N) {
+    for (int l = N % 2; l <= N; l += 2) {
+      for (int twice_j = 2 * l - 1; twice_j <= 2 * l + 1; twice_j += 2) {
+        if (twice_j > 0) {
+          space.orbitals.push_back({N, l, twice_j});
+        }
+      }
+    }
+  }
+
+  const int num_orbitals = int(space.orbitals.size());
+  for (int J = 0; J <= Nmax + 1; ++J) {
+    for (int T = 0; T <= 1; ++T) {
+      for (int g = 0; g <= 1; ++g) {
+        TwoBodySubspace subspace{J, T, g, {}};
+        for (int a = 0; a < num_orbitals; ++a) {
+          for (int b = a; b < num_orbitals; ++b) {
+            const Orbital& orbital_a = space.orbitals[a];
+            const Orbital& orbital_b = space.orbitals[b];
+            // Identical orbitals only in antisymmetric states.
+            if ((orbital_a.N + orbital_b.N <= Nmax)
+                && ((orbital_a.l + orbital_b.l) % 2 == g)
+                && (std::abs(orbital_a.twice_j - orbital_b.twice_j) <= 2 * J)
+                && (2 * J <= orbital_a.twice_j + orbital_b.twice_j)
+                && ((a != b) || ((J + T) % 2 == 1))) {
+              subspace.states.push_back({a, b});
+            }
+          }
+        }
+        if (!subspace.states.empty()) {
+          space.subspaces.push_back(std::move(subspace));
+        }
+      }
+    }
+  }
+  return space;
+}
+
+std::vector<TwoBodySector> ConstructTwoBodySectors(
+    const TwoBodySpace& space, const basis::OperatorLabelsJT& params)
+{
+  std::vector<TwoBodySector> sectors;
+  for (int T0 = params.T0_min; T0 <= params.T0_max; ++T0) {
+    for (std::size_t bra_index = 0; bra_index < space.subspaces.size();
+         ++bra_index) {
+      const TwoBodySubspace& bra = space.subspaces[bra_index];
+      for (std::size_t ket_index = bra_index;
+           ket_index < space.subspaces.size(); ++ket_index) {
+        const TwoBodySubspace& ket = space.subspaces[ket_index];
+        if (am::AllowedTriangle(bra.J, params.J0, ket.J)
+            && am::AllowedTriangle(bra.T, T0, ket.T)
+            && (bra.g == (ket.g + params.g0) % 2)) {
+          sectors.push_back({T0, bra_index, ket_index});
+        }
+      }
+    }
+  }
+  return sectors;
+}
+
+void WriteTwoBodyOperator(const std::string& filename,
+                          const RelativeCMOperator& op,
+                          const moshinsky::BracketTable& brackets)
+{
+  if (brackets.Nmax() < op.params.Nmax) {
+    throw std::invalid_argument(
+        "Moshinsky brackets do not extend to the Nmax of the operator");
+  }
+  instrument::ScopedPhase phase(instrument::Phase::kLabFrame);
+  const TwoBodySpace space = ConstructTwoBodySpace(op.params.Nmax);
+  const std::vector<TwoBodySector> sectors =
+      ConstructTwoBodySectors(space, op.params);
+  std::cout << "  Two-body space: " << space.orbitals.size() << " orbitals, "
+            << space.subspaces.size() << " subspaces, " << sectors.size()
+            << " sectors\n";
+
+  const SectorLookup lookup = ConstructSectorLookup(op);
+  std::vector<std::vector<Overlaps>> overlaps(space.subspaces.size());
+#pragma omp parallel for schedule(dynamic)
+  for (std::size_t subspace_index = 0;
+       subspace_index < space.subspaces.size(); ++subspace_index) {
+    overlaps[subspace_index] = ConstructOverlaps(
+        space, space.subspaces[subspace_index], op, brackets);
+  }
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  WriteHeader(file, space, op.params, sectors);
+
+  // Sectors are written in order; a thread that completes a sector early
+  // waits for the preceding ones before taking the next.
+#pragma omp parallel for schedule(dynamic) ordered
+  for (std::size_t sector_index = 0; sector_index < sectors.size();
+       ++sector_index) {
+    const TwoBodySector& sector = sectors[sector_index];
+    Eigen::MatrixXd block;
+    {
+      instrument::TraceSpan span("two_body_sector", sector_index);
+      block = TransformSector(space, sector, op, lookup, overlaps);
+    }
+#pragma omp ordered
+    file.write(reinterpret_cast<const char*>(block.data()),
+               block.size() * sizeof(double));
+  }
+
+  if (!file) {
+    throw std::runtime_error("cannot write two-body file " + filename);
+  }
+}
+
+const TwoBodySectorRecord* TwoBodyIndex::Find(
+    const int& T0, const int& bra_J, const int& bra_T, const int& bra_g,
+    const int& ket_J, const int& ket_T, const int& ket_g) const
+{
+  // Subspaces are in order of J, T, g, records in order of T0, bra and ket
+  // subspace index. Subspace labels not in the space give the number of
+  // subspaces, which no record has.
+  using Labels = std::tuple<int, int, int>;
+  const auto SubspaceIndex = [this](const Labels& labels) {
+    const auto position = std::lower_bound(
+        space.subspaces.begin(), space.subspaces.end(), labels,
+        [](const TwoBodySubspace& subspace, const Labels& value) {
+          return Labels(subspace.J, subspace.T, subspace.g) < value;
+        });
+    if ((position == space.subspaces.end())
+        || (Labels(position->J, position->T, position->g) != labels)) {
+      return std::uint64_t(space.subspaces.size());
+    }
+    return std::uint64_t(position - space.subspaces.begin());
+  };
+  using Key = std::tuple<std::uint64_t, std::uint64_t, std::uint64_t>;
+  const Key key(T0, SubspaceIndex(Labels(bra_J, bra_T, bra_g)),
+                SubspaceIndex(Labels(ket_J, ket_T, ket_g)));
+  const auto RecordKey = [](const TwoBodySectorRecord& record) {
+    return Key(record.T0, record.bra_subspace_index, record.ket_subspace_index);
+  };
+  const auto position = std::lower_bound(
+      records.begin(), records.end(), key,
+      [&](const TwoBodySectorRecord& record, const Key& value) {
+        return RecordKey(record) < value;
+      });
+  if ((position == records.end()) || (RecordKey(*position) != key)) {
+    return nullptr;
+  }
+  return &*position;
+}
+
+TwoBodyIndex ReadTwoBodyIndex(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  file.read(magic, sizeof(magic));
+  if (!file || (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+      || (ReadValues<std::uint64_t>(file, 1)[0] != kVersion)) {
+    throw std::runtime_error("not a two-body file: " + filename);
+  }
+
+  TwoBodyIndex index;
+  index.space.Nmax = int(ReadValues<std::int64_t>(file, 5)[4]);
+  const std::uint64_t num_orbitals = ReadValues<std::uint64_t>(file, 1)[0];
+  for (std::uint64_t orbital = 0; file && (orbital < num_orbitals);
+       ++orbital) {
+    const std::vector<std::int64_t> labels =
+        ReadValues<std::int64_t>(file, 3);
+    index.space.orbitals.push_back(
+        {int(labels[0]), int(labels[1]), int(labels[2])});
+  }
+  const std::uint64_t num_subspaces = ReadValues<std::uint64_t>(file, 1)[0];
+  for (std::uint64_t subspace = 0; file && (subspace < num_subspaces);
+       ++subspace) {
+    const std::vector<std::int64_t> labels =
+        ReadValues<std::int64_t>(file, 3);
+    TwoBodySubspace two_body_subspace{int(labels[0]), int(labels[1]),
+                                      int(labels[2]), {}};
+    const std::uint64_t num_states = ReadValues<std::uint64_t>(file, 1)[0];
+    const std::vector<std::uint64_t> states =
+        ReadValues<std::uint64_t>(file, file ? 2 * num_states : 0);
+    for (std::uint64_t state = 0; state < states.size() / 2; ++state) {
+      two_body_subspace.states.push_back(
+          {int(states[2 * state]), int(states[2 * state + 1])});
+    }
+    index.space.subspaces.push_back(std::move(two_body_subspace));
+  }
+  const std::uint64_t num_sectors = ReadValues<std::uint64_t>(file, 1)[0];
+  if (file) {
+    index.records = ReadValues<TwoBodySectorRecord>(file, num_sectors);
+  }
+  if (!file) {
+    throw std::runtime_error("truncated two-body file " + filename);
+  }
+  return index;
+}
+
+Eigen::MatrixXd ReadTwoBodyBlock(const std::string& filename,
+                                 const TwoBodySectorRecord& record)
+{
+  Eigen::MatrixXd block(record.rows, record.cols);
+  std::ifstream file(filename, std::ios::binary);
+  file.seekg(record.offset);
+  file.read(reinterpret_cast<char*>(block.data()),
+            block.size() * sizeof(double));
+  if (!file) {
+    throw std::runtime_error("cannot read block from two-body file "
+                             + filename);
+  }
+  return block;
+}
+
+}  // namespace labframe
+}  // namespace chime
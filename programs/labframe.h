@@ -0,0 +1,156 @@
+/*******************************************************************************
+ labframe.h
+
+ Defines the transformation of a relative-cm LSJT operator to lab-frame
+ two-body matrix elements in the JJJT scheme, as needed by shell model
+ codes, and the binary file to which they are streamed.
+
+ The two-body states are the antisymmetrized states |a b; J T> of oscillator
+ orbitals a = (N l j) <= b, with Na + Nb up to the Nmax of the relative-cm
+ space. Their overlaps with the relative-cm states |Nr lr, Nc lc; L S J T>
+ are
+
+   sqrt(2 / (1 + delta_ab)) [ja jb L S]^(1/2) {la 1/2 ja; lb 1/2 jb; L S J}
+     <nr lr, nc lc; L | na la, nb lb; L>,
+
+ from the Moshinsky brackets of moshinsky.h, which vanish unless
+ Nr + Nc = Na + Nb. Reduced matrix elements are in the group theory
+ convention of the basis library, for which the sectors of a Hermitian
+ operator below the diagonal are
+
+   <a',J',T'||A||a,J,T>
+     = (-)^(J'-J) Hat(J)/Hat(J') (-)^(T'-T) Hat(T)/Hat(T')
+       <a,J,T||A||a',J',T'>.
+
+ The sectors are transformed in parallel, and written in order as they
+ complete, so that only the blocks of sectors in flight are held in memory.
+ Their sizes are known in advance, so that the header carries an index of
+ their offsets, from which ReadTwoBodyBlock loads a single sector.
+
+ Two-body file (native byte order):
+   char[8]        "CHIMEJJT"
+   uint64         format version, 2
+   int64          J0, g0, T0_min, T0_max, Nmax
+   uint64         number of orbitals
+   int64          N, l, 2j of each orbital
+   uint64         number of subspaces
+   per subspace:
+     int64        J, T, g
+     uint64       number of states
+     uint64       orbital indices a, b of each state
+   uint64         number of sectors
+   TwoBodySectorRecord  one per sector, in order of T0, then bra and ket
+                        subspace index
+   double         blocks, column-major, at the offsets of their records
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef LABFRAME_H_
+#define LABFRAME_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "libchime.h"
+#include "moshinsky.h"
+
+namespace chime {
+namespace labframe {
+
+// Oscillator orbital of quanta N, orbital angular momentum l and angular
+// momentum j = twice_j / 2.
+struct Orbital {
+  int N;
+  int l;
+  int twice_j;
+};
+
+// Two-body subspace of angular momentum J, isospin T and parity g, with
+// states of orbital indices a <= b.
+struct TwoBodySubspace {
+  int J;
+  int T;
+  int g;
+  std::vector<std::pair<int, int>> states;
+};
+
+// Two-body JJJT space of Na + Nb <= Nmax.
+struct TwoBodySpace {
+  int Nmax;
+  std::vector<Orbital> orbitals;            // in order of N, l, j
+  std::vector<TwoBodySubspace> subspaces;   // in order of J, T, g
+};
+
+// Sector of a two-body operator, with bra subspace index <= ket subspace
+// index.
+struct TwoBodySector {
+  int T0;
+  std::size_t bra_subspace_index;
+  std::size_t ket_subspace_index;
+};
+
+// Index entry of a block in a two-body file.
+struct TwoBodySectorRecord {
+  std::uint64_t T0;
+  std::uint64_t bra_subspace_index;
+  std::uint64_t ket_subspace_index;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t offset;  // in bytes from the start of the file
+};
+
+// Space and index of a two-body file.
+struct TwoBodyIndex {
+  TwoBodySpace space;
+  std::vector<TwoBodySectorRecord> records;
+
+  // Record of the sector T0 between the subspaces of labels (J, T, g), with
+  // bra subspace index <= ket subspace index, or nullptr if the file has no
+  // such sector.
+  const TwoBodySectorRecord* Find(const int& T0, const int& bra_J,
+                                  const int& bra_T, const int& bra_g,
+                                  const int& ket_J, const int& ket_T,
+                                  const int& ket_g) const;
+};
+
+// Two-body space up to Nmax. Subspaces without states are omitted.
+TwoBodySpace ConstructTwoBodySpace(const int& Nmax);
+
+// Sectors of the operator labels of `params`, in order of T0, then bra and
+// ket subspace index.
+std::vector<TwoBodySector> ConstructTwoBodySectors(
+    const TwoBodySpace& space, const basis::OperatorLabelsJT& params);
+
+// Transforms the relative-cm operator `op` to the two-body space of the same
+// Nmax, and streams the sectors to the two-body file `filename`. `brackets`
+// must extend at least to that Nmax.
+//
+// Throws:
+//   std::invalid_argument if `brackets` do not extend to the Nmax of `op`
+//   std::runtime_error if the file cannot be written
+void WriteTwoBodyOperator(const std::string& filename,
+                          const RelativeCMOperator& op,
+                          const moshinsky::BracketTable& brackets);
+
+// Reads the space and index of the two-body file `filename`.
+//
+// Throws:
+//   std::runtime_error if the file cannot be read or is not a two-body file
+TwoBodyIndex ReadTwoBodyIndex(const std::string& filename);
+
+// Reads the block of `record` from the two-body file `filename`.
+//
+// Throws:
+//   std::runtime_error if the file cannot be read
+Eigen::MatrixXd ReadTwoBodyBlock(const std::string& filename,
+                                 const TwoBodySectorRecord& record);
+
+}  // namespace labframe
+}  // namespace chime
+
+#endif
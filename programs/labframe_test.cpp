@@ -0,0 +1,96 @@
+/*******************************************************************************
+ labframe_test.cpp
+
+ Checks that the transformation to the lab frame maps a multiple of the
+ identity on the relative-cm space to the same multiple of the identity on
+ the antisymmetrized two-body space of the same Nmax, as the overlaps are an
+ orthogonal transformation at each N, that the two-body file covers all
+ two-body subspaces, and that its sectors are found by their labels.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "labframe.h"
+#include "libchime.h"
+#include "moshinsky.h"
+
+int main()
+{
+  bool passed = true;
+  const int Nmax = 4;
+  const double scalar = 2.5;
+
+  // Scalar operator on the relative-cm space, for the isoscalar component.
+  chime::RelativeCMOperator op;
+  op.params.J0 = 0;
+  op.params.g0 = 0;
+  op.params.T0_min = 0;
+  op.params.T0_max = 0;
+  op.params.symmetry_phase_mode = basis::SymmetryPhaseMode::kHermitian;
+  op.params.Nmax = Nmax;
+  op.space = basis::RelativeCMSpaceLSJT(Nmax);
+  op.sectors[0] = basis::RelativeCMSectorsLSJT(op.space, 0, 0, 0);
+  basis::SetOperatorToZero(op.sectors[0], op.matrices[0]);
+  for (std::size_t sector_index = 0; sector_index < op.sectors[0].size();
+       ++sector_index) {
+    const auto& sector = op.sectors[0].GetSector(sector_index);
+    if (sector.bra_subspace_index() == sector.ket_subspace_index()) {
+      op.matrices[0][sector_index].diagonal().setConstant(scalar);
+    }
+  }
+
+  const std::string filename = "labframe_test.jjjt";
+  chime::labframe::WriteTwoBodyOperator(filename, op,
+                                        chime::moshinsky::BracketTable(Nmax));
+  const chime::labframe::TwoBodyIndex index =
+      chime::labframe::ReadTwoBodyIndex(filename);
+
+  double deviation = 0;
+  std::size_t diagonal_sectors = 0;
+  for (const chime::labframe::TwoBodySectorRecord& record : index.records) {
+    const Eigen::MatrixXd block =
+        chime::labframe::ReadTwoBodyBlock(filename, record);
+    Eigen::MatrixXd expected = Eigen::MatrixXd::Zero(block.rows(), block.cols());
+    if (record.bra_subspace_index == record.ket_subspace_index) {
+      expected.diagonal().setConstant(scalar);
+      ++diagonal_sectors;
+    }
+    if (block.size() > 0) {
+      deviation =
+          std::max(deviation, (block - expected).cwiseAbs().maxCoeff());
+    }
+  }
+  std::remove(filename.c_str());
+
+  // Sectors by labels, and labels of no subspace, before the first subspace
+  // and between two subspaces.
+  bool found = true;
+  for (const chime::labframe::TwoBodySectorRecord& record : index.records) {
+    const chime::labframe::TwoBodySubspace& bra =
+        index.space.subspaces[record.bra_subspace_index];
+    const chime::labframe::TwoBodySubspace& ket =
+        index.space.subspaces[record.ket_subspace_index];
+    found &= (index.Find(record.T0, bra.J, bra.T, bra.g, ket.J, ket.T, ket.g)
+              == &record);
+  }
+  found &= (index.Find(0, -1, 0, 0, -1, 0, 0) == nullptr);
+  found &= (index.Find(0, 1, 2, 0, 1, 2, 0) == nullptr);
+  std::cout << "Sectors found by labels " << (found ? "correct" : "WRONG")
+            << "\n";
+  passed &= found;
+
+  std::cout << "Two-body subspaces " << index.space.subspaces.size()
+            << ", diagonal sectors " << diagonal_sectors << "\n";
+  std::cout << "Largest deviation from the scalar " << deviation << "\n";
+  passed &= (diagonal_sectors == index.space.subspaces.size());
+  passed &= (deviation < 1e-12);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+#include "libchime.h"
+
+#include <stdexcept>
+
+#include "partition.h"
+#include "relative_rme.h"
+#include "relativecm_rme.h"
+
+namespace chime {
+
+// Checks that `request` is implemented, and that `params` has its tensor
+// properties.
+void CheckOperatorRequest(const basis::OperatorLabelsJT& params,
+                          const OperatorRequest& request)
+{
+  const std::string label = request.name + " " + request.order + " "
+                            + std::to_string(request.abody) + "n";
+  if ((request.name != "mm") || (request.order != "nlo")
+      || (request.abody != 2)) {
+    throw std::invalid_argument("operator not implemented: " + label);
+  }
+  if ((params.J0 != 1) || (params.g0 != 0) || (params.T0_min != 1)
+      || (params.T0_max != 1)) {
+    throw std::invalid_argument("operator " + label
+                                + " has J0 = 1, g0 = 0 and T0 = 1");
+  }
+  if (request.hbomega <= 0) {
+    throw std::invalid_argument("oscillator energy must be positive");
+  }
+}
+
+void ConstructRelativeOperator(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request, RelativeOperator& op,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  op.params = params;
+  op.space = basis::RelativeSpaceLSJT(params.Nmax, params.Jmax);
+  relative::ConstructMu2nNLOOperator(op.params, op.space, op.sectors,
+                                     op.matrices, request.hbomega, request.R,
+                                     radial_params);
+}
+
+void ConstructRelativeCMOperator(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request, RelativeCMOperator& op,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  op.params = params;
+  op.space = basis::RelativeCMSpaceLSJT(params.Nmax);
+  relcm::ConstructMu2nNLOOperator(op.params, op.space, op.sectors, op.matrices,
+                                  request.hbomega, request.R, radial_params);
+}
+
+void ConstructRelativeOperatorShare(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request, const int& rank, const int& num_ranks,
+    RelativeOperator& op, SectorOwners& owners,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  op.params = params;
+  op.space = basis::RelativeSpaceLSJT(params.Nmax, params.Jmax);
+  for (int T0 = params.T0_min; T0 <= params.T0_max; ++T0) {
+    op.sectors[T0] =
+        basis::RelativeSectorsLSJT(op.space, params.J0, T0, params.g0);
+    std::vector<double> costs;
+    for (std::size_t sector_index = 0; sector_index < op.sectors[T0].size();
+         ++sector_index) {
+      costs.push_back(relative::Mu2nNLOSectorCost(
+          op.sectors[T0].GetSector(sector_index)));
+    }
+    owners[T0] = partition::PartitionLPT(costs, num_ranks);
+    relative::ConstructMu2nNLOSectors(
+        op.space, op.sectors[T0], partition::Share(owners[T0], rank),
+        op.matrices[T0], request.hbomega, request.R, radial_params);
+  }
+}
+
+void ConstructRelativeCMOperatorShare(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request, const int& rank, const int& num_ranks,
+    RelativeCMOperator& op, SectorOwners& owners,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  op.params = params;
+  op.space = basis::RelativeCMSpaceLSJT(params.Nmax);
+  for (int T0 = params.T0_min; T0 <= params.T0_max; ++T0) {
+    op.sectors[T0] =
+        basis::RelativeCMSectorsLSJT(op.space, params.J0, T0, params.g0);
+    std::vector<double> costs;
+    for (std::size_t sector_index = 0; sector_index < op.sectors[T0].size();
+         ++sector_index) {
+      costs.push_back(relcm::Mu2nNLOSectorCost(
+          op.sectors[T0].GetSector(sector_index)));
+    }
+    owners[T0] = partition::PartitionLPT(costs, num_ranks);
+    relcm::ConstructMu2nNLOSectors(
+        op.space, op.sectors[T0], partition::Share(owners[T0], rank),
+        op.matrices[T0], request.hbomega, request.R, radial_params);
+  }
+}
+
+plan::Plan PlanRelativeOperator(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  const basis::RelativeSpaceLSJT space(params.Nmax, params.Jmax);
+  plan::Plan plan;
+  plan::CountSpace(space, plan);
+  for (int T0 = params.T0_min; T0 <= params.T0_max; ++T0) {
+    plan::CountSectors(
+        basis::RelativeSectorsLSJT(space, params.J0, T0, params.g0),
+        relative::Mu2nNLOSectorCost, plan);
+  }
+  plan::CountRadialTable(relative::Mu2nNLORadialTableShape(space),
+                         radial_params, plan);
+  return plan;
+}
+
+plan::Plan PlanRelativeCMOperator(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request,
+    const radial::RadialParameters& radial_params)
+{
+  CheckOperatorRequest(params, request);
+  const basis::RelativeCMSpaceLSJT space(params.Nmax);
+  plan::Plan plan;
+  plan::CountSpace(space, plan);
+  for (int T0 = params.T0_min; T0 <= params.T0_max; ++T0) {
+    plan::CountSectors(
+        basis::RelativeCMSectorsLSJT(space, params.J0, T0, params.g0),
+        relcm::Mu2nNLOSectorCost, plan);
+  }
+  plan::CountRadialTable(relcm::Mu2nNLORadialTableShape(space),
+                         radial_params, plan);
+  return plan;
+}
+
+}  // namespace chime
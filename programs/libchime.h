@@ -0,0 +1,131 @@
+/*******************************************************************************
+ libchime.h
+
+ Defines the library interface of the chime operator builders, for programs
+ that need operators in-process instead of through the files written by
+ relative-gen and relativecm-gen.
+
+ An operator is returned in the containers of the basis library, so that its
+ blocks are handed over without copies. Each block is a column-major
+ Eigen::MatrixXd, and can also be viewed through BlockMap.
+
+ The C interface is declared in libchime_c.h.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef LIBCHIME_H_
+#define LIBCHIME_H_
+
+#include <Eigen/Dense>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "basis/lsjt_operator.h"
+#include "plan.h"
+#include "radial.h"
+
+namespace chime {
+
+// Operator choice and physical parameters, as in the input files of the
+// generators.
+struct OperatorRequest {
+  std::string name = "mm";    // mm: magnetic moment
+  std::string order = "nlo";  // lo, nlo, n2lo
+  int abody = 2;              // one or two body current
+  double hbomega = 0;         // oscillator energy in MeV
+  double R = 0;               // LENPIC SCS regulator in fm, 0 if unregulated
+};
+
+// Operator in the containers of the basis library. The sectors and blocks
+// refer to `space`, which therefore must not be reassigned.
+template <typename ParametersType, typename SpaceType, typename SectorsType>
+struct Operator {
+  ParametersType params;
+  SpaceType space;
+  std::array<SectorsType, 3> sectors;
+  std::array<basis::OperatorBlocks<double>, 3> matrices;
+};
+
+using RelativeOperator =
+    Operator<basis::RelativeOperatorParametersLSJT, basis::RelativeSpaceLSJT,
+             basis::RelativeSectorsLSJT>;
+using RelativeCMOperator =
+    Operator<basis::RelativeCMOperatorParametersLSJT,
+             basis::RelativeCMSpaceLSJT, basis::RelativeCMSectorsLSJT>;
+
+// Constructs the operator `request` on the relative space with the labels
+// and truncation of `params`.
+//
+// Throws:
+//   std::invalid_argument if the operator is not implemented, or does not
+//   have the tensor properties of `params`
+void ConstructRelativeOperator(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request, RelativeOperator& op,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Constructs the operator `request` on the relative-cm space, as
+// ConstructRelativeOperator.
+void ConstructRelativeCMOperator(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request, RelativeCMOperator& op,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Process of each sector, by sector index for each T0 component.
+using SectorOwners = std::array<std::vector<int>, 3>;
+
+// Constructs the share of process `rank` of `num_ranks` of the operator
+// `request`, as ConstructRelativeOperator. The sectors are assigned to the
+// processes by estimated cost, see partition.h, the same on all processes,
+// and their assignment is returned in `owners`. The blocks of the sectors
+// of other processes are left empty, and only the radial integrals of the
+// subspaces of the own sectors are tabulated.
+void ConstructRelativeOperatorShare(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request, const int& rank, const int& num_ranks,
+    RelativeOperator& op, SectorOwners& owners,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Constructs the share of process `rank` of the operator `request` on the
+// relative-cm space, as ConstructRelativeOperatorShare.
+void ConstructRelativeCMOperatorShare(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request, const int& rank, const int& num_ranks,
+    RelativeCMOperator& op, SectorOwners& owners,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Resources of ConstructRelativeOperator for `request` on the relative space
+// of `params`, counted from the space and sectors without calculating any
+// matrix elements or radial integrals, see plan.h.
+//
+// Throws:
+//   std::invalid_argument as ConstructRelativeOperator
+plan::Plan PlanRelativeOperator(
+    const basis::RelativeOperatorParametersLSJT& params,
+    const OperatorRequest& request,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Resources of ConstructRelativeCMOperator, as PlanRelativeOperator.
+plan::Plan PlanRelativeCMOperator(
+    const basis::RelativeCMOperatorParametersLSJT& params,
+    const OperatorRequest& request,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Read-only view of a block of `op`.
+template <typename OperatorType>
+Eigen::Map<const Eigen::MatrixXd> BlockMap(const OperatorType& op,
+                                           const int& T0,
+                                           const std::size_t& sector_index)
+{
+  const basis::OperatorBlock<double>& matrix = op.matrices[T0][sector_index];
+  return Eigen::Map<const Eigen::MatrixXd>(matrix.data(), matrix.rows(),
+                                           matrix.cols());
+}
+
+}  // namespace chime
+
+#endif
@@ -0,0 +1,318 @@
+#include "libchime_c.h"
+
+#include <Eigen/Dense>
+#include <stdexcept>
+#include <string>
+
+#include "libchime.h"
+#include "options.h"
+
+// Holds either kind of operator.
+struct chime_operator {
+  bool relcm = false;
+  chime::RelativeOperator relative;
+  chime::RelativeCMOperator relativecm;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+int Fail(const std::string& message)
+{
+  last_error = message;
+  return 1;
+}
+
+// Calls `f` with the operator of `op`.
+template <typename F>
+int Visit(const chime_operator* op, const F& f)
+{
+  if (op == nullptr) {
+    return Fail("null operator");
+  }
+  try {
+    return op->relcm ? f(op->relativecm) : f(op->relative);
+  }
+  catch (const std::exception& error) {
+    return Fail(error.what());
+  }
+}
+
+template <typename OperatorType>
+void CheckSector(const OperatorType& op, const int& T0,
+                 const std::size_t& sector_index)
+{
+  if ((T0 < op.params.T0_min) || (T0 > op.params.T0_max)) {
+    throw std::out_of_range("isospin component out of range");
+  }
+  if (sector_index >= op.sectors[T0].size()) {
+    throw std::out_of_range("sector index out of range");
+  }
+}
+
+template <typename OperatorType>
+void CheckSubspace(const OperatorType& op, const std::size_t& subspace_index)
+{
+  if (subspace_index >= op.space.size()) {
+    throw std::out_of_range("subspace index out of range");
+  }
+}
+
+void FillStateInfo(const basis::RelativeStateLSJT& state,
+                   chime_state_info* info)
+{
+  info->Nr = state.N();
+  info->lr = state.L();
+  info->Nc = 0;
+  info->lc = 0;
+}
+
+void FillStateInfo(const basis::RelativeCMStateLSJT& state,
+                   chime_state_info* info)
+{
+  info->Nr = state.Nr();
+  info->lr = state.lr();
+  info->Nc = state.Nc();
+  info->lc = state.lc();
+}
+
+// Converts the common fields of `request`.
+template <typename ParametersType>
+ParametersType ConvertRequest(const chime_operator_request* request,
+                              chime::OperatorRequest& op_request,
+                              chime::radial::RadialParameters& radial_params)
+{
+  if ((request->name == nullptr) || (request->order == nullptr)) {
+    throw std::invalid_argument("missing operator name or order");
+  }
+  op_request.name = request->name;
+  op_request.order = request->order;
+  op_request.abody = request->abody;
+  op_request.hbomega = request->hbomega;
+  op_request.R = request->R;
+
+  radial_params = chime::RunOptions().radial;
+  if (request->npts > 0) {
+    radial_params.npts = request->npts;
+  }
+  radial_params.tolerance = request->tolerance;
+  radial_params.screening_threshold = request->screening_threshold;
+  radial_params.analytic = (request->analytic != 0);
+  if (request->cache_directory != nullptr) {
+    radial_params.cache.directory = request->cache_directory;
+    radial_params.cache.enabled = !radial_params.cache.directory.empty();
+  }
+
+  ParametersType params;
+  params.J0 = request->J0;
+  params.g0 = request->g0;
+  params.T0_min = request->T0_min;
+  params.T0_max = request->T0_max;
+  params.Nmax = request->Nmax;
+  params.Jmax = request->Jmax;
+  params.symmetry_phase_mode = basis::SymmetryPhaseMode::kHermitian;
+  return params;
+}
+
+}  // namespace
+
+extern "C" {
+
+int chime_api_version(void) { return CHIME_API_VERSION; }
+
+const char* chime_last_error(void) { return last_error.c_str(); }
+
+void chime_operator_request_init(chime_operator_request* request)
+{
+  const chime::OperatorRequest op_request;
+  const chime::radial::RadialParameters radial_params;
+  request->name = "mm";
+  request->order = "nlo";
+  request->abody = op_request.abody;
+  request->J0 = 1;
+  request->g0 = 0;
+  request->T0_min = 1;
+  request->T0_max = 1;
+  request->Nmax = 0;
+  request->Jmax = 0;
+  request->hbomega = op_request.hbomega;
+  request->R = op_request.R;
+  request->npts = radial_params.npts;
+  request->tolerance = radial_params.tolerance;
+  request->screening_threshold = radial_params.screening_threshold;
+  request->analytic = radial_params.analytic;
+  request->cache_directory = nullptr;
+}
+
+int chime_relative_operator_create(const chime_operator_request* request,
+                                   chime_operator** op)
+{
+  if ((request == nullptr) || (op == nullptr)) {
+    return Fail("null argument");
+  }
+  chime_operator* result = new chime_operator;
+  try {
+    chime::OperatorRequest op_request;
+    chime::radial::RadialParameters radial_params;
+    const basis::RelativeOperatorParametersLSJT params =
+        ConvertRequest<basis::RelativeOperatorParametersLSJT>(
+            request, op_request, radial_params);
+    chime::ConstructRelativeOperator(params, op_request, result->relative,
+                                     radial_params);
+  }
+  catch (const std::exception& error) {
+    delete result;
+    return Fail(error.what());
+  }
+  *op = result;
+  return 0;
+}
+
+int chime_relativecm_operator_create(const chime_operator_request* request,
+                                     chime_operator** op)
+{
+  if ((request == nullptr) || (op == nullptr)) {
+    return Fail("null argument");
+  }
+  chime_operator* result = new chime_operator;
+  result->relcm = true;
+  try {
+    chime::OperatorRequest op_request;
+    chime::radial::RadialParameters radial_params;
+    const basis::RelativeCMOperatorParametersLSJT params =
+        ConvertRequest<basis::RelativeCMOperatorParametersLSJT>(
+            request, op_request, radial_params);
+    chime::ConstructRelativeCMOperator(params, op_request, result->relativecm,
+                                       radial_params);
+  }
+  catch (const std::exception& error) {
+    delete result;
+    return Fail(error.what());
+  }
+  *op = result;
+  return 0;
+}
+
+void chime_operator_destroy(chime_operator* op) { delete op; }
+
+size_t chime_operator_num_subspaces(const chime_operator* op)
+{
+  std::size_t result = 0;
+  Visit(op, [&](const auto& o) {
+    result = o.space.size();
+    return 0;
+  });
+  return result;
+}
+
+int chime_operator_subspace(const chime_operator* op, size_t subspace_index,
+                            chime_subspace_info* info)
+{
+  return Visit(op, [&](const auto& o) {
+    CheckSubspace(o, subspace_index);
+    const auto& subspace = o.space.GetSubspace(subspace_index);
+    info->L = subspace.L();
+    info->S = subspace.S();
+    info->J = subspace.J();
+    info->T = subspace.T();
+    info->g = subspace.g();
+    info->size = subspace.size();
+    return 0;
+  });
+}
+
+int chime_operator_state(const chime_operator* op, size_t subspace_index,
+                         size_t state_index, chime_state_info* info)
+{
+  if (op == nullptr) {
+    return Fail("null operator");
+  }
+  try {
+    if (op->relcm) {
+      const chime::RelativeCMOperator& o = op->relativecm;
+      CheckSubspace(o, subspace_index);
+      const basis::RelativeCMSubspaceLSJT& subspace =
+          o.space.GetSubspace(subspace_index);
+      if (state_index >= subspace.size()) {
+        return Fail("state index out of range");
+      }
+      FillStateInfo(basis::RelativeCMStateLSJT(subspace, state_index), info);
+    }
+    else {
+      const chime::RelativeOperator& o = op->relative;
+      CheckSubspace(o, subspace_index);
+      const basis::RelativeSubspaceLSJT& subspace =
+          o.space.GetSubspace(subspace_index);
+      if (state_index >= subspace.size()) {
+        return Fail("state index out of range");
+      }
+      FillStateInfo(basis::RelativeStateLSJT(subspace, state_index), info);
+    }
+  }
+  catch (const std::exception& error) {
+    return Fail(error.what());
+  }
+  return 0;
+}
+
+size_t chime_operator_num_sectors(const chime_operator* op, int T0)
+{
+  std::size_t result = 0;
+  Visit(op, [&](const auto& o) {
+    if ((T0 >= o.params.T0_min) && (T0 <= o.params.T0_max)) {
+      result = o.sectors[T0].size();
+    }
+    return 0;
+  });
+  return result;
+}
+
+int chime_operator_sector(const chime_operator* op, int T0,
+                          size_t sector_index, chime_sector_info* info)
+{
+  return Visit(op, [&](const auto& o) {
+    CheckSector(o, T0, sector_index);
+    const auto& sector = o.sectors[T0].GetSector(sector_index);
+    const basis::OperatorBlock<double>& matrix = o.matrices[T0][sector_index];
+    info->bra_subspace_index = sector.bra_subspace_index();
+    info->ket_subspace_index = sector.ket_subspace_index();
+    info->rows = matrix.rows();
+    info->cols = matrix.cols();
+    return 0;
+  });
+}
+
+const double* chime_operator_block(const chime_operator* op, int T0,
+                                   size_t sector_index)
+{
+  const double* result = nullptr;
+  Visit(op, [&](const auto& o) {
+    CheckSector(o, T0, sector_index);
+    result = o.matrices[T0][sector_index].data();
+    return 0;
+  });
+  return result;
+}
+
+int chime_operator_copy_block(const chime_operator* op, int T0,
+                              size_t sector_index, double* buffer,
+                              size_t size, size_t ld)
+{
+  return Visit(op, [&](const auto& o) {
+    CheckSector(o, T0, sector_index);
+    const Eigen::Map<const Eigen::MatrixXd> block =
+        chime::BlockMap(o, T0, sector_index);
+    const std::size_t rows = block.rows(), cols = block.cols();
+    if ((ld < rows) || ((cols > 0) && (size < ld * (cols - 1) + rows))) {
+      throw std::length_error("buffer too small for block");
+    }
+    if (cols > 0) {
+      Eigen::Map<Eigen::MatrixXd, 0, Eigen::OuterStride<>>(
+          buffer, rows, cols, Eigen::OuterStride<>(ld)) = block;
+    }
+    return 0;
+  });
+}
+
+}  // extern "C"
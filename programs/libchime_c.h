@@ -0,0 +1,115 @@
+/*******************************************************************************
+ libchime_c.h
+
+ Defines the C interface of the chime operator builders.
+
+ An operator is built into an opaque handle. Its blocks are column-major
+ arrays of doubles, which may be read in place through
+ chime_operator_block, valid until the handle is destroyed, or copied into
+ caller-provided buffers. Sectors, subspaces and states are addressed by
+ their indices in the basis library.
+
+ Functions returning int return 0 on success, and nonzero on failure, after
+ which chime_last_error describes the failure. Structures are initialized by
+ the library, so that fields added in later versions get their defaults.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef LIBCHIME_C_H_
+#define LIBCHIME_C_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIME_API_VERSION 1
+
+typedef struct chime_operator chime_operator;
+
+// Operator choice and parameters. See relative-gen.cpp for the physics
+// input, and options.h for the radial integral options.
+typedef struct chime_operator_request {
+  // Operator.
+  const char* name;
+  const char* order;
+  int abody;
+
+  // Tensor properties and truncation. Jmax is ignored for relative-cm
+  // operators.
+  int J0, g0, T0_min, T0_max;
+  int Nmax, Jmax;
+
+  // Oscillator energy in MeV, and LENPIC SCS regulator in fm.
+  double hbomega;
+  double R;
+
+  // Radial integrals. A NULL cache directory selects the default one, and
+  // an empty one disables the cache.
+  int npts;
+  double tolerance;
+  double screening_threshold;
+  int analytic;
+  const char* cache_directory;
+} chime_operator_request;
+
+typedef struct chime_sector_info {
+  size_t bra_subspace_index, ket_subspace_index;
+  size_t rows, cols;
+} chime_sector_info;
+
+typedef struct chime_subspace_info {
+  int L, S, J, T, g;
+  size_t size;
+} chime_subspace_info;
+
+// Oscillator quanta and orbital angular momenta of a state. Relative states
+// have Nc = lc = 0.
+typedef struct chime_state_info {
+  int Nr, lr, Nc, lc;
+} chime_state_info;
+
+int chime_api_version(void);
+
+// Description of the last failure in the calling thread.
+const char* chime_last_error(void);
+
+// Sets the defaults of the generators, for the 2n NLO magnetic moment.
+void chime_operator_request_init(chime_operator_request* request);
+
+int chime_relative_operator_create(const chime_operator_request* request,
+                                   chime_operator** op);
+int chime_relativecm_operator_create(const chime_operator_request* request,
+                                     chime_operator** op);
+void chime_operator_destroy(chime_operator* op);
+
+size_t chime_operator_num_subspaces(const chime_operator* op);
+int chime_operator_subspace(const chime_operator* op, size_t subspace_index,
+                            chime_subspace_info* info);
+int chime_operator_state(const chime_operator* op, size_t subspace_index,
+                         size_t state_index, chime_state_info* info);
+
+size_t chime_operator_num_sectors(const chime_operator* op, int T0);
+int chime_operator_sector(const chime_operator* op, int T0,
+                          size_t sector_index, chime_sector_info* info);
+
+// Block of reduced matrix elements, rows x cols in column-major order, or
+// NULL on failure.
+const double* chime_operator_block(const chime_operator* op, int T0,
+                                   size_t sector_index);
+
+// Copies a block into `buffer` of `size` doubles, in column-major order with
+// leading dimension `ld` >= rows.
+int chime_operator_copy_block(const chime_operator* op, int T0,
+                              size_t sector_index, double* buffer,
+                              size_t size, size_t ld);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
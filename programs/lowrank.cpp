@@ -0,0 +1,232 @@
+#include "lowrank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace chime {
+namespace radial {
+
+// Truncated singular value decomposition of `matrix`.
+LowRankBlock TruncatedSVD(const Eigen::MatrixXd& matrix,
+                          const double& tolerance)
+{
+  LowRankBlock block;
+  if (matrix.size() == 0) {
+    block.left.resize(matrix.rows(), 0);
+    block.right.resize(matrix.cols(), 0);
+    return block;
+  }
+  const Eigen::BDCSVD<Eigen::MatrixXd> svd(
+      matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+  const Eigen::VectorXd& sigma = svd.singularValues();
+
+  // Smallest rank whose discarded tail is within the tolerance.
+  const double allowed = tolerance * sigma.norm();
+  int rank = sigma.size();
+  double tail = 0;
+  while ((rank > 0)
+         && (std::sqrt(tail + sigma(rank - 1) * sigma(rank - 1)) <= allowed)) {
+    tail += sigma(rank - 1) * sigma(rank - 1);
+    --rank;
+  }
+  block.left = svd.matrixU().leftCols(rank) * sigma.head(rank).asDiagonal();
+  block.right = svd.matrixV().leftCols(rank);
+  block.error = std::sqrt(tail);
+  return block;
+}
+
+LowRankRadialIntegralTable::LowRankRadialIntegralTable(
+    const RadialIntegralTable& table, const double& tolerance)
+    : num_kernels_(table.num_kernels()),
+      max_delta_l_(table.max_delta_l()),
+      nmax_by_l_(table.nmax_by_l()),
+      tolerance_(tolerance)
+{
+  const int lmax = table.lmax();
+  blocks_.resize(std::size_t(num_kernels_) * (lmax + 1) * (lmax + 1));
+#pragma omp parallel for collapse(3) schedule(dynamic)
+  for (int kernel = 0; kernel < num_kernels_; ++kernel) {
+    for (int bra_l = 0; bra_l <= lmax; ++bra_l) {
+      for (int ket_l = 0; ket_l <= lmax; ++ket_l) {
+        if (table.HasBlock(bra_l, ket_l)) {
+          blocks_[index(kernel, bra_l, ket_l)] =
+              TruncatedSVD(table.block(kernel, bra_l, ket_l), tolerance);
+        }
+      }
+    }
+  }
+}
+
+std::size_t LowRankRadialIntegralTable::index(const int& kernel,
+                                              const int& bra_l,
+                                              const int& ket_l) const
+{
+  const std::size_t num_l = nmax_by_l_.size();
+  return (kernel * num_l + bra_l) * num_l + ket_l;
+}
+
+const LowRankBlock& LowRankRadialIntegralTable::block(const int& kernel,
+                                                      const int& bra_l,
+                                                      const int& ket_l) const
+{
+  assert(std::abs(bra_l - ket_l) <= max_delta_l_);
+  return blocks_[index(kernel, bra_l, ket_l)];
+}
+
+std::size_t LowRankRadialIntegralTable::size() const
+{
+  std::size_t result = 0;
+  for (const auto& block : blocks_) {
+    result += block.left.size() + block.right.size();
+  }
+  return result;
+}
+
+int LowRankRadialIntegralTable::max_rank() const
+{
+  int result = 0;
+  for (const auto& block : blocks_) {
+    result = std::max(result, block.rank());
+  }
+  return result;
+}
+
+double LowRankRadialIntegralTable::max_error() const
+{
+  double result = 0;
+  for (const auto& block : blocks_) {
+    result = std::max(result, block.error);
+  }
+  return result;
+}
+
+RadialIntegralTable LowRankRadialIntegralTable::Expand() const
+{
+  RadialIntegralTable table(num_kernels_, max_delta_l_, nmax_by_l_);
+  for (int kernel = 0; kernel < num_kernels_; ++kernel) {
+    for (const auto& pair : table.blocks()) {
+      const LowRankBlock& factors = block(kernel, pair.first, pair.second);
+      table.mutable_block(kernel, pair.first, pair.second) =
+          factors.left * factors.right.transpose();
+    }
+  }
+  return table;
+}
+
+void WriteLowRankRadialIntegrals(const std::string& filename,
+                                 const LowRankRadialIntegralTable& table,
+                                 const std::vector<std::string>& kernel_names)
+{
+  assert(int(kernel_names.size()) == table.num_kernels());
+  std::ofstream file(filename);
+  file << "# chime low-rank radial integrals\n";
+  file << "# kernels " << table.num_kernels() << " max_delta_l "
+       << table.max_delta_l() << " tolerance " << table.tolerance() << "\n";
+  file << "# nmax_by_l";
+  for (const int& nmax : table.nmax_by_l()) {
+    file << " " << nmax;
+  }
+  file << "\n";
+
+  const int lmax = int(table.nmax_by_l().size()) - 1;
+  std::ofstream index(filename + ".index");
+  file << std::scientific << std::setprecision(16);
+  for (int kernel = 0; kernel < table.num_kernels(); ++kernel) {
+    for (int bra_l = 0; bra_l <= lmax; ++bra_l) {
+      for (int ket_l = std::max(bra_l - table.max_delta_l(), 0);
+           ket_l <= std::min(bra_l + table.max_delta_l(), lmax); ++ket_l) {
+        const LowRankBlock& block = table.block(kernel, bra_l, ket_l);
+        index << kernel_names[kernel] << " " << bra_l << " " << ket_l << " "
+              << block.left.rows() << " " << block.right.rows() << " "
+              << block.rank() << " " << file.tellp() << "\n";
+        file << kernel_names[kernel] << " " << bra_l << " " << ket_l << " "
+             << block.rank() << " " << block.error << "\n";
+        if (block.rank() > 0) {
+          file << block.left << "\n" << block.right << "\n";
+        }
+      }
+    }
+  }
+  if (!file.good() || !index.good()) {
+    std::cerr << "Error writing " << filename << "\n";
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+LowRankBlock ReadLowRankBlock(const std::string& filename,
+                              const std::string& kernel_name,
+                              const int& bra_l, const int& ket_l)
+{
+  // Find the block in the index.
+  std::ifstream index(filename + ".index");
+  if (!index) {
+    throw std::runtime_error("cannot read index " + filename + ".index");
+  }
+  std::string name;
+  int index_bra_l, index_ket_l, bra_rows, ket_rows, rank;
+  std::streamoff offset;
+  bool found = false;
+  while (!found && (index >> name >> index_bra_l >> index_ket_l >> bra_rows
+                    >> ket_rows >> rank >> offset)) {
+    found = (name == kernel_name) && (index_bra_l == bra_l)
+            && (index_ket_l == ket_l);
+  }
+  if (!found) {
+    throw std::runtime_error("no block " + kernel_name + " "
+                             + std::to_string(bra_l) + " "
+                             + std::to_string(ket_l) + " in " + filename);
+  }
+
+  // Read its header line and factors.
+  std::ifstream file(filename);
+  file.seekg(offset);
+  LowRankBlock block;
+  block.left.resize(bra_rows, rank);
+  block.right.resize(ket_rows, rank);
+  int file_bra_l, file_ket_l, file_rank;
+  file >> name >> file_bra_l >> file_ket_l >> file_rank >> block.error;
+  for (int row = 0; row < bra_rows * (rank > 0); ++row) {
+    for (int col = 0; col < rank; ++col) {
+      file >> block.left(row, col);
+    }
+  }
+  for (int row = 0; row < ket_rows * (rank > 0); ++row) {
+    for (int col = 0; col < rank; ++col) {
+      file >> block.right(row, col);
+    }
+  }
+  if (!file || (name != kernel_name) || (file_bra_l != bra_l)
+      || (file_ket_l != ket_l) || (file_rank != rank)) {
+    throw std::runtime_error("cannot read block " + kernel_name + " "
+                             + std::to_string(bra_l) + " "
+                             + std::to_string(ket_l) + " from " + filename);
+  }
+  return block;
+}
+
+RadialIntegrals CompressRadialIntegrals(
+    RadialIntegralTable table, const RadialParameters& params,
+    const std::vector<std::string>& kernel_names)
+{
+  if (params.low_rank_tolerance <= 0) {
+    return RadialIntegrals(std::move(table));
+  }
+  std::cout << "  Compressing radial integrals...\n";
+  LowRankRadialIntegralTable low_rank(table, params.low_rank_tolerance);
+  std::cout << "  Low-rank radial integrals: max rank " << low_rank.max_rank()
+            << ", " << low_rank.size() << " of " << table.size()
+            << " values, max block error " << low_rank.max_error() << "\n";
+  if (!params.low_rank_filename.empty()) {
+    WriteLowRankRadialIntegrals(params.low_rank_filename, low_rank,
+                                kernel_names);
+  }
+  return RadialIntegrals(std::move(low_rank));
+}
+
+}  // namespace radial
+}  // namespace chime
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ lowrank.h
+
+ Defines a low-rank representation of radial integral tables. Radial blocks
+ of smooth kernels between oscillator functions are numerically low-rank, so
+ that each (l', l) block of each kernel is stored as a truncated singular
+ value decomposition
+
+   block(n', n) ~ sum_i left(n', i) right(n, i),
+
+ with the singular values folded into the left factor. The rank of each block
+ is the smallest one for which the discarded singular values have Frobenius
+ norm at most tolerance times the Frobenius norm of the block.
+
+ The builders keep the factors through the assembly of the operator, and
+ evaluate each integral as the product of a row of each factor, so that the
+ dense table is only held while it is compressed.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef LOWRANK_H_
+#define LOWRANK_H_
+
+#include <Eigen/Dense>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "radial.h"
+
+namespace chime {
+namespace radial {
+
+// Truncated factorization left * right^T of a radial integral block.
+struct LowRankBlock {
+  Eigen::MatrixXd left;
+  Eigen::MatrixXd right;
+  double error = 0;  // Frobenius norm of the discarded part
+
+  int rank() const { return left.cols(); }
+};
+
+// Low-rank representation of all blocks of a RadialIntegralTable.
+class LowRankRadialIntegralTable {
+ public:
+  LowRankRadialIntegralTable() = default;
+
+  // Arguments:
+  //   table (RadialIntegralTable): table to compress
+  //   tolerance (double): relative Frobenius norm error of each block
+  LowRankRadialIntegralTable(const RadialIntegralTable& table,
+                             const double& tolerance);
+
+  int num_kernels() const { return num_kernels_; }
+  int max_delta_l() const { return max_delta_l_; }
+  const std::vector<int>& nmax_by_l() const { return nmax_by_l_; }
+  int lmax() const { return int(nmax_by_l_.size()) - 1; }
+  double tolerance() const { return tolerance_; }
+
+  // Whether the table contains integrals between l' and l.
+  bool HasBlock(const int& bra_l, const int& ket_l) const
+  {
+    return (bra_l >= 0) && (ket_l >= 0) && (bra_l <= lmax())
+           && (ket_l <= lmax()) && (std::abs(bra_l - ket_l) <= max_delta_l_);
+  }
+
+  // Factors of the block of kernel `kernel` between l' and l.
+  const LowRankBlock& block(const int& kernel, const int& bra_l,
+                            const int& ket_l) const;
+
+  // Integral <n' l'| kernel |n l> of the factors.
+  double operator()(const int& kernel, const int& bra_l, const int& bra_n,
+                    const int& ket_l, const int& ket_n) const
+  {
+    const LowRankBlock& factors = block(kernel, bra_l, ket_l);
+    return factors.left.row(bra_n).dot(factors.right.row(ket_n));
+  }
+
+  // Number of doubles stored in the factors.
+  std::size_t size() const;
+
+  // Largest rank, and largest Frobenius norm error, over all blocks.
+  int max_rank() const;
+  double max_error() const;
+
+  // Table assembled from the factors.
+  RadialIntegralTable Expand() const;
+
+ private:
+  std::size_t index(const int& kernel, const int& bra_l,
+                    const int& ket_l) const;
+
+  int num_kernels_ = 0;
+  int max_delta_l_ = 0;
+  std::vector<int> nmax_by_l_;
+  double tolerance_ = 0;
+  std::vector<LowRankBlock> blocks_;
+};
+
+// Radial integrals of a builder, either as a table or as the low-rank
+// factors of a table.
+class RadialIntegrals {
+ public:
+  explicit RadialIntegrals(RadialIntegralTable table)
+      : low_rank_(false), table_(std::move(table))
+  {
+  }
+  explicit RadialIntegrals(LowRankRadialIntegralTable low_rank_table)
+      : low_rank_(true), low_rank_table_(std::move(low_rank_table))
+  {
+  }
+
+  bool low_rank() const { return low_rank_; }
+
+  bool HasBlock(const int& bra_l, const int& ket_l) const
+  {
+    return low_rank_ ? low_rank_table_.HasBlock(bra_l, ket_l)
+                     : table_.HasBlock(bra_l, ket_l);
+  }
+
+  // Integral <n' l'| kernel |n l>.
+  double operator()(const int& kernel, const int& bra_l, const int& bra_n,
+                    const int& ket_l, const int& ket_n) const
+  {
+    return low_rank_ ? low_rank_table_(kernel, bra_l, bra_n, ket_l, ket_n)
+                     : table_(kernel, bra_l, bra_n, ket_l, ket_n);
+  }
+
+ private:
+  bool low_rank_;
+  RadialIntegralTable table_;
+  LowRankRadialIntegralTable low_rank_table_;
+};
+
+// Writes the factors of `table` to a text file. Each block is written as a
+// header line
+//
+//   kernel_name bra_l ket_l rank error
+//
+// followed by the rows of the left factor and the rows of the right factor.
+// The sidecar index `filename`.index has a line
+//
+//   kernel_name bra_l ket_l bra_rows ket_rows rank offset
+//
+// for each block, with the byte offset of its header line.
+void WriteLowRankRadialIntegrals(const std::string& filename,
+                                 const LowRankRadialIntegralTable& table,
+                                 const std::vector<std::string>& kernel_names);
+
+// Reads the factors of the block `kernel_name` (bra_l, ket_l) from the text
+// file `filename` written by WriteLowRankRadialIntegrals, with a seek to its
+// offset in the sidecar index.
+//
+// Throws:
+//   std::runtime_error if the files cannot be read, or the index has no such
+//   block
+LowRankBlock ReadLowRankBlock(const std::string& filename,
+                              const std::string& kernel_name,
+                              const int& bra_l, const int& ket_l);
+
+// Applies the low-rank options of `params` to `table`. If
+// params.low_rank_tolerance > 0, compresses the table, reports the ranks,
+// optionally exports the factors to params.low_rank_filename, and returns the
+// factors, releasing the table. Otherwise returns `table` unchanged.
+RadialIntegrals CompressRadialIntegrals(
+    RadialIntegralTable table, const RadialParameters& params,
+    const std::vector<std::string>& kernel_names);
+
+}  // namespace radial
+}  // namespace chime
+
+#endif
@@ -5,12 +5,16 @@ $(eval $(begin-module))
 ################################################################
 
 module_units_h += chime constants tprme
-module_units_cpp-h := relative_rme relativecm_rme
+module_units_cpp-h := relative_rme relativecm_rme radial simd cache options
+module_units_cpp-h += yukawa lowrank libchime libchime_c instrument partition
+module_units_cpp-h += numa moshinsky labframe plan compress wigner
 # module_units_f :=
 
-module_programs_cpp += relative-gen relativecm-gen
+module_programs_cpp += relative-gen relativecm-gen chime-batch chime-bench
 module_programs_cpp_test := relative_rme_test relativecm_rme_test
-module_programs_cpp_test += wigner_test
+module_programs_cpp_test += wigner_test yukawa_test partition_test
+module_programs_cpp_test += moshinsky_test compress_test radial_test
+module_programs_cpp_test += labframe_test
 # module_programs_f :=
 # module_generated :=
 
@@ -20,4 +24,26 @@ module_programs_cpp_test += wigner_test
 
 $(eval $(library))
 
+################################################################
+# special variable assignments, rules, and dependencies
+################################################################
+
+# Shared library for the Python bindings (chime.py), built by
+# `make programs/libchime.so`. Its objects are compiled separately as
+# position independent code, and the libraries of the submodules are linked
+# in, callers first. -Bsymbolic lets the linker take the archive members as
+# compiled by default, i.e. position independent executable code.
+libchime_objects := $(addprefix $(current-dir)/,\
+  $(addsuffix .pic.o,$(module_units_cpp-h)))
+libchime_libraries := $(addprefix libraries/,\
+  basis/libbasis.a am/libam.a mcutils/libmcutils.a)
+$(libchime_objects): $(current-dir)/%.pic.o: $(current-dir)/%.cpp \
+  $(current-dir)/%.h
+	$(CXX) $(CPPFLAGS) $(CXXFLAGS) -fPIC -c -o $@ $<
+$(current-dir)/libchime.so: $(libchime_objects) $(libchime_libraries)
+	$(CXX) -shared $(CXXFLAGS) $(LDFLAGS) -Wl,-Bsymbolic -o $@ $^ $(LDLIBS)
+
+# MPI mode of the generators (partition.h): build with an MPI compiler
+# wrapper and CXXFLAGS += -DCHIME_MPI.
+
 $(eval $(end-module))
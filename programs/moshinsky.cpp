@@ -0,0 +1,213 @@
+#include "moshinsky.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <tuple>
+#include <utility>
+
+#include "am/am.h"
+#include "am/wigner_gsl.h"
+#include "instrument.h"
+
+namespace chime {
+namespace moshinsky {
+
+namespace {
+
+// Rotation angle from two-particle to relative-cm coordinates.
+const double kTheta = std::atan(1.);
+
+// Reduced matrix element <n' l'||a^+||n l>, in the Edmonds convention, of
+// the dimensionless oscillator raising operator.
+double RaisingRME(const int& bra_n, const int& bra_l, const int& ket_n,
+                  const int& ket_l)
+{
+  if ((bra_l == ket_l + 1) && (bra_n == ket_n)) {
+    return std::sqrt((2. * ket_n + 2. * ket_l + 3.) * (ket_l + 1.));
+  }
+  if ((bra_l == ket_l - 1) && (bra_n == ket_n + 1)) {
+    return std::sqrt(2. * ket_l * (ket_n + 1.));
+  }
+  return 0;
+}
+
+// Reduced matrix element <n' l'||a||n l> of the lowering operator, as
+// RaisingRME.
+double LoweringRME(const int& bra_n, const int& bra_l, const int& ket_n,
+                   const int& ket_l)
+{
+  if ((bra_l == ket_l - 1) && (bra_n == ket_n)) {
+    return -std::sqrt((2. * ket_n + 2. * ket_l + 1.) * ket_l);
+  }
+  if ((bra_l == ket_l + 1) && (bra_n == ket_n - 1)) {
+    return -std::sqrt(2. * ket_n * (ket_l + 1.));
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool operator<(const OrbitalPair& a, const OrbitalPair& b)
+{
+  return std::tie(a.n1, a.l1, a.n2, a.l2) < std::tie(b.n1, b.l1, b.n2, b.l2);
+}
+
+std::vector<OrbitalPair> OrbitalPairs(const int& N, const int& Lambda)
+{
+  std::vector<OrbitalPair> pairs;
+  for (int n1 = 0; 2 * n1 <= N; ++n1) {
+    for (int l1 = 0; 2 * n1 + l1 <= N; ++l1) {
+      const int N2 = N - 2 * n1 - l1;
+      for (int n2 = 0; 2 * n2 <= N2; ++n2) {
+        const int l2 = N2 - 2 * n2;
+        if (am::AllowedTriangle(l1, l2, Lambda)) {
+          pairs.push_back({n1, l1, n2, l2});
+        }
+      }
+    }
+  }
+  return pairs;
+}
+
+Eigen::MatrixXd BracketMatrix(const int& N, const int& Lambda)
+{
+  const std::vector<OrbitalPair> pairs = OrbitalPairs(N, Lambda);
+  const int dimension = int(pairs.size());
+  if (dimension == 0) {
+    return Eigen::MatrixXd();
+  }
+
+  // Generator D = a1^+ . a2 - a1 . a2^+, a scalar product of operators on
+  // particles 1 and 2 (Edmonds 7.1.6).
+  Eigen::MatrixXd generator = Eigen::MatrixXd::Zero(dimension, dimension);
+  for (int ket_index = 0; ket_index < dimension; ++ket_index) {
+    const OrbitalPair& ket = pairs[ket_index];
+    for (int bra_index = 0; bra_index < dimension; ++bra_index) {
+      const OrbitalPair& bra = pairs[bra_index];
+      const double radial =
+          RaisingRME(bra.n1, bra.l1, ket.n1, ket.l1)
+              * LoweringRME(bra.n2, bra.l2, ket.n2, ket.l2)
+          - LoweringRME(bra.n1, bra.l1, ket.n1, ket.l1)
+                * RaisingRME(bra.n2, bra.l2, ket.n2, ket.l2);
+      if (radial == 0) {
+        continue;
+      }
+      generator(bra_index, ket_index) =
+          ParitySign(ket.l1 + bra.l2 + Lambda)
+          * am::Wigner6J(Lambda, bra.l2, bra.l1, 1, ket.l1, ket.l2) * radial;
+    }
+  }
+
+  // exp(-theta D) = cos(theta W) - sin(theta W) / W D, with W^2 = -D^2.
+  const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(
+      generator.transpose() * generator);
+  Eigen::ArrayXd cosines(dimension), sincs(dimension);
+  for (int index = 0; index < dimension; ++index) {
+    const double omega = std::sqrt(std::max(solver.eigenvalues()(index), 0.));
+    cosines(index) = std::cos(kTheta * omega);
+    sincs(index) =
+        (omega > 0) ? std::sin(kTheta * omega) / omega : kTheta;
+  }
+  const Eigen::MatrixXd& vectors = solver.eigenvectors();
+  return vectors * cosines.matrix().asDiagonal() * vectors.transpose()
+         - vectors * sincs.matrix().asDiagonal() * vectors.transpose()
+               * generator;
+}
+
+BracketTable::BracketTable(const int& Nmax,
+                           const cache::CacheParameters& params)
+    : Nmax_(Nmax)
+{
+  assert(Nmax >= 0);
+  instrument::ScopedPhase phase(instrument::Phase::kBrackets);
+  const std::size_t num_blocks = BlockIndex(Nmax + 1, 0);
+  std::vector<std::pair<int, int>> labels(num_blocks);
+  pairs_.resize(num_blocks);
+  offsets_.assign(num_blocks + 1, 0);
+  for (int N = 0; N <= Nmax; ++N) {
+    for (int Lambda = 0; Lambda <= N; ++Lambda) {
+      const std::size_t index = BlockIndex(N, Lambda);
+      labels[index] = {N, Lambda};
+      pairs_[index] = OrbitalPairs(N, Lambda);
+      offsets_[index + 1] =
+          offsets_[index] + pairs_[index].size() * pairs_[index].size();
+    }
+  }
+
+  // Metadata: Nmax.
+  cache::KeyBuilder key("moshinsky");
+  key.Add(Nmax);
+  cache::Entry entry;
+  if (cache::LoadEntry(params, key, entry)
+      && (entry.metadata == std::vector<std::int64_t>{Nmax})
+      && (entry.payload_size == offsets_.back())) {
+    owner_ = std::move(entry.owner);
+    data_ = entry.payload;
+    std::cout << "  Loaded Moshinsky brackets from cache entry " << key.str()
+              << "\n";
+    return;
+  }
+
+  std::cout << "  Calculating Moshinsky brackets...\n";
+  const auto storage = std::make_shared<std::vector<double>>(offsets_.back());
+#pragma omp parallel for schedule(dynamic)
+  for (std::size_t index = 0; index < num_blocks; ++index) {
+    const Eigen::MatrixXd brackets =
+        BracketMatrix(labels[index].first, labels[index].second);
+    std::copy(brackets.data(), brackets.data() + brackets.size(),
+              storage->data() + offsets_[index]);
+  }
+  data_ = storage->data();
+  owner_ = storage;
+
+  if (cache::StoreEntry(params, key, {Nmax}, data_, offsets_.back())) {
+    std::cout << "  Stored Moshinsky brackets in cache entry " << key.str()
+              << "\n";
+  }
+}
+
+Eigen::Map<const Eigen::MatrixXd> BracketTable::block(const int& N,
+                                                      const int& Lambda) const
+{
+  const std::size_t index = BlockIndex(N, Lambda);
+  const Eigen::Index dimension = pairs_[index].size();
+  return Eigen::Map<const Eigen::MatrixXd>(data_ + offsets_[index],
+                                           dimension, dimension);
+}
+
+int BracketTable::PairIndex(const int& N, const int& Lambda,
+                            const OrbitalPair& pair) const
+{
+  const std::vector<OrbitalPair>& block_pairs = pairs(N, Lambda);
+  const auto position =
+      std::lower_bound(block_pairs.begin(), block_pairs.end(), pair);
+  if ((position == block_pairs.end()) || (pair < *position)) {
+    return -1;
+  }
+  return int(position - block_pairs.begin());
+}
+
+double BracketTable::Bracket(const OrbitalPair& relative_cm,
+                             const OrbitalPair& two_particle,
+                             const int& Lambda) const
+{
+  const int N = 2 * relative_cm.n1 + relative_cm.l1 + 2 * relative_cm.n2
+                + relative_cm.l2;
+  if ((N > Nmax_) || (Lambda < 0) || (Lambda > N)
+      || (2 * two_particle.n1 + two_particle.l1 + 2 * two_particle.n2
+              + two_particle.l2
+          != N)) {
+    return 0;
+  }
+  const int bra_index = PairIndex(N, Lambda, relative_cm);
+  const int ket_index = PairIndex(N, Lambda, two_particle);
+  if ((bra_index < 0) || (ket_index < 0)) {
+    return 0;
+  }
+  return block(N, Lambda)(bra_index, ket_index);
+}
+
+}  // namespace moshinsky
+}  // namespace chime
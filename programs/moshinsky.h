@@ -0,0 +1,105 @@
+/*******************************************************************************
+ moshinsky.h
+
+ Defines the Moshinsky brackets between two-particle and relative-cm
+ oscillator states,
+
+   <n l, N L; Lambda | n1 l1, n2 l2; Lambda>,
+
+ with relative and cm coordinates r = (r1 - r2) / sqrt(2) and
+ R = (r1 + r2) / sqrt(2), and all oscillator functions of the same length,
+ positive at the origin. The brackets vanish unless
+ 2 n + l + 2 N + L = 2 n1 + l1 + 2 n2 + l2.
+
+ The change of coordinates is a rotation by pi/4 in the plane of the two
+ particles, exp(pi/4 D), generated by D = a1^+ . a2 - a2^+ . a1. D conserves
+ the total number of quanta, so the brackets of total quanta N and angular
+ momentum Lambda are the matrix exp(-pi/4 D) of the few pairs of that N and
+ Lambda, calculated exactly from the eigenvalues of D^2. The brackets of all
+ N up to a truncation are tabulated once, in parallel over the blocks, and
+ kept in the on-disk cache between runs.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef MOSHINSKY_H_
+#define MOSHINSKY_H_
+
+#include <Eigen/Dense>
+#include <memory>
+#include <vector>
+
+#include "cache.h"
+
+namespace chime {
+namespace moshinsky {
+
+// Oscillator labels of two particles, (n1 l1) and (n2 l2), or of the
+// relative and cm motion.
+struct OrbitalPair {
+  int n1;
+  int l1;
+  int n2;
+  int l2;
+};
+
+bool operator<(const OrbitalPair& a, const OrbitalPair& b);
+
+// Pairs of total quanta N which couple to Lambda, in lexicographic order.
+std::vector<OrbitalPair> OrbitalPairs(const int& N, const int& Lambda);
+
+// Brackets of total quanta N and angular momentum Lambda. Element (i, j) is
+// <pairs[i]; Lambda | pairs[j]; Lambda>, with relative-cm labels pairs[i] and
+// two-particle labels pairs[j], for the pairs of OrbitalPairs(N, Lambda).
+Eigen::MatrixXd BracketMatrix(const int& N, const int& Lambda);
+
+// Brackets of all total quanta up to Nmax.
+class BracketTable {
+ public:
+  BracketTable() : Nmax_(-1) {}
+
+  // Loads the table from the cache of `params`, or calculates it and stores
+  // it there.
+  BracketTable(const int& Nmax,
+               const cache::CacheParameters& params = cache::CacheParameters());
+
+  int Nmax() const { return Nmax_; }
+
+  // Pairs of the block of N and Lambda.
+  const std::vector<OrbitalPair>& pairs(const int& N, const int& Lambda) const
+  {
+    return pairs_[BlockIndex(N, Lambda)];
+  }
+
+  // Brackets of N and Lambda, as BracketMatrix.
+  Eigen::Map<const Eigen::MatrixXd> block(const int& N,
+                                          const int& Lambda) const;
+
+  // Bracket <relative_cm; Lambda | two_particle; Lambda>, zero unless both
+  // pairs are of the same total quanta up to Nmax and couple to Lambda.
+  double Bracket(const OrbitalPair& relative_cm,
+                 const OrbitalPair& two_particle, const int& Lambda) const;
+
+ private:
+  static std::size_t BlockIndex(const int& N, const int& Lambda)
+  {
+    return std::size_t(N) * (N + 1) / 2 + Lambda;
+  }
+
+  // Index of `pair` in the block of N and Lambda, or -1 if there is none.
+  int PairIndex(const int& N, const int& Lambda,
+                const OrbitalPair& pair) const;
+
+  int Nmax_;
+  std::vector<std::vector<OrbitalPair>> pairs_;
+  std::vector<std::size_t> offsets_;  // of the blocks in data_
+  const double* data_ = nullptr;
+  std::shared_ptr<const void> owner_;  // of data_, calculated or mapped
+};
+
+}  // namespace moshinsky
+}  // namespace chime
+
+#endif
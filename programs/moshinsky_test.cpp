@@ -0,0 +1,95 @@
+/*******************************************************************************
+ moshinsky_test.cpp
+
+ Checks the Moshinsky brackets: orthogonality, the brackets of one quantum
+ and the 0s-1s brackets of two quanta, known in closed form, and the
+ exchange of the particles, which is the square of the transformation, a
+ rotation by pi/2.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "am/am.h"
+#include "moshinsky.h"
+
+int main()
+{
+  bool passed = true;
+  const int Nmax = 8;
+  const double tolerance = 1e-12;
+
+  double orthogonality = 0, exchange = 0;
+  for (int N = 0; N <= Nmax; ++N) {
+    for (int Lambda = 0; Lambda <= N; ++Lambda) {
+      const std::vector<chime::moshinsky::OrbitalPair> pairs =
+          chime::moshinsky::OrbitalPairs(N, Lambda);
+      if (pairs.empty()) {
+        continue;
+      }
+      const Eigen::MatrixXd brackets =
+          chime::moshinsky::BracketMatrix(N, Lambda);
+      const Eigen::MatrixXd identity =
+          Eigen::MatrixXd::Identity(pairs.size(), pairs.size());
+      orthogonality = std::max(
+          orthogonality,
+          (brackets * brackets.transpose() - identity).cwiseAbs().maxCoeff());
+
+      // Rotation by pi/2: |a b; Lambda> -> (-)^(l_a - Lambda) |b a; Lambda>.
+      const Eigen::MatrixXd square = brackets * brackets;
+      for (std::size_t bra = 0; bra < pairs.size(); ++bra) {
+        for (std::size_t ket = 0; ket < pairs.size(); ++ket) {
+          const bool swapped = (pairs[ket].n1 == pairs[bra].n2)
+                               && (pairs[ket].l1 == pairs[bra].l2)
+                               && (pairs[ket].n2 == pairs[bra].n1)
+                               && (pairs[ket].l2 == pairs[bra].l1);
+          const double expected =
+              swapped ? ParitySign(pairs[bra].l2 - Lambda) : 0.;
+          exchange =
+              std::max(exchange, std::abs(square(bra, ket) - expected));
+        }
+      }
+    }
+  }
+  std::cout << "Largest deviation from orthogonality " << orthogonality
+            << "\n";
+  std::cout << "Largest deviation of the exchange " << exchange << "\n";
+  passed &= (orthogonality < tolerance) && (exchange < tolerance);
+
+  // r1 = (r + R) / sqrt(2), r2 = (R - r) / sqrt(2), and, for 0s 1s,
+  // 3/2 - r2^2 = (3/2 - r^2) / 2 + (3/2 - R^2) / 2 + r.R.
+  const chime::moshinsky::BracketTable table(2);
+  const double half = std::sqrt(0.5);
+  const struct {
+    chime::moshinsky::OrbitalPair relative_cm, two_particle;
+    int Lambda;
+    double value;
+  } cases[] = {
+      {{0, 1, 0, 0}, {0, 1, 0, 0}, 1, half},
+      {{0, 0, 0, 1}, {0, 1, 0, 0}, 1, half},
+      {{0, 1, 0, 0}, {0, 0, 0, 1}, 1, -half},
+      {{0, 0, 0, 1}, {0, 0, 0, 1}, 1, half},
+      {{1, 0, 0, 0}, {0, 0, 1, 0}, 0, 0.5},
+      {{0, 0, 1, 0}, {0, 0, 1, 0}, 0, 0.5},
+      {{0, 1, 0, 1}, {0, 0, 1, 0}, 0, -half},
+  };
+  for (const auto& test : cases) {
+    const double bracket =
+        table.Bracket(test.relative_cm, test.two_particle, test.Lambda);
+    std::cout << "<" << test.relative_cm.n1 << " " << test.relative_cm.l1
+              << ", " << test.relative_cm.n2 << " " << test.relative_cm.l2
+              << "; " << test.Lambda << " | " << test.two_particle.n1 << " "
+              << test.two_particle.l1 << ", " << test.two_particle.n2 << " "
+              << test.two_particle.l2 << "; " << test.Lambda
+              << "> = " << bracket << " (expected " << test.value << ")\n";
+    passed &= (std::abs(bracket - test.value) < tolerance);
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
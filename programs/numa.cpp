@@ -0,0 +1,184 @@
+#include "numa.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "instrument.h"
+
+namespace chime {
+namespace numa {
+
+bool enabled = false;
+
+namespace {
+
+int num_nodes = 0;
+thread_local int thread_node = -1;
+
+// CPUs of a cpulist, e.g., "0-15,32-47".
+std::vector<int> ParseCPUList(const std::string& cpulist)
+{
+  std::vector<int> cpus;
+  std::istringstream stream(cpulist);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    const std::size_t dash = range.find('-');
+    try {
+      const int first = std::stoi(range.substr(0, dash));
+      const int last = (dash == std::string::npos)
+                           ? first
+                           : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    catch (const std::exception&) {
+      // Skip malformed ranges, e.g., the empty list of a memory-only node.
+    }
+  }
+  return cpus;
+}
+
+}  // namespace
+
+Topology ReadTopology()
+{
+  Topology topology;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return topology;
+  }
+  for (int node = 0;; ++node) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node)
+                       + "/cpulist");
+    if (!file) {
+      break;
+    }
+    std::string cpulist;
+    std::getline(file, cpulist);
+    std::vector<int> cpus;
+    for (const int cpu : ParseCPUList(cpulist)) {
+      if ((cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      topology.node_cpus.push_back(cpus);
+    }
+  }
+
+  // No NUMA information.
+  if (topology.node_cpus.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    topology.node_cpus.push_back(cpus);
+  }
+#endif
+  return topology;
+}
+
+Topology Share(const Topology& topology, const int& part,
+               const int& num_parts)
+{
+  const int nodes = int(topology.node_cpus.size());
+  Topology share;
+  share.node_cpus.resize(nodes);
+  if (nodes == 0) {
+    return share;
+  }
+  const int node = part % nodes;
+  const int num_node_parts = (num_parts - node + nodes - 1) / nodes;
+  const int slot = part / nodes;
+  const std::vector<int>& cpus = topology.node_cpus[node];
+  const std::size_t begin = slot * cpus.size() / num_node_parts;
+  const std::size_t end = (slot + 1) * cpus.size() / num_node_parts;
+  if (begin < end) {
+    share.node_cpus[node].assign(cpus.begin() + begin, cpus.begin() + end);
+  }
+  else {
+    share.node_cpus[node] = cpus;
+  }
+  return share;
+}
+
+bool Enable(const Topology& topology)
+{
+  num_nodes = int(topology.node_cpus.size());
+  enabled = PinThreads(topology);
+  if (!enabled) {
+    num_nodes = 0;
+  }
+  return enabled;
+}
+
+bool PinThreads(const Topology& topology)
+{
+#if defined(__linux__) && defined(_OPENMP)
+  std::vector<int> nodes;
+  for (std::size_t node = 0; node < topology.node_cpus.size(); ++node) {
+    if (!topology.node_cpus[node].empty()) {
+      nodes.push_back(int(node));
+    }
+  }
+  if (nodes.empty()) {
+    return false;
+  }
+  bool pinned = true;
+#pragma omp parallel reduction(&& : pinned)
+  {
+    // Contiguous groups of threads per node, round robin over the CPUs of
+    // the node within a group.
+    const int thread = omp_get_thread_num();
+    const int num_threads = omp_get_num_threads();
+    const int group = int(thread * nodes.size() / num_threads);
+    const int first_thread =
+        int((group * num_threads + nodes.size() - 1) / nodes.size());
+    const std::vector<int>& cpus = topology.node_cpus[nodes[group]];
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpus[(thread - first_thread) % cpus.size()], &cpu_set);
+    pinned = (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0);
+    if (pinned) {
+      thread_node = nodes[group];
+      instrument::ThreadCounters().node = nodes[group];
+    }
+  }
+  return pinned;
+#else
+  (void)topology;
+  return false;
+#endif
+}
+
+int NumNodes() { return num_nodes; }
+
+int ThreadNode() { return thread_node; }
+
+void ZeroFirstTouch(basis::OperatorBlock<double>& matrix,
+                    const std::size_t& rows, const std::size_t& cols)
+{
+  matrix.resize(rows, cols);
+  double* const data = matrix.data();
+  const std::size_t size = rows * cols;
+#pragma omp parallel for schedule(static)
+  for (std::size_t index = 0; index < size; ++index) {
+    data[index] = 0;
+  }
+}
+
+}  // namespace numa
+}  // namespace chime
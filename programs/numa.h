@@ -0,0 +1,140 @@
+/*******************************************************************************
+ numa.h
+
+ Defines the NUMA-aware mode of the operator builders: OpenMP threads pinned
+ to the CPUs of the NUMA nodes, node-local replicas of read-only tables, and
+ blocks first touched by the threads that fill them.
+
+ The topology is read from /sys/devices/system/node, restricted to the CPUs
+ the process may run on, e.g., as bound by mpirun. Threads are assigned to
+ the nodes in contiguous groups, so that the static schedule of a loop gives
+ each node a contiguous share of its iterations. Pinning holds for the
+ lifetime of the OpenMP threads, i.e., as long as the number of threads is
+ not changed.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "basis/operator.h"
+
+namespace chime {
+namespace numa {
+
+// CPUs of each NUMA node. A system without NUMA information has a single
+// node with all CPUs of the process.
+struct Topology {
+  std::vector<std::vector<int>> node_cpus;
+};
+
+// Topology restricted to the CPUs the process may run on. Nodes without such
+// CPUs are dropped.
+Topology ReadTopology();
+
+// Share `part` of `num_parts` of the CPUs of `topology`, e.g., for one of
+// several concurrent jobs. Parts are assigned to the nodes round robin, and
+// the CPUs of a node are divided among its parts; the other nodes of a
+// share have no CPUs.
+Topology Share(const Topology& topology, const int& part,
+               const int& num_parts);
+
+// Whether the NUMA-aware mode is enabled.
+extern bool enabled;
+
+inline bool Enabled() { return enabled; }
+
+// Enables the NUMA-aware mode for the nodes of `topology`, and pins the
+// OpenMP threads of the calling thread with PinThreads. Returns false if the
+// threads cannot be pinned, in which case the mode stays disabled.
+bool Enable(const Topology& topology);
+
+// Pins the OpenMP threads of the calling thread to the CPUs of `topology`,
+// in contiguous groups per node with CPUs. Returns false if they cannot be
+// pinned.
+bool PinThreads(const Topology& topology);
+
+// Number of nodes with pinned threads, 0 unless enabled.
+int NumNodes();
+
+// Node of the calling thread, or -1 if it is not pinned.
+int ThreadNode();
+
+// Node-local copies of read-only data. Each copy is made by a thread of its
+// node, and therefore placed on that node by first touch.
+template <typename T>
+class Replicas {
+ public:
+  // Makes a copy with `make` on each node if the NUMA-aware mode is enabled,
+  // and none otherwise.
+  template <typename Factory>
+  explicit Replicas(const Factory& make);
+
+  // Copy of the node of the calling thread, or `original` if there is none.
+  const T& Local(const T& original) const
+  {
+    const int node = ThreadNode();
+    return ((node >= 0) && (node < int(replicas_.size())) && replicas_[node])
+               ? *replicas_[node]
+               : original;
+  }
+
+ private:
+  std::vector<std::unique_ptr<T>> replicas_;
+};
+
+template <typename T>
+template <typename Factory>
+Replicas<T>::Replicas(const Factory& make)
+{
+  if (!enabled) {
+    return;
+  }
+  replicas_.resize(NumNodes());
+  std::unique_ptr<std::atomic<bool>[]> claimed(
+      new std::atomic<bool>[NumNodes()]);
+  for (int node = 0; node < NumNodes(); ++node) {
+    claimed[node] = false;
+  }
+#pragma omp parallel
+  {
+    const int node = ThreadNode();
+    if ((node >= 0) && !claimed[node].exchange(true)) {
+      replicas_[node].reset(new T(make()));
+    }
+  }
+}
+
+// Allocates `matrix` as a zero `rows` x `cols` matrix, each element first
+// touched by the thread that fills it in a static schedule over the
+// column-major elements, as in the sector loops of the builders.
+void ZeroFirstTouch(basis::OperatorBlock<double>& matrix,
+                    const std::size_t& rows, const std::size_t& cols);
+
+// Zero blocks of all sectors of `sectors`, as basis::SetOperatorToZero, with
+// each block allocated by ZeroFirstTouch. The builders only use it in the
+// NUMA-aware mode.
+template <typename SectorsType>
+void SetOperatorToZero(const SectorsType& sectors,
+                       basis::OperatorBlocks<double>& matrices)
+{
+  matrices.assign(sectors.size(), basis::OperatorBlock<double>());
+  for (std::size_t sector_index = 0; sector_index < sectors.size();
+       ++sector_index) {
+    const auto& sector = sectors.GetSector(sector_index);
+    ZeroFirstTouch(matrices[sector_index], sector.bra_subspace().size(),
+                   sector.ket_subspace().size());
+  }
+}
+
+}  // namespace numa
+}  // namespace chime
+
+#endif
@@ -0,0 +1,161 @@
+#include "options.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace chime {
+
+RunOptions::RunOptions()
+{
+  radial.cache.enabled = true;
+  radial.cache.directory = cache::DefaultCacheDirectory();
+}
+
+// Prints usage and exits.
+void UsageError(const std::string& program, const std::string& message)
+{
+  std::cerr << program << ": " << message << "\n"
+            << "Usage: " << program << " [options]\n"
+            << "  --npts=N               number of radial mesh points\n"
+            << "  --tolerance=EPS        adaptive radial mesh refinement\n"
+            << "  --max-npts=N           largest adaptive radial mesh\n"
+            << "  --screening=THRESHOLD  skip negligible radial integrals\n"
+            << "  --low-rank=TOL         low-rank radial integral blocks\n"
+            << "  --low-rank-output=FILE write low-rank factors to FILE\n"
+            << "  --no-analytic          R = 0 integrals by quadrature\n"
+            << "  --cache-dir=DIR        radial integral cache directory\n"
+            << "  --cache-max-mb=N       cache size limit in MiB\n"
+            << "  --no-cache             disable the radial integral cache\n"
+            << "  --report               write a JSON run report\n"
+            << "  --perf                 add hardware counters to the report\n"
+            << "  --numa                 pin threads to NUMA nodes\n"
+            << "  --sector-file          write a binary sector file\n"
+            << "  --compress             compress the sector file\n"
+            << "  --lab-frame            also write the two-body operator\n"
+            << "  --plan                 print resource estimates and exit\n"
+            << "  --calibration=REPORT   calibrate --plan by a run report\n"
+            << "  --trace                write a Chrome trace\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// Parses the value of option `name` as a positive integer.
+long ParsePositive(const std::string& program, const std::string& name,
+                   const std::string& value)
+{
+  char* end = nullptr;
+  const long result = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || (*end != '\0') || (result <= 0)) {
+    UsageError(program, "invalid value for " + name + ": " + value);
+  }
+  return result;
+}
+
+// Parses the value of option `name` as a positive floating point number.
+double ParsePositiveDouble(const std::string& program, const std::string& name,
+                           const std::string& value)
+{
+  char* end = nullptr;
+  const double result = std::strtod(value.c_str(), &end);
+  if (value.empty() || (*end != '\0') || !(result > 0)) {
+    UsageError(program, "invalid value for " + name + ": " + value);
+  }
+  return result;
+}
+
+RunOptions ParseRunOptions(const int& argc, char** argv)
+{
+  RunOptions options;
+  const std::string program = (argc > 0) ? argv[0] : "chime";
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const std::size_t equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        (equals == std::string::npos) ? "" : arg.substr(equals + 1);
+
+    if (name == "--npts") {
+      options.radial.npts = ParsePositive(program, name, value);
+    }
+    else if (name == "--tolerance") {
+      options.radial.tolerance = ParsePositiveDouble(program, name, value);
+    }
+    else if (name == "--max-npts") {
+      options.radial.max_npts = ParsePositive(program, name, value);
+    }
+    else if (name == "--screening") {
+      options.radial.screening_threshold =
+          ParsePositiveDouble(program, name, value);
+    }
+    else if (name == "--low-rank") {
+      options.radial.low_rank_tolerance =
+          ParsePositiveDouble(program, name, value);
+    }
+    else if (name == "--low-rank-output") {
+      if (value.empty()) {
+        UsageError(program, "missing file name for --low-rank-output");
+      }
+      options.radial.low_rank_filename = value;
+    }
+    else if (name == "--no-analytic") {
+      options.radial.analytic = false;
+    }
+    else if (name == "--cache-dir") {
+      if (value.empty()) {
+        UsageError(program, "missing directory for --cache-dir");
+      }
+      options.radial.cache.directory = value;
+    }
+    else if (name == "--cache-max-mb") {
+      options.radial.cache.max_bytes =
+          std::size_t(ParsePositive(program, name, value)) << 20;
+    }
+    else if (name == "--no-cache") {
+      options.radial.cache.enabled = false;
+    }
+    else if (name == "--report") {
+      options.report = true;
+    }
+    else if (name == "--perf") {
+      options.report = true;
+      options.perf = true;
+    }
+    else if (name == "--numa") {
+      options.numa = true;
+    }
+    else if (name == "--sector-file") {
+      options.sector_file = true;
+    }
+    else if (name == "--compress") {
+      options.sector_file = true;
+      options.compress = true;
+    }
+    else if (name == "--lab-frame") {
+      options.lab_frame = true;
+    }
+    else if (name == "--plan") {
+      options.plan = true;
+    }
+    else if (name == "--calibration") {
+      if (value.empty()) {
+        UsageError(program, "missing file name for --calibration");
+      }
+      options.plan = true;
+      options.calibration_report = value;
+    }
+    else if (name == "--trace") {
+      options.trace = true;
+    }
+    else {
+      UsageError(program, "unknown option " + arg);
+    }
+  }
+  // The adaptive mode compares at least two meshes.
+  const int min_max_npts = 2 * (options.radial.adaptive_min_npts - 1) + 1;
+  if (options.radial.max_npts < min_max_npts) {
+    UsageError(program, "--max-npts must be at least "
+                            + std::to_string(min_max_npts));
+  }
+  return options;
+}
+
+}  // namespace chime
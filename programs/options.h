@@ -0,0 +1,140 @@
+/*******************************************************************************
+ options.h
+
+ Defines the command line options shared by the chime generators. The physics
+ input is still read from the input file; the options only control how the
+ calculation is carried out.
+
+ Options:
+   --npts=N
+     Number of radial mesh points (default 3001).
+
+   --tolerance=EPS
+     Adaptive mode: refine the mesh of each radial integral block until its
+     integrals change by at most EPS under mesh doubling, and report the
+     estimated errors.
+
+   --max-npts=N
+     Largest mesh of the adaptive mode (default 102401, at least 401).
+
+   --screening=THRESHOLD
+     Set radial integrals whose Cauchy-Schwarz bound is below THRESHOLD to
+     zero without calculating them.
+
+   --low-rank=TOL
+     Compress each radial integral block to a truncated SVD with relative
+     Frobenius norm error TOL, and assemble the operator from the factors.
+
+   --low-rank-output=FILE
+     Also write the low-rank factors to FILE, with a sidecar index
+     FILE.index.
+
+   --no-analytic
+     Evaluate unregulated radial integrals by quadrature as well.
+
+   --cache-dir=DIR
+     Directory of the radial integral cache (default $XDG_CACHE_HOME/chime
+     or $HOME/.cache/chime).
+
+   --cache-max-mb=N
+     Size limit of the cache directory in MiB (default 4096).
+
+   --no-cache
+     Neither read nor write the cache.
+
+   --report
+     Write a JSON run report with the wall and CPU time of each phase, work
+     counters and the peak resident set size to <output>.report.json, see
+     instrument.h.
+
+   --perf
+     Also read hardware performance counters around each phase and add
+     them, with the IPC and GFLOP/s, to the run report. Implies --report.
+
+   --numa
+     Pin the OpenMP threads to the CPUs of the NUMA nodes, and give each node
+     its own copy of the wave functions and integral kernels, see numa.h.
+     The run report then includes the counters and throughput of each node.
+
+   --sector-file
+     Write the blocks to the binary sector file <output>.sectors, see
+     partition.h, instead of the operator file. Its index gives random access
+     to each sector by its labels, as does the sidecar index <output>.index
+     of the text operator file. Implied when a generator built with
+     CHIME_MPI runs on several MPI processes, which then build and write
+     their shares of the sectors; the reports and traces of the processes
+     are then written to <output>.rank<N>.report.json, etc.
+
+   --compress
+     Compress the blocks of the sector file, see compress.h, in parallel.
+     The index of the file still gives random access to each block. Implies
+     --sector-file.
+
+   --lab-frame
+     relativecm-gen only: also transform the operator to lab-frame two-body
+     matrix elements in the JJJT scheme, and write them to the binary file
+     <output>.jjjt, see labframe.h. The Moshinsky brackets are kept in the
+     cache.
+
+   --plan
+     Print the sizes of the space and sectors, the state pairs and radial
+     integrals, the memory of the wave functions, radial tables and blocks,
+     and a predicted run time, see plan.h, and exit without calculating the
+     operator. The run time is calibrated by a short benchmark of the radial
+     quadrature.
+
+   --calibration=REPORT
+     Calibrate the predicted run time of --plan by the run report REPORT of
+     an earlier run instead. Implies --plan.
+
+   --trace
+     Write a timeline of the phases, sectors, per-thread loop shares and
+     radial integral batches to <output>.trace.json, in the Chrome trace
+     event format.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <string>
+
+#include "radial.h"
+
+namespace chime {
+
+struct RunOptions {
+  RunOptions();
+
+  radial::RadialParameters radial;
+
+  // Write a run report, with hardware counters, and a trace.
+  bool report = false;
+  bool perf = false;
+  bool trace = false;
+
+  // NUMA-aware mode.
+  bool numa = false;
+
+  // Write a sector file, compressed, instead of the operator file.
+  bool sector_file = false;
+  bool compress = false;
+
+  // Also write the lab-frame two-body operator.
+  bool lab_frame = false;
+
+  // Print the resource plan and exit, calibrated by a run report if given.
+  bool plan = false;
+  std::string calibration_report;
+};
+
+// Parses the command line options. Prints usage and exits on malformed or
+// unknown options.
+RunOptions ParseRunOptions(const int& argc, char** argv);
+
+}  // namespace chime
+
+#endif
@@ -0,0 +1,484 @@
+#include "partition.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "compress.h"
+
+namespace chime {
+namespace partition {
+
+namespace {
+
+const char kMagic[8] = {'C', 'H', 'I', 'M', 'E', 'S', 'E', 'C'};
+const std::uint64_t kVersion = 3;
+
+// Header and index of a sector file.
+std::vector<char> Header(const std::vector<SectorRecord>& records)
+{
+  std::vector<char> header(HeaderSize(records.size()));
+  const std::uint64_t fields[2] = {kVersion, records.size()};
+  char* position = header.data();
+  std::memcpy(position, kMagic, sizeof(kMagic));
+  position += sizeof(kMagic);
+  std::memcpy(position, fields, sizeof(fields));
+  position += sizeof(fields);
+  if (!records.empty()) {
+    std::memcpy(position, records.data(),
+                records.size() * sizeof(SectorRecord));
+  }
+  return header;
+}
+
+// Whether `block` is the block of `record`.
+bool Owned(const basis::OperatorBlock<double>* block,
+           const SectorRecord& record)
+{
+  return (block != nullptr) && (std::uint64_t(block->rows()) == record.rows)
+         && (std::uint64_t(block->cols()) == record.cols);
+}
+
+// Stored bytes of the block `block` of `record`, compressed unless that does
+// not shrink it. Sets the size and codec of `record`.
+std::vector<char> EncodeBlock(const basis::OperatorBlock<double>& block,
+                              SectorRecord& record)
+{
+  const std::size_t size = block.size() * sizeof(double);
+  std::vector<char> data = compress::Encode(block.data(), block.size());
+  record.codec = std::uint64_t(compress::Codec::kShuffleLZ);
+  if (data.size() >= size) {
+    const char* values = reinterpret_cast<const char*>(block.data());
+    data.assign(values, values + size);
+    record.codec = std::uint64_t(compress::Codec::kNone);
+  }
+  record.size = data.size();
+  return data;
+}
+
+// Size of a sector file.
+std::uint64_t FileSize(const std::vector<SectorRecord>& records)
+{
+  std::uint64_t size = HeaderSize(records.size());
+  for (const SectorRecord& record : records) {
+    size = std::max(size, record.offset + record.size);
+  }
+  return size;
+}
+
+// Whether `record` is a sector on the diagonal, of which a text operator
+// file only has the upper triangle.
+bool Diagonal(const SectorRecord& record)
+{
+  return record.bra_subspace_index == record.ket_subspace_index;
+}
+
+// Lines of the block of `record` in a text operator file.
+std::uint64_t TextElements(const SectorRecord& record)
+{
+  return Diagonal(record) ? record.rows * (record.rows + 1) / 2
+                          : record.rows * record.cols;
+}
+
+// Fills `block` from the lines `text` of its sector `record` in the text
+// operator file `filename`, the lower triangle of a sector on the diagonal
+// by symmetry.
+void ParseTextBlock(const std::string& text, const std::string& filename,
+                    const SectorRecord& record,
+                    basis::OperatorBlock<double>& block)
+{
+  std::istringstream lines(text);
+  std::string line;
+  for (std::uint64_t row = 0; row < record.rows; ++row) {
+    for (std::uint64_t col = Diagonal(record) ? row : 0; col < record.cols;
+         ++col) {
+      if (!std::getline(lines, line)) {
+        throw std::runtime_error("truncated block in operator file "
+                                 + filename);
+      }
+      const std::size_t last = line.find_last_of(" \t");
+      block(row, col) = std::strtod(
+          line.c_str() + ((last == std::string::npos) ? 0 : last + 1),
+          nullptr);
+      if (Diagonal(record)) {
+        block(col, row) = block(row, col);
+      }
+    }
+  }
+}
+
+// Reads the block of `record` from `file`, the sector file or text operator
+// file `filename`.
+basis::OperatorBlock<double> ReadBlock(std::istream& file,
+                                       const std::string& filename,
+                                       const SectorRecord& record)
+{
+  basis::OperatorBlock<double> block(record.rows, record.cols);
+  const compress::Codec codec = compress::Codec(record.codec);
+  const bool stored =
+      (codec == compress::Codec::kShuffleLZ)
+      || (codec == compress::Codec::kText)
+      || ((codec == compress::Codec::kNone)
+          && (record.size == block.size() * sizeof(double)));
+  if (!stored) {
+    throw std::runtime_error("block not stored in sector file " + filename);
+  }
+  file.seekg(record.offset);
+  if (codec == compress::Codec::kShuffleLZ) {
+    std::vector<char> data(record.size);
+    file.read(data.data(), data.size());
+    if (file) {
+      compress::Decode(data.data(), data.size(), block.data(), block.size());
+    }
+  }
+  else if (codec == compress::Codec::kText) {
+    std::string text(record.size, '\0');
+    file.read(&text[0], text.size());
+    if (file) {
+      ParseTextBlock(text, filename, record, block);
+    }
+  }
+  else {
+    file.read(reinterpret_cast<char*>(block.data()),
+              block.size() * sizeof(double));
+  }
+  if (!file) {
+    throw std::runtime_error("cannot read block from sector file "
+                             + filename);
+  }
+  return block;
+}
+
+// Index of the sector file `filename`, or sidecar index of the text
+// operator file `filename`.
+std::vector<SectorRecord> ReadIndex(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  file.read(magic, sizeof(magic));
+  if (file && (std::memcmp(magic, kMagic, sizeof(kMagic)) == 0)) {
+    return ReadSectorFileIndex(filename);
+  }
+  return ReadSectorFileIndex(filename + ".index");
+}
+
+#ifdef CHIME_MPI
+// Largest number of bytes written by one call of MPI_File_write_at, whose
+// count is an int.
+constexpr std::uint64_t kMaxWriteBytes = std::uint64_t(1) << 30;
+
+// Writes `size` bytes at `offset` of `file`, in chunks of at most
+// kMaxWriteBytes.
+int WriteAt(MPI_File file, const std::uint64_t& offset, const char* data,
+            const std::uint64_t& size)
+{
+  int status = MPI_SUCCESS;
+  for (std::uint64_t done = 0; (status == MPI_SUCCESS) && (done < size);
+       done += kMaxWriteBytes) {
+    const std::uint64_t chunk = std::min(size - done, kMaxWriteBytes);
+    status = MPI_File_write_at(file, MPI_Offset(offset + done), data + done,
+                               int(chunk), MPI_CHAR, MPI_STATUS_IGNORE);
+  }
+  return status;
+}
+#endif
+
+}  // namespace
+
+std::vector<int> PartitionLPT(const std::vector<double>& costs,
+                              const int& num_parts)
+{
+  std::vector<std::size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const std::size_t& a, const std::size_t& b) {
+                     return costs[a] > costs[b];
+                   });
+
+  // Parts by increasing load, ties broken by part index so that the result
+  // is the same on all processes.
+  using Load = std::pair<double, int>;
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+  for (int part = 0; part < num_parts; ++part) {
+    loads.push({0., part});
+  }
+  std::vector<int> parts(costs.size());
+  for (const std::size_t item : order) {
+    Load load = loads.top();
+    loads.pop();
+    parts[item] = load.second;
+    load.first += costs[item];
+    loads.push(load);
+  }
+  return parts;
+}
+
+std::vector<std::size_t> Share(const std::vector<int>& parts, const int& part)
+{
+  std::vector<std::size_t> items;
+  for (std::size_t item = 0; item < parts.size(); ++item) {
+    if (parts[item] == part) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::uint64_t HeaderSize(const std::size_t& num_records)
+{
+  return sizeof(kMagic) + 2 * sizeof(std::uint64_t)
+         + num_records * sizeof(SectorRecord);
+}
+
+void PlaceBlocks(std::vector<SectorRecord>& records)
+{
+  std::uint64_t offset = HeaderSize(records.size());
+  for (SectorRecord& record : records) {
+    record.offset = offset;
+    offset += record.size;
+  }
+}
+
+void WriteSectorFile(
+    const std::string& filename, const std::vector<SectorRecord>& records,
+    const std::vector<const basis::OperatorBlock<double>*>& blocks,
+    const bool& compress)
+{
+  if (compress) {
+    // Blocks are compressed in parallel and written in order as they
+    // complete, then the index is written with their offsets and sizes.
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    std::vector<SectorRecord> stored(records);
+    std::uint64_t offset = HeaderSize(stored.size());
+    file.seekp(offset);
+#pragma omp parallel for schedule(dynamic) ordered
+    for (std::size_t index = 0; index < stored.size(); ++index) {
+      std::vector<char> data;
+      if (Owned(blocks[index], stored[index])) {
+        data = EncodeBlock(*blocks[index], stored[index]);
+      }
+      else {
+        stored[index].size = 0;
+        stored[index].codec = std::uint64_t(compress::Codec::kNone);
+      }
+#pragma omp ordered
+      {
+        stored[index].offset = offset;
+        offset += data.size();
+        file.write(data.data(), data.size());
+      }
+    }
+    const std::vector<char> header = Header(stored);
+    file.seekp(0);
+    file.write(header.data(), header.size());
+    if (!file) {
+      throw std::runtime_error("cannot write sector file " + filename);
+    }
+    return;
+  }
+
+  // Uncompressed, the blocks of other shares already in the file are kept,
+  // and the file is then cut or extended to its size, as by the processes of
+  // the MPI variant.
+  {
+    std::ofstream create(filename, std::ios::binary | std::ios::app);
+  }
+  std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+  const std::vector<char> header = Header(records);
+  file.write(header.data(), header.size());
+  for (std::size_t index = 0; index < records.size(); ++index) {
+    if (Owned(blocks[index], records[index])) {
+      file.seekp(records[index].offset);
+      file.write(reinterpret_cast<const char*>(blocks[index]->data()),
+                 blocks[index]->size() * sizeof(double));
+    }
+  }
+  file.close();
+  if (!file || (truncate(filename.c_str(), off_t(FileSize(records))) != 0)) {
+    throw std::runtime_error("cannot write sector file " + filename);
+  }
+}
+
+#ifdef CHIME_MPI
+void WriteSectorFile(
+    MPI_Comm comm, const std::string& filename,
+    const std::vector<SectorRecord>& records,
+    const std::vector<const basis::OperatorBlock<double>*>& blocks,
+    const bool& compress)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  // Compressed, the processes exchange the sizes and codecs of their blocks
+  // to place them.
+  std::vector<SectorRecord> stored(records);
+  std::vector<std::vector<char>> encoded(records.size());
+  if (compress) {
+    const std::size_t num_records = records.size();
+    std::vector<std::uint64_t> sizes(2 * num_records, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (std::size_t index = 0; index < num_records; ++index) {
+      if (Owned(blocks[index], records[index])) {
+        encoded[index] = EncodeBlock(*blocks[index], stored[index]);
+        sizes[index] = stored[index].size;
+        sizes[num_records + index] = stored[index].codec;
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, sizes.data(), int(sizes.size()),
+                  MPI_UINT64_T, MPI_SUM, comm);
+    for (std::size_t index = 0; index < num_records; ++index) {
+      stored[index].size = sizes[index];
+      stored[index].codec = sizes[num_records + index];
+    }
+    PlaceBlocks(stored);
+  }
+
+  MPI_File file;
+  int status = MPI_File_open(comm, filename.c_str(),
+                             MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                             MPI_INFO_NULL, &file);
+  if (status != MPI_SUCCESS) {
+    throw std::runtime_error("cannot open sector file " + filename);
+  }
+  status = MPI_File_set_size(file, MPI_Offset(FileSize(stored)));
+  if ((status == MPI_SUCCESS) && (rank == 0)) {
+    const std::vector<char> header = Header(stored);
+    status = WriteAt(file, 0, header.data(), header.size());
+  }
+  for (std::size_t index = 0;
+       (status == MPI_SUCCESS) && (index < records.size()); ++index) {
+    if (Owned(blocks[index], records[index])) {
+      const char* data =
+          compress ? encoded[index].data()
+                   : reinterpret_cast<const char*>(blocks[index]->data());
+      status = WriteAt(file, stored[index].offset, data, stored[index].size);
+    }
+  }
+  MPI_File_close(&file);
+
+  // Fail on all processes if any failed.
+  int failed = (status != MPI_SUCCESS);
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, comm);
+  if (failed) {
+    throw std::runtime_error("cannot write sector file " + filename);
+  }
+}
+#endif
+
+void IndexTextSectors(const std::string& filename,
+                      std::vector<SectorRecord> records)
+{
+  // Offsets of the starts of the lines, and of the end of the file.
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("cannot read operator file " + filename);
+  }
+  std::vector<std::uint64_t> line_offsets(1, 0);
+  std::string line;
+  while (std::getline(file, line)) {
+    line_offsets.push_back(line_offsets.back() + line.size()
+                           + (file.eof() ? 0 : 1));
+  }
+
+  // The data lines follow the header lines of the basis library.
+  std::uint64_t num_elements = 0;
+  for (const SectorRecord& record : records) {
+    num_elements += TextElements(record);
+  }
+  const std::uint64_t num_lines = line_offsets.size() - 1;
+  if (num_elements > num_lines) {
+    throw std::runtime_error("operator file " + filename
+                             + " has fewer lines than elements");
+  }
+  std::uint64_t line_index = num_lines - num_elements;
+  for (SectorRecord& record : records) {
+    const std::uint64_t elements = TextElements(record);
+    record.offset = line_offsets[line_index];
+    record.size = line_offsets[line_index + elements] - record.offset;
+    record.codec = std::uint64_t(compress::Codec::kText);
+    line_index += elements;
+
+    // Each data line starts with the T0 of its sector.
+    if (elements > 0) {
+      std::uint64_t T0 = 0;
+      file.clear();
+      file.seekg(record.offset);
+      if (!(file >> T0) || (T0 != record.T0)) {
+        throw std::runtime_error("operator file " + filename
+                                 + " does not match its sectors");
+      }
+    }
+  }
+
+  const std::vector<char> header = Header(records);
+  std::ofstream index(filename + ".index", std::ios::binary | std::ios::trunc);
+  index.write(header.data(), header.size());
+  if (!index) {
+    throw std::runtime_error("cannot write index " + filename + ".index");
+  }
+}
+
+std::vector<SectorRecord> ReadSectorFileIndex(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  std::uint64_t fields[2];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+  if (!file || (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+      || (fields[0] != kVersion)) {
+    throw std::runtime_error("not a sector file: " + filename);
+  }
+  std::vector<SectorRecord> records(fields[1]);
+  file.read(reinterpret_cast<char*>(records.data()),
+            records.size() * sizeof(SectorRecord));
+  if (!file) {
+    throw std::runtime_error("truncated sector file " + filename);
+  }
+  return records;
+}
+
+basis::OperatorBlock<double> ReadSectorBlock(const std::string& filename,
+                                             const SectorRecord& record)
+{
+  std::ifstream file(filename, std::ios::binary);
+  return ReadBlock(file, filename, record);
+}
+
+SectorFileReader::SectorFileReader(const std::string& filename)
+    : filename_(filename),
+      file_(filename, std::ios::binary),
+      records_(ReadIndex(filename))
+{
+  for (std::size_t index = 0; index < records_.size(); ++index) {
+    const SectorRecord& record = records_[index];
+    lookup_[Key(record.T0, record.bra_labels, record.ket_labels)] = index;
+  }
+}
+
+const SectorRecord* SectorFileReader::Find(const int& T0,
+                                           const SubspaceLabels& bra,
+                                           const SubspaceLabels& ket) const
+{
+  const auto position = lookup_.find(Key(T0, bra, ket));
+  return (position == lookup_.end()) ? nullptr
+                                     : &records_[position->second];
+}
+
+basis::OperatorBlock<double> SectorFileReader::ReadBlock(
+    const SectorRecord& record)
+{
+  file_.clear();
+  return partition::ReadBlock(file_, filename_, record);
+}
+
+}  // namespace partition
+}  // namespace chime
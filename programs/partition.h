@@ -0,0 +1,237 @@
+/*******************************************************************************
+ partition.h
+
+ Defines the partitioning of the sectors of an operator among processes,
+ and the sector file to which the processes write their blocks together.
+
+ Sectors are assigned by estimated cost with the longest processing time
+ rule: in order of decreasing cost, each sector goes to the process with the
+ least work so far. The assignment only depends on the costs, so that every
+ process computes the same one without communication.
+
+ Sector file (native byte order):
+   char[8]        "CHIMESEC"
+   uint64         format version, 3
+   uint64         number of sectors
+   SectorRecord   one per sector, in order of T0 and sector index
+   char           blocks, column-major, at the offsets and of the sizes of
+                  their records, stored by the codec of their records
+
+ The records carry the labels of the sectors, so that a SectorFileReader
+ finds a sector by its labels, from the index read once, and loads its
+ block with a single read.
+
+ Uncompressed, the offsets only depend on the sector sizes, so that each
+ process writes its blocks directly to their place in the file. Compressed,
+ the blocks are compressed in parallel, see compress.h, and the processes
+ exchange the compressed sizes before they write; blocks that do not shrink
+ are stored uncompressed. Either way, the index gives random access to each
+ block. In MPI builds (CHIME_MPI) the file is written with MPI-IO, so that it
+ may be on a shared file system.
+
+ The text operator files of the basis library get a sidecar index,
+ <output>.index, with the header and index of a sector file. Its records
+ locate the lines of each sector in the text file, with codec kText, one
+ element per line with the value last, the upper triangle only for the
+ sectors on the diagonal. A SectorFileReader of the text file reads the
+ sidecar index, and loads a sector by a seek to its lines.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef PARTITION_H_
+#define PARTITION_H_
+
+#ifdef CHIME_MPI
+#include <mpi.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "basis/operator.h"
+
+namespace chime {
+namespace partition {
+
+// Assigns items of cost `costs` to `num_parts` parts with the longest
+// processing time rule. Returns the part of each item.
+std::vector<int> PartitionLPT(const std::vector<double>& costs,
+                              const int& num_parts);
+
+// Indices of the items assigned to `part`, in increasing order.
+std::vector<std::size_t> Share(const std::vector<int>& parts,
+                               const int& part);
+
+// Labels L, S, J, T, g of a relative or relative-cm LSJT subspace.
+using SubspaceLabels = std::array<std::int64_t, 5>;
+
+template <typename SubspaceType>
+SubspaceLabels Labels(const SubspaceType& subspace)
+{
+  return {subspace.L(), subspace.S(), subspace.J(), subspace.T(),
+          subspace.g()};
+}
+
+// Index entry of a block in a sector file.
+struct SectorRecord {
+  std::uint64_t T0;
+  std::uint64_t sector_index;
+  std::uint64_t bra_subspace_index;
+  std::uint64_t ket_subspace_index;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t offset;  // in bytes from the start of the file
+  std::uint64_t size;    // stored bytes
+  std::uint64_t codec;   // compress::Codec of the stored block
+  SubspaceLabels bra_labels;
+  SubspaceLabels ket_labels;
+};
+
+// Size of the header and index of a sector file with `num_records` sectors.
+std::uint64_t HeaderSize(const std::size_t& num_records);
+
+// Sets the offsets of `records` to consecutive blocks of their sizes after
+// the header.
+void PlaceBlocks(std::vector<SectorRecord>& records);
+
+// Records of all uncompressed sectors of `op`, an Operator of libchime.h, with
+// consecutive blocks after the header.
+template <typename OperatorType>
+std::vector<SectorRecord> SectorLayout(const OperatorType& op)
+{
+  std::vector<SectorRecord> records;
+  for (int T0 = op.params.T0_min; T0 <= op.params.T0_max; ++T0) {
+    for (std::size_t sector_index = 0; sector_index < op.sectors[T0].size();
+         ++sector_index) {
+      const auto& sector = op.sectors[T0].GetSector(sector_index);
+      records.push_back({std::uint64_t(T0), sector_index,
+                         sector.bra_subspace_index(),
+                         sector.ket_subspace_index(),
+                         sector.bra_subspace().size(),
+                         sector.ket_subspace().size(), 0, 0, 0,
+                         Labels(sector.bra_subspace()),
+                         Labels(sector.ket_subspace())});
+      records.back().size =
+          records.back().rows * records.back().cols * sizeof(double);
+    }
+  }
+  PlaceBlocks(records);
+  return records;
+}
+
+// Blocks of `op` in the order of `records`.
+template <typename OperatorType>
+std::vector<const basis::OperatorBlock<double>*> SectorBlocks(
+    const OperatorType& op, const std::vector<SectorRecord>& records)
+{
+  std::vector<const basis::OperatorBlock<double>*> blocks;
+  for (const SectorRecord& record : records) {
+    blocks.push_back(&op.matrices[record.T0][record.sector_index]);
+  }
+  return blocks;
+}
+
+// Writes a sector file with the blocks `blocks` of the sectors `records`,
+// compressed if `compress`, in which case the offsets and sizes of `records`
+// are replaced. Blocks that are not of the size of their sector, e.g., the
+// empty blocks of other processes, are not written; compressed, they are
+// stored with size 0. Uncompressed, the blocks already in the file are kept,
+// so that the shares of several processes may be written to one file in
+// turn.
+//
+// Throws:
+//   std::runtime_error if the file cannot be written
+void WriteSectorFile(
+    const std::string& filename, const std::vector<SectorRecord>& records,
+    const std::vector<const basis::OperatorBlock<double>*>& blocks,
+    const bool& compress = false);
+
+#ifdef CHIME_MPI
+// Writes a sector file together with the other processes of `comm`, each
+// with its own blocks, as WriteSectorFile. Collective over `comm`.
+void WriteSectorFile(
+    MPI_Comm comm, const std::string& filename,
+    const std::vector<SectorRecord>& records,
+    const std::vector<const basis::OperatorBlock<double>*>& blocks,
+    const bool& compress = false);
+#endif
+
+// Writes the sidecar index `filename`.index of the text operator file
+// `filename`, with the sectors `records` of its operator. The data lines are
+// the last lines of the file, one per element, in the order of `records`.
+//
+// Throws:
+//   std::runtime_error if the files cannot be read or written, or the text
+//   file does not have the lines of `records`
+void IndexTextSectors(const std::string& filename,
+                      std::vector<SectorRecord> records);
+
+// Writes the sidecar index of the text operator file `filename`, written by
+// basis::WriteRelativeOperatorLSJT or WriteRelativeCMOperatorLSJT for `op`,
+// an Operator of libchime.h, as IndexTextSectors.
+template <typename OperatorType>
+void IndexTextOperator(const std::string& filename, const OperatorType& op)
+{
+  IndexTextSectors(filename, SectorLayout(op));
+}
+
+// Reads the index of a sector file.
+//
+// Throws:
+//   std::runtime_error if the file cannot be read or is not a sector file
+std::vector<SectorRecord> ReadSectorFileIndex(const std::string& filename);
+
+// Reads the block of `record` from a sector file, with a single read of its
+// stored bytes.
+//
+// Throws:
+//   std::runtime_error if the file cannot be read, or the block is not
+//   stored or corrupt
+basis::OperatorBlock<double> ReadSectorBlock(const std::string& filename,
+                                             const SectorRecord& record);
+
+// Random access to the sectors of a sector file by their labels.
+class SectorFileReader {
+ public:
+  // Opens `filename` and reads its index, or the sidecar index of a text
+  // operator file.
+  //
+  // Throws:
+  //   std::runtime_error as ReadSectorFileIndex
+  explicit SectorFileReader(const std::string& filename);
+
+  const std::vector<SectorRecord>& records() const { return records_; }
+
+  // Record of the sector T0 between the subspaces of labels `bra` and `ket`,
+  // as stored, i.e., with bra subspace index <= ket subspace index, or
+  // nullptr if the file has no such sector.
+  const SectorRecord* Find(const int& T0, const SubspaceLabels& bra,
+                           const SubspaceLabels& ket) const;
+
+  // Reads the block of `record` with a single read.
+  //
+  // Throws:
+  //   std::runtime_error as ReadSectorBlock
+  basis::OperatorBlock<double> ReadBlock(const SectorRecord& record);
+
+ private:
+  using Key = std::tuple<std::int64_t, SubspaceLabels, SubspaceLabels>;
+
+  std::string filename_;
+  std::ifstream file_;
+  std::vector<SectorRecord> records_;
+  std::map<Key, std::size_t> lookup_;
+};
+
+}  // namespace partition
+}  // namespace chime
+
+#endif
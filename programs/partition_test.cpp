@@ -0,0 +1,187 @@
+/*******************************************************************************
+ partition_test.cpp
+
+ Checks the largest load of the longest processing time partitioning,
+ writes the shares of a sector file to one file, as several processes would,
+ and reads all its sectors back, does the same for a compressed sector file,
+ and finds its sectors by their labels, as those of a text operator file by
+ its sidecar index.
+
+ The MPI mode itself is tested by comparing the sector file of a run on one
+ process with that of a run on several local processes, e.g.,
+
+   relative-gen --sector-file && mv <output>.sectors one.sectors
+   mpirun -np 4 relative-gen && cmp one.sectors <output>.sectors
+
+ With --no-analytic, a fixed radial mesh and without --low-rank the files
+ are identical; otherwise the radial integrals tabulated by each process
+ for its own subspaces may differ in rounding.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "partition.h"
+
+int main()
+{
+  bool passed = true;
+
+  // Partition costs of the form of block sizes.
+  std::vector<double> costs;
+  for (int rows = 1; rows <= 40; ++rows) {
+    costs.push_back(rows * ((rows * 7) % 13 + 1));
+  }
+  const int num_parts = 6;
+  const std::vector<int> parts =
+      chime::partition::PartitionLPT(costs, num_parts);
+  std::vector<double> loads(num_parts, 0.);
+  for (std::size_t item = 0; item < costs.size(); ++item) {
+    loads[parts[item]] += costs[item];
+  }
+  const double total = std::accumulate(costs.begin(), costs.end(), 0.);
+  const double max_cost = *std::max_element(costs.begin(), costs.end());
+  const double largest = *std::max_element(loads.begin(), loads.end());
+  std::cout << "Largest load " << largest << ", average load "
+            << total / num_parts << "\n";
+  // Any greedy assignment exceeds the average by at most one item.
+  passed &= (largest <= total / num_parts + max_cost);
+
+  // Sector file written in shares.
+  basis::OperatorBlock<double> written[3];
+  std::vector<chime::partition::SectorRecord> records;
+  for (int index = 0; index < 3; ++index) {
+    written[index] = Eigen::MatrixXd::Random(index + 2, 3 - index);
+    records.push_back({1, std::uint64_t(index), 0, 0,
+                       std::uint64_t(index + 2), std::uint64_t(3 - index), 0,
+                       written[index].size() * sizeof(double), 0,
+                       {index, 0, index, 0, 0}, {index, 1, index + 1, 0, 0}});
+  }
+  chime::partition::PlaceBlocks(records);
+  const std::string filename = "partition_test.sectors";
+  std::remove(filename.c_str());
+  for (int share = 0; share < 2; ++share) {
+    std::vector<const basis::OperatorBlock<double>*> blocks;
+    for (int index = 0; index < 3; ++index) {
+      blocks.push_back((index % 2 == share) ? &written[index]
+                                            : nullptr);
+    }
+    chime::partition::WriteSectorFile(filename, records, blocks);
+  }
+  const std::vector<chime::partition::SectorRecord> shared_records =
+      chime::partition::ReadSectorFileIndex(filename);
+  for (int index = 0; index < 3; ++index) {
+    const basis::OperatorBlock<double> block =
+        chime::partition::ReadSectorBlock(filename, shared_records[index]);
+    std::cout << "Sector " << index << " read back "
+              << ((block == written[index]) ? "identical" : "DIFFERENT")
+              << "\n";
+    passed &= (block == written[index]);
+  }
+
+  // Compressed sector file, with a vanishing block, a smooth block and the
+  // random blocks, which do not compress.
+  std::vector<const basis::OperatorBlock<double>*> blocks;
+  for (int index = 0; index < 3; ++index) {
+    blocks.push_back(&written[index]);
+  }
+  basis::OperatorBlock<double> zero = Eigen::MatrixXd::Zero(40, 30);
+  basis::OperatorBlock<double> smooth(40, 30);
+  for (int row = 0; row < 40; ++row) {
+    for (int col = 0; col < 30; ++col) {
+      smooth(row, col) = 1. / (1. + row + col);
+    }
+  }
+  for (const basis::OperatorBlock<double>* block : {&zero, &smooth}) {
+    blocks.push_back(block);
+    records.push_back({0, std::uint64_t(records.size()), 0, 0,
+                       std::uint64_t(block->rows()),
+                       std::uint64_t(block->cols()), 0,
+                       block->size() * sizeof(double), 0,
+                       {0, 0, 0, 1, 0},
+                       {std::int64_t(records.size()), 0, 0, 1, 0}});
+  }
+  chime::partition::PlaceBlocks(records);
+  chime::partition::WriteSectorFile(filename, records, blocks, true);
+  const std::vector<chime::partition::SectorRecord> compressed_records =
+      chime::partition::ReadSectorFileIndex(filename);
+  for (std::size_t index = 0; index < blocks.size(); ++index) {
+    const basis::OperatorBlock<double> block =
+        chime::partition::ReadSectorBlock(filename, compressed_records[index]);
+    std::cout << "Compressed sector " << index << " of "
+              << records[index].size << " bytes stored in "
+              << compressed_records[index].size << ", read back "
+              << ((block == *blocks[index]) ? "identical" : "DIFFERENT")
+              << "\n";
+    passed &= (block == *blocks[index]);
+    passed &= (compressed_records[index].size <= records[index].size);
+  }
+  passed &= (compressed_records[3].size < records[3].size / 50);
+
+  // Sectors by labels.
+  chime::partition::SectorFileReader reader(filename);
+  bool found = (reader.Find(1, {9, 9, 9, 9, 9}, {0, 0, 0, 0, 0}) == nullptr);
+  for (std::size_t index = 0; index < blocks.size(); ++index) {
+    const chime::partition::SectorRecord* record =
+        reader.Find(records[index].T0, records[index].bra_labels,
+                    records[index].ket_labels);
+    found &= (record != nullptr)
+             && (reader.ReadBlock(*record) == *blocks[index]);
+  }
+  std::cout << "Sectors found by labels "
+            << (found ? "identical" : "DIFFERENT") << "\n";
+  passed &= found;
+  std::remove(filename.c_str());
+
+  // Text operator file with a sidecar index, with a sector on the diagonal,
+  // of which only the upper triangle is written, and one off the diagonal.
+  basis::OperatorBlock<double> symmetric = Eigen::MatrixXd::Random(3, 3);
+  symmetric += symmetric.transpose().eval();
+  const basis::OperatorBlock<double> text_blocks[2] = {
+      symmetric, Eigen::MatrixXd::Random(3, 2)};
+  const std::vector<chime::partition::SectorRecord> text_records = {
+      {0, 0, 0, 0, 3, 3, 0, 0, 0, {0, 0, 1, 1, 0}, {0, 0, 1, 1, 0}},
+      {1, 0, 0, 1, 3, 2, 0, 0, 0, {0, 0, 1, 1, 0}, {2, 0, 2, 1, 0}}};
+  {
+    std::ofstream text(filename);
+    text << "# RELATIVE LSJT\n# version\n1\n";
+    text << std::scientific << std::setprecision(17);
+    for (int index = 0; index < 2; ++index) {
+      const chime::partition::SectorRecord& record = text_records[index];
+      for (std::uint64_t row = 0; row < record.rows; ++row) {
+        for (std::uint64_t col = (index == 0) ? row : 0; col < record.cols;
+             ++col) {
+          text << " " << record.T0 << "   " << row << " 0 0 1 1   " << col
+               << " 0 0 1 1   " << text_blocks[index](row, col) << "\n";
+        }
+      }
+    }
+  }
+  chime::partition::IndexTextSectors(filename, text_records);
+  chime::partition::SectorFileReader text_reader(filename);
+  bool text_found = true;
+  for (int index = 0; index < 2; ++index) {
+    const chime::partition::SectorRecord* record =
+        text_reader.Find(text_records[index].T0,
+                         text_records[index].bra_labels,
+                         text_records[index].ket_labels);
+    text_found &= (record != nullptr)
+                  && (text_reader.ReadBlock(*record) == text_blocks[index]);
+  }
+  std::cout << "Text sectors found by labels "
+            << (text_found ? "identical" : "DIFFERENT") << "\n";
+  passed &= text_found;
+  std::remove(filename.c_str());
+  std::remove((filename + ".index").c_str());
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,190 @@
+#include "plan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "basis/lsjt_scheme.h"
+#include "tprme.h"
+
+namespace chime {
+namespace plan {
+
+namespace {
+
+// Value of the first field `name` at or after `from` in the text of a run
+// report.
+double ReportField(const std::string& text, const std::string& name,
+                   const std::size_t& from)
+{
+  const std::string key = "\"" + name + "\": ";
+  const std::size_t position = text.find(key, from);
+  if (position == std::string::npos) {
+    throw std::runtime_error("run report without " + name);
+  }
+  return std::strtod(text.c_str() + position + key.size(), nullptr);
+}
+
+// Position of the object `name` in the text of a run report.
+std::size_t ReportObject(const std::string& text, const std::string& name)
+{
+  const std::size_t position = text.find("\"" + name + "\": {");
+  if (position == std::string::npos) {
+    throw std::runtime_error("run report without " + name);
+  }
+  return position;
+}
+
+// Bytes in MiB.
+double MiB(const double& bytes) { return bytes / (1 << 20); }
+
+}  // namespace
+
+Calibration BenchmarkQuadrature(const radial::RadialParameters& params)
+{
+  // Two kernels and a few wave functions of the size of the mesh.
+  constexpr int K = 2;
+  const int npts = params.npts;
+  const int num_wfs = 8;
+  const Eigen::ArrayXd x = Eigen::ArrayXd::LinSpaced(npts, 0., 1.);
+  const radial::FusedIntegrator<K> integrator(
+      x, Eigen::ArrayXd::Ones(npts),
+      {{Eigen::ArrayXd::Random(npts) + 2., Eigen::ArrayXd::Random(npts) + 2.}});
+  const Eigen::ArrayXXd wfs = Eigen::ArrayXXd::Random(npts, num_wfs);
+
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+  double integrals = 0;
+  double sum = 0;
+  while (seconds < 0.1) {
+    for (int bra = 0; bra < num_wfs; ++bra) {
+      for (int ket = 0; ket < num_wfs; ++ket) {
+        sum += integrator.Integrate(wfs.col(bra), wfs.col(ket))[0];
+      }
+    }
+    integrals += K * num_wfs * num_wfs;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                            - start)
+                  .count();
+  }
+
+  // Spin-angular tensor products of the state pairs of a small relative-cm
+  // space, one per pair as in the sector loops.
+  const basis::RelativeCMSpaceLSJT space(4);
+  const auto pair_start = std::chrono::steady_clock::now();
+  double pair_seconds = 0;
+  double state_pairs = 0;
+  while (pair_seconds < 0.1) {
+    for (std::size_t bra_index = 0; bra_index < space.size(); ++bra_index) {
+      const basis::RelativeCMSubspaceLSJT& bra_subspace =
+          space.GetSubspace(bra_index);
+      for (std::size_t ket_index = bra_index; ket_index < space.size();
+           ++ket_index) {
+        const basis::RelativeCMSubspaceLSJT& ket_subspace =
+            space.GetSubspace(ket_index);
+        for (std::size_t bra = 0; bra < bra_subspace.size(); ++bra) {
+          const basis::RelativeCMStateLSJT bra_state(bra_subspace, bra);
+          for (std::size_t ket = 0; ket < ket_subspace.size(); ++ket) {
+            const basis::RelativeCMStateLSJT ket_state(ket_subspace, ket);
+            sum += tp::CCSpinTensorProductRME<1, 1, 1, 0, 1>(bra_state,
+                                                             ket_state);
+          }
+        }
+        state_pairs += double(bra_subspace.size()) * ket_subspace.size();
+      }
+    }
+    pair_seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - pair_start)
+                       .count();
+  }
+
+  // Keeps the benchmark from being optimized away.
+  volatile double sink = sum;
+  (void)sink;
+
+  Calibration calibration;
+  calibration.seconds_per_integral = seconds / integrals;
+  calibration.seconds_per_state_pair = pair_seconds / state_pairs;
+  calibration.source = "quadrature and tensor product benchmark, "
+                       + std::to_string(npts) + " mesh points";
+  return calibration;
+}
+
+Calibration ReadCalibration(const std::string& filename)
+{
+  std::ifstream file(filename);
+  if (!file) {
+    throw std::runtime_error("cannot read run report " + filename);
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  const std::string text = stream.str();
+
+  const double integral_seconds = ReportField(
+      text, "cpu_seconds", ReportObject(text, "radial_integrals"));
+  const double sector_seconds =
+      ReportField(text, "cpu_seconds", ReportObject(text, "sector_loop"));
+  const std::size_t counters = ReportObject(text, "counters");
+  const double integrals = ReportField(text, "integrals", counters);
+  const double state_pairs = ReportField(text, "state_pairs", counters);
+  if ((integrals <= 0) || (state_pairs <= 0)) {
+    throw std::runtime_error("run report " + filename
+                             + " has no radial integrals or state pairs, "
+                               "e.g., they were loaded from the cache");
+  }
+
+  Calibration calibration;
+  calibration.seconds_per_integral = integral_seconds / integrals;
+  calibration.seconds_per_state_pair = sector_seconds / state_pairs;
+  calibration.source = "run report " + filename;
+  return calibration;
+}
+
+void CountRadialTable(const radial::RadialTableShape& shape,
+                      const radial::RadialParameters& params, Plan& plan)
+{
+  if (shape.nmax_by_l.empty()) {
+    return;
+  }
+  plan.integrals += radial::RadialTableSize(shape);
+  plan.radial_table_bytes += sizeof(double) * radial::RadialTableSize(shape);
+  const int lmax = int(shape.nmax_by_l.size()) - 1;
+  const int nmax =
+      *std::max_element(shape.nmax_by_l.begin(), shape.nmax_by_l.end());
+  plan.wave_function_bytes +=
+      sizeof(double) * radial::WaveFunctionStore::Size(params.npts, nmax, lmax);
+}
+
+void PrintPlan(const Plan& plan, const Calibration& calibration,
+               const int& num_threads, std::ostream& out)
+{
+  const double total_bytes = plan.wave_function_bytes
+                             + plan.radial_table_bytes + plan.operator_bytes;
+  const double cpu_seconds =
+      plan.integrals * calibration.seconds_per_integral
+      + plan.state_pairs * calibration.seconds_per_state_pair;
+  out << std::setprecision(4);
+  out << "Plan (no matrix elements calculated):\n"
+      << "  Space: " << plan.num_subspaces << " subspaces, " << plan.num_states
+      << " states\n"
+      << "  Sectors: " << plan.num_sectors << ", "
+      << plan.num_allowed_sectors << " allowed by the selection rules\n"
+      << "  State pairs: " << plan.state_pairs << "\n"
+      << "  Radial integrals: " << plan.integrals << "\n"
+      << "  Memory:\n"
+      << "    wave functions   " << MiB(plan.wave_function_bytes) << " MiB\n"
+      << "    radial tables    " << MiB(plan.radial_table_bytes) << " MiB\n"
+      << "    operator blocks  " << MiB(plan.operator_bytes) << " MiB\n"
+      << "    total            " << MiB(total_bytes) << " MiB\n"
+      << "  Predicted time: " << cpu_seconds / std::max(num_threads, 1)
+      << " s on " << num_threads << " threads, " << cpu_seconds
+      << " CPU s\n"
+      << "    (" << calibration.source << ")\n";
+}
+
+}  // namespace plan
+}  // namespace chime
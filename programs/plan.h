@@ -0,0 +1,114 @@
+/*******************************************************************************
+ plan.h
+
+ Defines the resource plan of an operator calculation: the sizes of its
+ space and sectors, the state pairs and radial integrals it calculates, the
+ memory of its tables and blocks, and a predicted run time. A plan is counted
+ from the labels of the space alone, without calculating any matrix elements
+ or radial integrals.
+
+ The run time is predicted from the CPU time per radial integral and per
+ state pair, either measured by a short benchmark of the radial quadrature
+ at the mesh size of the run and of the spin-angular tensor products of
+ sample state pairs, or taken from the run report (--report) of an earlier,
+ e.g., smaller, run of the same generator. The benchmark does not cover the
+ analytic evaluation of unregulated integrals, nor the radial integral
+ lookups of the state pairs, and neither prediction accounts for radial
+ integrals loaded from the cache.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef PLAN_H_
+#define PLAN_H_
+
+#include <iostream>
+#include <string>
+
+#include "radial.h"
+
+namespace chime {
+namespace plan {
+
+struct Plan {
+  std::size_t num_subspaces = 0;
+  std::size_t num_states = 0;
+  std::size_t num_sectors = 0;
+  std::size_t num_allowed_sectors = 0;  // not vanishing by selection rules
+
+  // Work.
+  double state_pairs = 0;  // reduced matrix elements calculated
+  double integrals = 0;    // radial integrals tabulated
+
+  // Memory in bytes.
+  double wave_function_bytes = 0;
+  double radial_table_bytes = 0;
+  double operator_bytes = 0;
+};
+
+// CPU time per unit of work, and where it comes from.
+struct Calibration {
+  double seconds_per_integral = 0;
+  double seconds_per_state_pair = 0;
+  std::string source;
+};
+
+// Calibration by a benchmark of the radial quadrature on the mesh size of
+// `params`, and of the tensor products of the state pairs of a small
+// relative-cm space, each run on the calling thread for about a tenth of a
+// second.
+Calibration BenchmarkQuadrature(const radial::RadialParameters& params);
+
+// Calibration from the run report `filename` written by instrument.h.
+//
+// Throws:
+//   std::runtime_error if the file cannot be read, or the report has no
+//   radial integrals or state pairs to calibrate from
+Calibration ReadCalibration(const std::string& filename);
+
+// Adds the subspaces and states of `space` to `plan`.
+template <typename SpaceType>
+void CountSpace(const SpaceType& space, Plan& plan)
+{
+  plan.num_subspaces += space.size();
+  for (std::size_t subspace_index = 0; subspace_index < space.size();
+       ++subspace_index) {
+    plan.num_states += space.GetSubspace(subspace_index).size();
+  }
+}
+
+// Adds the sectors of `sectors` to `plan`, with the state pairs `cost` of
+// each sector, 0 if the sector vanishes by the selection rules. All blocks
+// are allocated, including those of vanishing sectors.
+template <typename SectorsType, typename CostFunction>
+void CountSectors(const SectorsType& sectors, const CostFunction& cost,
+                  Plan& plan)
+{
+  for (std::size_t sector_index = 0; sector_index < sectors.size();
+       ++sector_index) {
+    const auto& sector = sectors.GetSector(sector_index);
+    const double sector_cost = cost(sector);
+    plan.num_sectors += 1;
+    plan.num_allowed_sectors += (sector_cost > 0);
+    plan.state_pairs += sector_cost;
+    plan.operator_bytes += sizeof(double) * double(sector.bra_subspace().size())
+                           * sector.ket_subspace().size();
+  }
+}
+
+// Adds a radial integral table of shape `shape`, and the wave functions it
+// is tabulated from on the mesh of `params`, to `plan`.
+void CountRadialTable(const radial::RadialTableShape& shape,
+                      const radial::RadialParameters& params, Plan& plan);
+
+// Prints `plan`, with the run time predicted by `calibration` on
+// `num_threads` threads.
+void PrintPlan(const Plan& plan, const Calibration& calibration,
+               const int& num_threads, std::ostream& out = std::cout);
+
+}  // namespace plan
+}  // namespace chime
+
+#endif
@@ -0,0 +1,408 @@
+#include "radial.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "basis_func/ho.h"
+#include "quadpp/quadpp.h"
+
+namespace chime {
+namespace radial {
+
+Eigen::ArrayXd SplineQuadratureWeights(const Eigen::ArrayXd& x)
+{
+  // The integral of the natural cubic spline through (x_i, y_i) is
+  //
+  //   sum_i h_i (y_i + y_{i+1}) / 2 - sum_i h_i^3 (M_i + M_{i+1}) / 24,
+  //
+  // with h_i = x_{i+1} - x_i and the second derivatives M = A^-1 B y, where
+  // A is the symmetric tridiagonal spline matrix and B the matrix of second
+  // differences, with M vanishing at the end points. Collecting the
+  // coefficients c of M, the weights are t - B^T z with A z = c, so that a
+  // single tridiagonal solve gives all weights.
+  const int npts = x.size();
+  Eigen::ArrayXd weights = Eigen::ArrayXd::Zero(npts);
+  if (npts < 2) {
+    return weights;
+  }
+  const Eigen::ArrayXd h = x.tail(npts - 1) - x.head(npts - 1);
+  weights.head(npts - 1) += h / 2;
+  weights.tail(npts - 1) += h / 2;
+  const int interior = npts - 2;
+  if (interior == 0) {
+    return weights;
+  }
+
+  // Thomas algorithm for A z = c, on the interior points 1 to npts - 2.
+  Eigen::ArrayXd upper(interior), z(interior);
+  for (int k = 0; k < interior; ++k) {
+    const int i = k + 1;
+    const double diagonal = (h(i - 1) + h(i)) / 3;
+    const double lower = (k > 0) ? h(i - 1) / 6 : 0;
+    const double c =
+        (h(i - 1) * h(i - 1) * h(i - 1) + h(i) * h(i) * h(i)) / 24;
+    const double pivot = diagonal - ((k > 0) ? lower * upper(k - 1) : 0);
+    upper(k) = h(i) / 6 / pivot;
+    z(k) = (c - ((k > 0) ? lower * z(k - 1) : 0)) / pivot;
+  }
+  for (int k = interior - 2; k >= 0; --k) {
+    z(k) -= upper(k) * z(k + 1);
+  }
+
+  for (int k = 0; k < interior; ++k) {
+    const int i = k + 1;
+    weights(i - 1) -= z(k) / h(i - 1);
+    weights(i) += z(k) * (1 / h(i - 1) + 1 / h(i));
+    weights(i + 1) -= z(k) / h(i);
+  }
+  return weights;
+}
+
+MeshWindow ActiveWindow(const Eigen::Ref<const Eigen::ArrayXd>& values,
+                        const double& tolerance, const int& anchor)
+{
+  const int npts = values.size();
+  const double threshold = tolerance * values.abs().maxCoeff();
+  int begin = 0, end = npts;
+  while ((begin < anchor) && (std::abs(values(begin)) <= threshold)) {
+    ++begin;
+  }
+  while ((end > anchor + 1) && (std::abs(values(end - 1)) <= threshold)) {
+    --end;
+  }
+  return {begin, end};
+}
+
+///////////////////////////////////////////////////////////////////////////
+//////////////////////////// RadialIntegralTable //////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+RadialIntegralTable::RadialIntegralTable(const int& num_kernels,
+                                         const int& max_delta_l,
+                                         const std::vector<int>& nmax_by_l)
+    : num_kernels_(num_kernels),
+      max_delta_l_(max_delta_l),
+      nmax_by_l_(nmax_by_l)
+{
+  ComputeOffsets();
+  storage_.assign(size_, 0.);
+}
+
+RadialIntegralTable::RadialIntegralTable(const int& num_kernels,
+                                         const int& max_delta_l,
+                                         const std::vector<int>& nmax_by_l,
+                                         const double* data,
+                                         std::shared_ptr<const void> owner)
+    : num_kernels_(num_kernels),
+      max_delta_l_(max_delta_l),
+      nmax_by_l_(nmax_by_l),
+      owner_(std::move(owner)),
+      external_data_(data)
+{
+  ComputeOffsets();
+}
+
+void RadialIntegralTable::ComputeOffsets()
+{
+  const int num_deltas = 2 * max_delta_l_ + 1;
+  offsets_.assign(num_kernels_ * (lmax() + 1) * num_deltas, 0);
+  size_ = 0;
+  for (int kernel = 0; kernel < num_kernels_; ++kernel) {
+    for (int bra_l = 0; bra_l <= lmax(); ++bra_l) {
+      for (int ket_l = bra_l - max_delta_l_; ket_l <= bra_l + max_delta_l_;
+           ++ket_l) {
+        if (!HasBlock(bra_l, ket_l)) {
+          continue;
+        }
+        offsets_[(kernel * (lmax() + 1) + bra_l) * num_deltas
+                 + (ket_l - bra_l + max_delta_l_)] = size_;
+        size_ += std::size_t(nmax(bra_l) + 1) * (nmax(ket_l) + 1);
+      }
+    }
+  }
+}
+
+std::size_t RadialTableSize(const RadialTableShape& shape)
+{
+  const RadialIntegralTable table(shape.num_kernels, shape.max_delta_l,
+                                  shape.nmax_by_l, nullptr, nullptr);
+  return table.size();
+}
+
+std::vector<std::pair<int, int>> RadialIntegralTable::blocks() const
+{
+  std::vector<std::pair<int, int>> result;
+  for (int bra_l = 0; bra_l <= lmax(); ++bra_l) {
+    for (int ket_l = 0; ket_l <= lmax(); ++ket_l) {
+      if (HasBlock(bra_l, ket_l)) {
+        result.emplace_back(bra_l, ket_l);
+      }
+    }
+  }
+  return result;
+}
+
+void PrintTabulationStatistics(const TabulationStatistics& statistics)
+{
+  std::cout << "  Average active mesh fraction " << statistics.active_fraction
+            << "\n";
+  if (statistics.num_screened > 0) {
+    std::cout << "  Screened " << statistics.num_screened << " of "
+              << statistics.num_pairs << " radial integral pairs\n";
+  }
+}
+
+void PrintAccuracyReport(const AccuracyReport& report,
+                         const RadialParameters& params)
+{
+  std::cout << "  Radial integral error estimate: max " << report.max_error
+            << " mean " << report.mean_error << " (tolerance "
+            << params.tolerance << ", finest mesh " << report.max_npts
+            << " points)\n";
+  if (report.num_unconverged > 0) {
+    std::cout << "  WARNING: " << report.num_unconverged << " of "
+              << report.num_blocks << " blocks did not reach the tolerance"
+              << " with " << params.max_npts << " mesh points\n";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+/////////////////////////////////// Cache /////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+cache::KeyBuilder RadialIntegralKey(const RadialParameters& params,
+                                    const double& b, const double& R,
+                                    const int& max_delta_l,
+                                    const std::vector<int>& nmax_by_l)
+{
+  cache::KeyBuilder key("radial");
+  // The mesh is in the dimensionless radius rho = r / b.
+  key.Add(std::string("rho"));
+  key.Add(params.npts).Add(params.mesh_low).Add(params.mesh_high);
+  key.Add(params.window_tolerance).Add(params.screening_threshold);
+  key.Add(params.tolerance).Add(params.adaptive_min_npts).Add(params.max_npts);
+  key.Add(b).Add(R).Add(max_delta_l).Add(nmax_by_l);
+  return key;
+}
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////// WaveFunctionStore ///////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+WaveFunctionStore WaveFunctionStore::Open(const RadialParameters& params,
+                                          const int& nmax, const int& lmax)
+{
+  assert((nmax >= 0) && (lmax >= 0));
+  cache::KeyBuilder key("howf");
+  key.Add(params.npts).Add(params.mesh_low).Add(params.mesh_high);
+  key.Add(nmax).Add(lmax);
+
+  WaveFunctionStore store;
+  store.npts_ = params.npts;
+  store.nmax_ = nmax;
+  store.lmax_ = lmax;
+  for (int l = 0; l <= lmax; ++l) {
+    store.slots_.push_back(l);
+  }
+  store.num_slots_ = lmax + 1;
+
+  // Metadata: npts, nmax, lmax.
+  cache::Entry entry;
+  if (cache::LoadEntry(params.cache, key, entry)
+      && (entry.metadata == std::vector<std::int64_t>{params.npts, nmax, lmax})
+      && (entry.payload_size == store.size())) {
+    store.owner_ = std::move(entry.owner);
+    store.external_data_ = entry.payload;
+    store.ComputeWindows(params.window_tolerance);
+    std::cout << "  Loaded basis functions from cache entry " << key.str()
+              << "\n";
+    return store;
+  }
+
+  std::cout << "  Generating basis functions...\n";
+  Eigen::ArrayXd x, rho, jac;
+  {
+    instrument::ScopedPhase phase(instrument::Phase::kMesh);
+    quadpp::SemiInfiniteIntegralMesh(params.npts, params.mesh_low,
+                                     params.mesh_high, x, rho, jac);
+  }
+  std::vector<Eigen::ArrayXXd> ho_wfs;
+  {
+    instrument::ScopedPhase phase(instrument::Phase::kWaveFunctions);
+    basis_func::ho::WaveFunctionsUptoMaxL(ho_wfs, rho, nmax, lmax, 1.,
+                                          basis_func::Space::coordinate);
+  }
+
+  // Store each wave function contiguously along the mesh.
+  store.storage_.resize(store.size());
+  Eigen::Map<Eigen::ArrayXXd> columns(store.storage_.data(), store.npts_,
+                                      store.size() / store.npts_);
+  columns.col(0) = x;
+  columns.col(1) = rho;
+  columns.col(2) = jac;
+  for (int l = 0; l <= lmax; ++l) {
+    columns.middleCols(kNumMeshArrays + l * (nmax + 1), nmax + 1) =
+        ho_wfs[l].transpose();
+  }
+  store.ComputeWindows(params.window_tolerance);
+
+  if (cache::StoreEntry(params.cache, key, {params.npts, nmax, lmax},
+                        store.data(), store.size())) {
+    std::cout << "  Stored basis functions in cache entry " << key.str()
+              << "\n";
+  }
+  return store;
+}
+
+WaveFunctionStore WaveFunctionStore::Refine(const WaveFunctionStore& coarse,
+                                            const RadialParameters& params,
+                                            const std::vector<int>& ls)
+{
+  assert(params.npts == 2 * (coarse.npts() - 1) + 1);
+  WaveFunctionStore store;
+  store.npts_ = params.npts;
+  store.nmax_ = coarse.nmax();
+  store.lmax_ = coarse.lmax();
+  store.slots_.assign(store.lmax_ + 1, -1);
+  for (const int& l : ls) {
+    assert(coarse.HasWaveFunctions(l));
+    if (store.slots_[l] < 0) {
+      store.slots_[l] = store.num_slots_++;
+    }
+  }
+
+  Eigen::ArrayXd x, rho, jac;
+  {
+    instrument::ScopedPhase phase(instrument::Phase::kMesh);
+    quadpp::SemiInfiniteIntegralMesh(params.npts, params.mesh_low,
+                                     params.mesh_high, x, rho, jac);
+  }
+  store.storage_.resize(store.size());
+  Eigen::Map<Eigen::ArrayXXd> columns(store.storage_.data(), store.npts_,
+                                      store.size() / store.npts_);
+  columns.col(0) = x;
+  columns.col(1) = rho;
+  columns.col(2) = jac;
+
+  // The even points of the new mesh are those of `coarse`, if the meshes are
+  // nested, and only the odd points are new.
+  const Eigen::Map<const Eigen::ArrayXd> coarse_x = coarse.x();
+  double mismatch = 0;
+  for (int i = 0; i < coarse.npts(); ++i) {
+    mismatch = std::max(mismatch, std::abs(x(2 * i) - coarse_x(i)));
+  }
+  const bool nested = (mismatch <= 1e-14);
+  const int num_new = nested ? coarse.npts() - 1 : store.npts_;
+  Eigen::ArrayXd new_rho(num_new);
+  for (int i = 0; i < num_new; ++i) {
+    new_rho(i) = rho(nested ? 2 * i + 1 : i);
+  }
+
+  std::cout << "  Generating basis functions at " << num_new
+            << " new mesh points...\n";
+  instrument::ScopedPhase phase(instrument::Phase::kWaveFunctions);
+  const int num_ls = ls.size();
+#pragma omp parallel for schedule(dynamic)
+  for (int index = 0; index < num_ls; ++index) {
+    const int l = ls[index];
+    Eigen::ArrayXXd ho_wfs;
+    basis_func::ho::WaveFunctionsUptoMaxN(ho_wfs, new_rho, store.nmax_, l, 1.,
+                                          basis_func::Space::coordinate);
+    auto wave_functions = columns.middleCols(
+        kNumMeshArrays + store.slots_[l] * (store.nmax_ + 1),
+        store.nmax_ + 1);
+    for (int i = 0; i < num_new; ++i) {
+      wave_functions.row(nested ? 2 * i + 1 : i) = ho_wfs.col(i).transpose();
+    }
+    if (nested) {
+      const Eigen::Map<const Eigen::ArrayXXd> coarse_wave_functions =
+          coarse.wave_functions(l);
+      for (int i = 0; i < coarse.npts(); ++i) {
+        wave_functions.row(2 * i) = coarse_wave_functions.row(i);
+      }
+    }
+  }
+  store.ComputeWindows(params.window_tolerance);
+  return store;
+}
+
+WaveFunctionStore WaveFunctionStore::Copy() const
+{
+  WaveFunctionStore store;
+  store.npts_ = npts_;
+  store.nmax_ = nmax_;
+  store.lmax_ = lmax_;
+  store.slots_ = slots_;
+  store.num_slots_ = num_slots_;
+  store.storage_.assign(data(), data() + size());
+  store.windows_ = windows_;
+  return store;
+}
+
+bool LoadRadialIntegralTable(const cache::CacheParameters& params,
+                             const cache::KeyBuilder& key,
+                             RadialIntegralTable& table)
+{
+  cache::Entry entry;
+  if (!cache::LoadEntry(params, key, entry)) {
+    return false;
+  }
+
+  // Metadata: num_kernels, max_delta_l, nmax_by_l...
+  if (entry.metadata.size() < 2) {
+    return false;
+  }
+  const int num_kernels = entry.metadata[0];
+  const int max_delta_l = entry.metadata[1];
+  const std::vector<int> nmax_by_l(entry.metadata.begin() + 2,
+                                   entry.metadata.end());
+  table = RadialIntegralTable(num_kernels, max_delta_l, nmax_by_l,
+                              entry.payload, entry.owner);
+  if (table.size() != entry.payload_size) {
+    table = RadialIntegralTable();
+    return false;
+  }
+  std::cout << "  Loaded radial integrals from cache entry " << key.str()
+            << "\n";
+  return true;
+}
+
+void StoreRadialIntegralTable(const cache::CacheParameters& params,
+                              const cache::KeyBuilder& key,
+                              const RadialIntegralTable& table)
+{
+  std::vector<std::int64_t> metadata{table.num_kernels(),
+                                     table.max_delta_l()};
+  metadata.insert(metadata.end(), table.nmax_by_l().begin(),
+                  table.nmax_by_l().end());
+  if (cache::StoreEntry(params, key, metadata, table.data(), table.size())) {
+    std::cout << "  Stored radial integrals in cache entry " << key.str()
+              << "\n";
+  }
+}
+
+void WaveFunctionStore::ComputeWindows(const double& tolerance)
+{
+  const Eigen::Map<const Eigen::ArrayXd> mesh = rho();
+  windows_.resize(std::size_t(num_slots_) * (nmax_ + 1));
+  for (int l = 0; l <= lmax_; ++l) {
+    if (!HasWaveFunctions(l)) {
+      continue;
+    }
+    for (int n = 0; n <= nmax_; ++n) {
+      // Classical turning point rho^2 = 2 (2n + l + 3/2).
+      const double turning_point = std::sqrt(4. * n + 2. * l + 3.);
+      const int anchor = std::min(
+          int(std::lower_bound(mesh.data(), mesh.data() + npts_,
+                               turning_point)
+              - mesh.data()),
+          npts_ - 1);
+      windows_[std::size_t(slots_[l]) * (nmax_ + 1) + n] =
+          ActiveWindow(wave_functions(l).col(n), tolerance, anchor);
+    }
+  }
+}
+
+}  // namespace radial
+}  // namespace chime
@@ -0,0 +1,763 @@
+/*******************************************************************************
+ radial.h
+
+ Defines the radial integration machinery shared by the relative and
+ relative-cm matrix element calculations.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef RADIAL_H_
+#define RADIAL_H_
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cache.h"
+#include "instrument.h"
+#include "numa.h"
+#include "simd.h"
+
+namespace chime {
+namespace radial {
+
+// Parameters of the radial integration.
+struct RadialParameters {
+  // Semi-infinite integration mesh, see quadpp::SemiInfiniteIntegralMesh.
+  int npts = 3001;
+  double mesh_low = 0;
+  double mesh_high = 1;
+
+  // Mesh points where a wave function or kernel weight is below this
+  // fraction of its maximum are excluded from the integration windows.
+  double window_tolerance = 1e-17;
+
+  // Radial integrals whose Cauchy-Schwarz bound is below this threshold for
+  // all kernels are not calculated, but set to zero. 0 disables screening.
+  double screening_threshold = 0;
+
+  // Adaptive accuracy control. If tolerance > 0, each (l', l) block of a
+  // radial integral table is recalculated on successively doubled meshes,
+  // starting from adaptive_min_npts points, until its integrals change by at
+  // most tolerance, or the mesh would exceed max_npts points. max_npts must
+  // allow one doubling, 2 adaptive_min_npts - 1 points. npts is then only
+  // used for analytic fallbacks.
+  double tolerance = 0;
+  int adaptive_min_npts = 201;
+  int max_npts = 102401;
+
+  // Low-rank compression of the radial integral blocks, see lowrank.h. 0
+  // disables compression. If low_rank_filename is not empty, the factors are
+  // written to that file.
+  double low_rank_tolerance = 0;
+  std::string low_rank_filename;
+
+  // Evaluate unregulated (R = 0) Yukawa kernels analytically, see yukawa.h.
+  bool analytic = true;
+
+  // On-disk cache of radial integral tables.
+  cache::CacheParameters cache;
+};
+
+// Range [begin, end) of mesh points contributing to an integral.
+struct MeshWindow {
+  int begin;
+  int end;
+
+  int size() const { return std::max(end - begin, 0); }
+};
+
+// Intersection of two windows.
+inline MeshWindow Intersect(const MeshWindow& a, const MeshWindow& b)
+{
+  return {std::max(a.begin, b.begin), std::min(a.end, b.end)};
+}
+
+// Smallest window containing all points where |values| exceeds `tolerance`
+// times its maximum, extended to contain the point `anchor`.
+MeshWindow ActiveWindow(const Eigen::Ref<const Eigen::ArrayXd>& values,
+                        const double& tolerance, const int& anchor);
+
+// Calculates the quadrature weights equivalent to quadpp::spline::Integrate,
+// the integral of the natural cubic spline through the integrand values, in
+// O(npts) operations. The spline integral is linear in the integrand values,
+// so that
+//
+//   quadpp::spline::Integrate(x, y) = (weights * y).sum().
+//
+// Arguments:
+//   x (Eigen::ArrayXd): integration mesh
+// Returns:
+//   quadrature weights on the mesh
+Eigen::ArrayXd SplineQuadratureWeights(const Eigen::ArrayXd& x);
+
+// Evaluates the radial integrals of a fixed set of `K` kernels between a
+// pair of wave functions in a single sweep over the mesh. The quadrature
+// weights, the integration measure and the kernels are folded into one weight
+// array per kernel at construction, so that each integral reduces to
+//
+//   sum_i psi_a(i) * psi_b(i) * weights(i, k).
+//
+// The first and last mesh points, r = 0 and r = infinity, are excluded from
+// the sums, since the kernels are singular there.
+template <int K>
+class FusedIntegrator {
+ public:
+  using Kernels = std::array<Eigen::ArrayXd, K>;
+  using Integrals = std::array<double, K>;
+
+  FusedIntegrator() = default;
+
+  // Arguments:
+  //   x (Eigen::ArrayXd): integration mesh
+  //   measure (Eigen::ArrayXd): integration measure on the mesh, including
+  //     the jacobian of the mesh transformation and any regulator
+  //   kernels (std::array<Eigen::ArrayXd, K>): kernels on the mesh
+  //   window_tolerance (double): see RadialParameters
+  FusedIntegrator(const Eigen::ArrayXd& x, const Eigen::ArrayXd& measure,
+                  const Kernels& kernels,
+                  const double& window_tolerance = 0);
+
+  // Calculate the `K` integrals between the wave functions `bra_wf` and
+  // `ket_wf`, tabulated on the same mesh. The sweep uses the explicitly
+  // vectorized kernels of simd.h, and is restricted to `window` and the
+  // window of the kernels.
+  Integrals Integrate(const Eigen::Ref<const Eigen::ArrayXd>& bra_wf,
+                      const Eigen::Ref<const Eigen::ArrayXd>& ket_wf,
+                      const MeshWindow& window) const;
+  Integrals Integrate(const Eigen::Ref<const Eigen::ArrayXd>& bra_wf,
+                      const Eigen::Ref<const Eigen::ArrayXd>& ket_wf) const
+  {
+    return Integrate(bra_wf, ket_wf, window_);
+  }
+
+  // Number of mesh points.
+  int size() const { return weights_.rows(); }
+
+  // Square roots of the segmented Cauchy-Schwarz norms of `wf`,
+  //
+  //   norms(s, k) = sqrt(sum_{i in segment s} wf(i)^2 |weights(i, k)|),
+  //
+  // for `num_segments` equal segments of the mesh. For two wave functions
+  //
+  //   |integral k| <= sum_s norms_a(s, k) * norms_b(s, k).
+  Eigen::ArrayXXd SegmentNorms(const Eigen::Ref<const Eigen::ArrayXd>& wf,
+                               const int& num_segments) const;
+
+  // Window of kernel `k`, and union of the windows of all kernels.
+  const MeshWindow& window(const int& k) const { return kernel_windows_[k]; }
+  const MeshWindow& window() const { return window_; }
+
+ private:
+  Eigen::Array<double, Eigen::Dynamic, K> weights_;
+  std::array<MeshWindow, K> kernel_windows_;
+  MeshWindow window_;
+};
+
+template <int K>
+FusedIntegrator<K>::FusedIntegrator(const Eigen::ArrayXd& x,
+                                    const Eigen::ArrayXd& measure,
+                                    const Kernels& kernels,
+                                    const double& window_tolerance)
+{
+  const Eigen::ArrayXd quadrature = SplineQuadratureWeights(x) * measure;
+  const int npts = x.size();
+  weights_.resize(npts, K);
+  window_ = {npts, 0};
+  for (int k = 0; k < K; ++k) {
+    assert(kernels[k].size() == npts);
+    weights_.col(k) = quadrature * kernels[k];
+    weights_(0, k) = 0;         // Required to avoid divide by 0.
+    weights_(npts - 1, k) = 0;  // Required to avoid divide by 0.
+    // Anchored at the largest weight, so that the regulator suppression
+    // near r = 0 is trimmed as well as the tail.
+    int anchor;
+    weights_.col(k).abs().maxCoeff(&anchor);
+    kernel_windows_[k] =
+        Intersect(ActiveWindow(weights_.col(k), window_tolerance, anchor),
+                  {1, npts - 1});
+    window_ = {std::min(window_.begin, kernel_windows_[k].begin),
+               std::max(window_.end, kernel_windows_[k].end)};
+  }
+}
+
+template <int K>
+Eigen::ArrayXXd FusedIntegrator<K>::SegmentNorms(
+    const Eigen::Ref<const Eigen::ArrayXd>& wf, const int& num_segments) const
+{
+  const int npts = size();
+  const Eigen::ArrayXd density = wf.square();
+  Eigen::ArrayXXd norms(num_segments, K);
+  for (int s = 0; s < num_segments; ++s) {
+    const int begin = std::size_t(npts) * s / num_segments;
+    const int end = std::size_t(npts) * (s + 1) / num_segments;
+    for (int k = 0; k < K; ++k) {
+      norms(s, k) = (density.segment(begin, end - begin)
+                     * weights_.col(k).segment(begin, end - begin).abs())
+                        .sum();
+    }
+  }
+  return norms.sqrt();
+}
+
+template <int K>
+typename FusedIntegrator<K>::Integrals FusedIntegrator<K>::Integrate(
+    const Eigen::Ref<const Eigen::ArrayXd>& bra_wf,
+    const Eigen::Ref<const Eigen::ArrayXd>& ket_wf,
+    const MeshWindow& window) const
+{
+  assert((bra_wf.size() == size()) && (ket_wf.size() == size()));
+
+  const MeshWindow active = Intersect(window, window_);
+  Integrals sums;
+  sums.fill(0);
+  if (active.size() == 0) {
+    return sums;
+  }
+  instrument::Count(instrument::Counter::kIntegrals, K);
+  instrument::Count(instrument::Counter::kFlops, (2 * K + 1) * active.size());
+  std::array<const double*, K> weights;
+  for (int k = 0; k < K; ++k) {
+    weights[k] = weights_.col(k).data();
+  }
+  simd::FusedProductSums(bra_wf.data(), ket_wf.data(), weights.data(), K,
+                         active.begin, active.end, sums.data());
+  return sums;
+}
+
+// Table of the radial integrals <n' l'| kernel |n l> of a set of kernels,
+// for all pairs of orbital angular momenta with |l' - l| <= max_delta_l. For
+// each kernel and (l', l) pair the integrals are stored as a column-major
+// block indexed by (n', n).
+//
+// The table either owns its storage, or refers to read-only storage owned by
+// someone else, e.g., a memory mapped cache entry.
+class RadialIntegralTable {
+ public:
+  RadialIntegralTable() = default;
+
+  // Zero initialized table.
+  //
+  // Arguments:
+  //   num_kernels (int): number of kernels
+  //   max_delta_l (int): maximum |l' - l|
+  //   nmax_by_l (std::vector<int>): maximum radial quantum number for each
+  //     l, or -1 if there are no states with that l
+  RadialIntegralTable(const int& num_kernels, const int& max_delta_l,
+                      const std::vector<int>& nmax_by_l);
+
+  // Table referring to external storage `data`, kept alive by `owner`.
+  RadialIntegralTable(const int& num_kernels, const int& max_delta_l,
+                      const std::vector<int>& nmax_by_l, const double* data,
+                      std::shared_ptr<const void> owner);
+
+  int num_kernels() const { return num_kernels_; }
+  int max_delta_l() const { return max_delta_l_; }
+  int lmax() const { return int(nmax_by_l_.size()) - 1; }
+  int nmax(const int& l) const { return nmax_by_l_[l]; }
+  const std::vector<int>& nmax_by_l() const { return nmax_by_l_; }
+
+  // All (l', l) pairs of the table.
+  std::vector<std::pair<int, int>> blocks() const;
+
+  // Whether the table contains integrals between l' and l.
+  bool HasBlock(const int& bra_l, const int& ket_l) const
+  {
+    return (bra_l >= 0) && (ket_l >= 0) && (bra_l <= lmax())
+           && (ket_l <= lmax()) && (std::abs(bra_l - ket_l) <= max_delta_l_);
+  }
+
+  // Block of integrals of kernel `kernel` between l' and l.
+  Eigen::Map<const Eigen::MatrixXd> block(const int& kernel,
+                                          const int& bra_l,
+                                          const int& ket_l) const
+  {
+    return Eigen::Map<const Eigen::MatrixXd>(
+        data() + offset(kernel, bra_l, ket_l), nmax(bra_l) + 1,
+        nmax(ket_l) + 1);
+  }
+
+  // Writable block, only for tables owning their storage.
+  Eigen::Map<Eigen::MatrixXd> mutable_block(const int& kernel,
+                                            const int& bra_l,
+                                            const int& ket_l)
+  {
+    assert(!owner_);
+    return Eigen::Map<Eigen::MatrixXd>(
+        storage_.data() + offset(kernel, bra_l, ket_l), nmax(bra_l) + 1,
+        nmax(ket_l) + 1);
+  }
+
+  // Integral <n' l'| kernel |n l>.
+  double operator()(const int& kernel, const int& bra_l, const int& bra_n,
+                    const int& ket_l, const int& ket_n) const
+  {
+    assert((bra_n <= nmax(bra_l)) && (ket_n <= nmax(ket_l)));
+    return data()[offset(kernel, bra_l, ket_l) + ket_n * (nmax(bra_l) + 1)
+                 + bra_n];
+  }
+
+  // Flat storage of all blocks.
+  const double* data() const
+  {
+    return owner_ ? external_data_ : storage_.data();
+  }
+  std::size_t size() const { return size_; }
+
+ private:
+  void ComputeOffsets();
+  std::size_t offset(const int& kernel, const int& bra_l,
+                     const int& ket_l) const
+  {
+    assert(HasBlock(bra_l, ket_l));
+    return offsets_[(kernel * (lmax() + 1) + bra_l) * (2 * max_delta_l_ + 1)
+                    + (ket_l - bra_l + max_delta_l_)];
+  }
+
+  int num_kernels_ = 0;
+  int max_delta_l_ = 0;
+  std::vector<int> nmax_by_l_;
+  std::vector<std::size_t> offsets_;
+  std::size_t size_ = 0;
+  std::vector<double> storage_;
+  std::shared_ptr<const void> owner_;
+  const double* external_data_ = nullptr;
+};
+
+// Shape of a radial integral table, as passed to the RadialIntegralTable
+// constructor, for sizing a table without allocating it.
+struct RadialTableShape {
+  int num_kernels;
+  int max_delta_l;
+  std::vector<int> nmax_by_l;
+};
+
+// Number of integrals of a table of shape `shape`.
+std::size_t RadialTableSize(const RadialTableShape& shape);
+
+// Harmonic oscillator radial wave functions R_nl(rho) of unit oscillator
+// length, tabulated on the dimensionless integration mesh rho = r / b. These
+// are universal: the wave functions of oscillator length b are
+//
+//   R_nl(r; b) = b^(-3/2) R_nl(r / b),
+//
+// so that a radial integral in r reduces to one in rho with the kernel
+// evaluated at r = b rho,
+//
+//   int dr r^2 R_n'l'(r; b) K(r) R_nl(r; b)
+//     = int drho rho^2 R_n'l'(rho) K(b rho) R_nl(rho).
+//
+// The store only depends on the mesh and the quantum number ranges. It is kept
+// in the on-disk cache and memory mapped read-only, so that only the first run
+// with a given mesh pays for generating the wave functions.
+class WaveFunctionStore {
+ public:
+  WaveFunctionStore() = default;
+
+  // Loads the store for the mesh of `params` with n <= nmax and l <= lmax
+  // from the cache, or generates it and stores it in the cache.
+  static WaveFunctionStore Open(const RadialParameters& params,
+                                const int& nmax, const int& lmax);
+
+  // Store on the mesh of `params`, with twice the intervals of the mesh of
+  // `coarse`, holding only the wave functions of the distinct angular
+  // momenta `ls`, which `coarse` must hold. If the mesh of `coarse` is nested
+  // in the new one, its values are copied, and only the new midpoints are
+  // evaluated. Refined stores are not cached.
+  static WaveFunctionStore Refine(const WaveFunctionStore& coarse,
+                                  const RadialParameters& params,
+                                  const std::vector<int>& ls);
+
+  // Copy owning its storage, e.g., a node-local replica of a store memory
+  // mapped from the cache.
+  WaveFunctionStore Copy() const;
+
+  int npts() const { return npts_; }
+  int nmax() const { return nmax_; }
+  int lmax() const { return lmax_; }
+
+  // Whether the store holds the wave functions of angular momentum l.
+  bool HasWaveFunctions(const int& l) const
+  {
+    return (l >= 0) && (l <= lmax_) && (slots_[l] >= 0);
+  }
+
+  // Integration variable x of quadpp::SemiInfiniteIntegralMesh.
+  Eigen::Map<const Eigen::ArrayXd> x() const { return Column(0); }
+
+  // Dimensionless radius rho(x).
+  Eigen::Map<const Eigen::ArrayXd> rho() const { return Column(1); }
+
+  // Jacobian d rho / dx.
+  Eigen::Map<const Eigen::ArrayXd> jacobian() const { return Column(2); }
+
+  // Wave functions of angular momentum l. Column n holds R_nl on the mesh.
+  Eigen::Map<const Eigen::ArrayXXd> wave_functions(const int& l) const
+  {
+    assert(HasWaveFunctions(l));
+    return Eigen::Map<const Eigen::ArrayXXd>(
+        data()
+            + (kNumMeshArrays + std::size_t(slots_[l]) * (nmax_ + 1)) * npts_,
+        npts_, nmax_ + 1);
+  }
+
+  // Integration window of R_nl, anchored at the classical turning point.
+  const MeshWindow& window(const int& n, const int& l) const
+  {
+    assert(HasWaveFunctions(l));
+    return windows_[std::size_t(slots_[l]) * (nmax_ + 1) + n];
+  }
+
+  // Flat storage of mesh and wave functions.
+  const double* data() const
+  {
+    return owner_ ? external_data_ : storage_.data();
+  }
+  std::size_t size() const
+  {
+    return (kNumMeshArrays + std::size_t(num_slots_) * (nmax_ + 1)) * npts_;
+  }
+
+  // Size of the store of `npts` mesh points with n <= nmax and l <= lmax.
+  static std::size_t Size(const int& npts, const int& nmax, const int& lmax)
+  {
+    return (kNumMeshArrays + std::size_t(lmax + 1) * (nmax + 1)) * npts;
+  }
+
+ private:
+  static constexpr int kNumMeshArrays = 3;
+
+  void ComputeWindows(const double& tolerance);
+
+  Eigen::Map<const Eigen::ArrayXd> Column(const int& index) const
+  {
+    return Eigen::Map<const Eigen::ArrayXd>(
+        data() + std::size_t(index) * npts_, npts_);
+  }
+
+  int npts_ = 0;
+  int nmax_ = -1;
+  int lmax_ = -1;
+  // Position of the wave functions of each l in the storage, or -1 if the
+  // store does not hold them.
+  std::vector<int> slots_;
+  int num_slots_ = 0;
+  std::vector<double> storage_;
+  std::shared_ptr<const void> owner_;
+  const double* external_data_ = nullptr;
+  std::vector<MeshWindow> windows_;
+};
+
+// Work statistics of TabulateRadialIntegrals.
+struct TabulationStatistics {
+  std::size_t num_pairs = 0;      // (n' l', n l) pairs
+  std::size_t num_screened = 0;   // pairs set to zero by screening
+  double active_fraction = 0;     // average fraction of the mesh swept
+};
+
+// Calculates the entries of the (l', l) pairs `blocks` of `table` with
+// `integrator`, from the wave functions of `store`. The integrator must be
+// set up on the mesh of the store. Each integral only sweeps the intersection
+// of the windows of both wave functions and of the kernels.
+//
+// If `screening_threshold` > 0, pairs whose segmented Cauchy-Schwarz bound,
+// see FusedIntegrator::SegmentNorms, is below the threshold for all kernels
+// are set to zero without being integrated.
+template <int K>
+TabulationStatistics TabulateRadialIntegrals(
+    const FusedIntegrator<K>& integrator, const WaveFunctionStore& store,
+    const std::vector<std::pair<int, int>>& blocks, RadialIntegralTable& table,
+    const double& screening_threshold = 0);
+
+// Calculates all entries of `table`.
+template <int K>
+TabulationStatistics TabulateRadialIntegrals(
+    const FusedIntegrator<K>& integrator, const WaveFunctionStore& store,
+    RadialIntegralTable& table, const double& screening_threshold = 0)
+{
+  return TabulateRadialIntegrals(integrator, store, table.blocks(), table,
+                                 screening_threshold);
+}
+
+// Prints a summary of `statistics`.
+void PrintTabulationStatistics(const TabulationStatistics& statistics);
+
+// Estimated accuracy of an adaptively calculated radial integral table. The
+// error of each integral is estimated by its change under the last mesh
+// doubling.
+struct AccuracyReport {
+  double max_error = 0;
+  double mean_error = 0;
+  int max_npts = 0;         // finest mesh used
+  int num_blocks = 0;       // (l', l) blocks
+  int num_unconverged = 0;  // blocks missing the tolerance at max_npts
+};
+
+// Calculates all entries of `table` to the tolerance of `params`, see
+// RadialParameters. `make_integrator(store)` returns the FusedIntegrator<K>
+// of the kernels on the mesh of the wave function store `store`.
+template <int K, typename IntegratorFactory>
+AccuracyReport TabulateRadialIntegralsAdaptive(
+    const IntegratorFactory& make_integrator, const RadialParameters& params,
+    RadialIntegralTable& table);
+
+// Prints a summary of `report`.
+void PrintAccuracyReport(const AccuracyReport& report,
+                         const RadialParameters& params);
+
+// Cache key of a radial integral table. Builders add the identity of their
+// kernels, i.e., their names and any physical constants entering them.
+//
+// Arguments:
+//   params (RadialParameters): radial integration parameters
+//   b (double): oscillator length
+//   R (double): regulator parameter
+//   max_delta_l (int), nmax_by_l (std::vector<int>): table shape
+cache::KeyBuilder RadialIntegralKey(const RadialParameters& params,
+                                    const double& b, const double& R,
+                                    const int& max_delta_l,
+                                    const std::vector<int>& nmax_by_l);
+
+// Loads a radial integral table from the cache. The table refers to the
+// memory mapped cache entry. Returns false if there is no valid entry.
+bool LoadRadialIntegralTable(const cache::CacheParameters& params,
+                             const cache::KeyBuilder& key,
+                             RadialIntegralTable& table);
+
+// Stores a radial integral table in the cache.
+void StoreRadialIntegralTable(const cache::CacheParameters& params,
+                              const cache::KeyBuilder& key,
+                              const RadialIntegralTable& table);
+
+template <int K>
+TabulationStatistics TabulateRadialIntegrals(
+    const FusedIntegrator<K>& integrator, const WaveFunctionStore& store,
+    const std::vector<std::pair<int, int>>& blocks, RadialIntegralTable& table,
+    const double& screening_threshold)
+{
+  assert(table.num_kernels() == K);
+  assert(store.npts() == integrator.size());
+
+  // Flatten the (l', l, n') loops for load balance.
+  struct Task {
+    int bra_l, ket_l, bra_n;
+  };
+  std::vector<Task> tasks;
+  std::vector<char> used_l(table.lmax() + 1, 0);
+  for (const auto& block : blocks) {
+    assert(table.HasBlock(block.first, block.second));
+    assert(store.HasWaveFunctions(block.first)
+           && store.HasWaveFunctions(block.second));
+    used_l[block.first] = used_l[block.second] = 1;
+    for (int bra_n = 0; bra_n <= table.nmax(block.first); ++bra_n) {
+      tasks.push_back({block.first, block.second, bra_n});
+    }
+  }
+
+  // Segmented Cauchy-Schwarz norms of the wave functions of the blocks.
+  constexpr int kNumSegments = 16;
+  const bool screening = (screening_threshold > 0);
+  std::vector<std::vector<Eigen::ArrayXXd>> norms(table.lmax() + 1);
+  if (screening) {
+    for (int l = 0; l <= table.lmax(); ++l) {
+      norms[l].resize(table.nmax(l) + 1);
+    }
+#pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int l = 0; l <= table.lmax(); ++l) {
+      for (int n = 0; n <= store.nmax(); ++n) {
+        if (used_l[l] && (n <= table.nmax(l))) {
+          norms[l][n] = integrator.SegmentNorms(store.wave_functions(l).col(n),
+                                                kNumSegments);
+        }
+      }
+    }
+  }
+
+  // Node-local copies of the wave functions and kernels, see numa.h.
+  const numa::Replicas<WaveFunctionStore> store_replicas(
+      [&]() { return store.Copy(); });
+  const numa::Replicas<FusedIntegrator<K>> integrator_replicas(
+      [&]() { return integrator; });
+
+  double active_points = 0, total_points = 0;
+  std::size_t num_pairs = 0, num_screened = 0;
+#pragma omp parallel for schedule(dynamic) \
+    reduction(+ : active_points, total_points, num_pairs, num_screened)
+  for (std::size_t task_index = 0; task_index < tasks.size(); ++task_index) {
+    instrument::TraceSpan span("integrals", task_index);
+    const WaveFunctionStore& local_store = store_replicas.Local(store);
+    const FusedIntegrator<K>& local_integrator =
+        integrator_replicas.Local(integrator);
+    const Task& task = tasks[task_index];
+    const MeshWindow& bra_window = local_store.window(task.bra_n, task.bra_l);
+    for (int ket_n = 0; ket_n <= table.nmax(task.ket_l); ++ket_n) {
+      ++num_pairs;
+      if (screening) {
+        const double bound =
+            (norms[task.bra_l][task.bra_n] * norms[task.ket_l][ket_n])
+                .colwise()
+                .sum()
+                .maxCoeff();
+        if (bound < screening_threshold) {
+          for (int k = 0; k < K; ++k) {
+            table.mutable_block(k, task.bra_l, task.ket_l)(task.bra_n,
+                                                           ket_n) = 0;
+          }
+          ++num_screened;
+          continue;
+        }
+      }
+      const MeshWindow window =
+          Intersect(bra_window, local_store.window(ket_n, task.ket_l));
+      const auto integrals = local_integrator.Integrate(
+          local_store.wave_functions(task.bra_l).col(task.bra_n),
+          local_store.wave_functions(task.ket_l).col(ket_n), window);
+      for (int k = 0; k < K; ++k) {
+        table.mutable_block(k, task.bra_l, task.ket_l)(task.bra_n, ket_n) =
+            integrals[k];
+      }
+      active_points += Intersect(window, local_integrator.window()).size();
+      total_points += local_integrator.size();
+    }
+  }
+  TabulationStatistics statistics;
+  statistics.num_pairs = num_pairs;
+  statistics.num_screened = num_screened;
+  statistics.active_fraction =
+      (total_points > 0) ? active_points / total_points : 0;
+  return statistics;
+}
+
+template <int K, typename IntegratorFactory>
+AccuracyReport TabulateRadialIntegralsAdaptive(
+    const IntegratorFactory& make_integrator, const RadialParameters& params,
+    RadialIntegralTable& table)
+{
+  assert(params.tolerance > 0);
+  assert(params.max_npts >= 2 * (params.adaptive_min_npts - 1) + 1);
+  const int nmax =
+      *std::max_element(table.nmax_by_l().begin(), table.nmax_by_l().end());
+  std::vector<std::pair<int, int>> pending = table.blocks();
+
+  AccuracyReport report;
+  report.num_blocks = pending.size();
+  double error_sum = 0;
+  std::size_t num_errors = 0;
+
+  // Changes of the integrals of block `block` from the previous mesh.
+  RadialIntegralTable coarse(K, table.max_delta_l(), table.nmax_by_l());
+  auto changes = [&](const std::pair<int, int>& block) {
+    std::vector<Eigen::MatrixXd> result;
+    for (int k = 0; k < K; ++k) {
+      result.push_back((table.block(k, block.first, block.second)
+                        - coarse.block(k, block.first, block.second))
+                           .cwiseAbs());
+    }
+    return result;
+  };
+
+  // Accumulates the error estimates of a block once it is final.
+  auto accumulate = [&](const std::vector<Eigen::MatrixXd>& block_changes) {
+    for (const auto& change : block_changes) {
+      if (change.size() > 0) {
+        report.max_error = std::max(report.max_error, change.maxCoeff());
+      }
+      error_sum += change.sum();
+      num_errors += change.size();
+    }
+  };
+
+  // Keeps the integrals of the pending blocks for comparison.
+  auto keep_pending = [&]() {
+    for (const auto& block : pending) {
+      for (int k = 0; k < K; ++k) {
+        coarse.mutable_block(k, block.first, block.second) =
+            table.block(k, block.first, block.second);
+      }
+    }
+  };
+
+  // Each level only holds the wave functions of the angular momenta of the
+  // pending blocks, and reuses those of the previous level on its points.
+  RadialParameters level_params = params;
+  level_params.npts = params.adaptive_min_npts;
+  WaveFunctionStore store;
+  for (int level = 0;; ++level) {
+    if (level == 0) {
+      store = WaveFunctionStore::Open(level_params, nmax, table.lmax());
+    }
+    else {
+      std::vector<char> pending_l(table.lmax() + 1, 0);
+      for (const auto& block : pending) {
+        pending_l[block.first] = pending_l[block.second] = 1;
+      }
+      std::vector<int> ls;
+      for (int l = 0; l <= table.lmax(); ++l) {
+        if (pending_l[l]) {
+          ls.push_back(l);
+        }
+      }
+      store = WaveFunctionStore::Refine(store, level_params, ls);
+    }
+    TabulateRadialIntegrals(make_integrator(store), store, pending, table,
+                            params.screening_threshold);
+    report.max_npts = level_params.npts;
+    if (level == 0) {
+      keep_pending();
+      level_params.npts = 2 * (level_params.npts - 1) + 1;
+      continue;
+    }
+
+    // Accept blocks which changed by at most the tolerance.
+    const int next_npts = 2 * (level_params.npts - 1) + 1;
+    const bool finest = (next_npts > params.max_npts);
+    std::vector<std::pair<int, int>> unconverged;
+    for (const auto& block : pending) {
+      const std::vector<Eigen::MatrixXd> block_changes = changes(block);
+      double max_change = 0;
+      for (const auto& change : block_changes) {
+        if (change.size() > 0) {
+          max_change = std::max(max_change, change.maxCoeff());
+        }
+      }
+      if ((max_change <= params.tolerance) || finest) {
+        accumulate(block_changes);
+      }
+      if (max_change > params.tolerance) {
+        unconverged.push_back(block);
+      }
+    }
+    pending = unconverged;
+    if (pending.empty()) {
+      break;
+    }
+
+    // Refine the remaining blocks, or give up on them at the finest mesh.
+    if (finest) {
+      report.num_unconverged = pending.size();
+      break;
+    }
+    keep_pending();
+    std::cout << "  " << pending.size() << " of " << report.num_blocks
+              << " blocks refined to " << next_npts << " mesh points\n";
+    level_params.npts = next_npts;
+  }
+
+  report.mean_error = (num_errors > 0) ? error_sum / num_errors : 0;
+  return report;
+}
+
+}  // namespace radial
+}  // namespace chime
+
+#endif
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ radial_test.cpp
+
+ Compares the spline quadrature weights of radial.h with the spline integral
+ of quadpp, for known integrands on a uniform mesh, on the semi-infinite
+ radial mesh, and on short meshes.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+#include "quadpp/quadpp.h"
+#include "quadpp/spline.h"
+#include "radial.h"
+
+int main()
+{
+  bool passed = true;
+
+  Eigen::ArrayXd x_inf, r, jacobian;
+  quadpp::SemiInfiniteIntegralMesh(801, 0, 1, x_inf, r, jacobian);
+  // The semi-infinite mesh ends at r = infinity.
+  const Eigen::ArrayXd r_finite = r.head(r.size() - 1);
+  const struct {
+    const char* name;
+    Eigen::ArrayXd x;
+  } meshes[] = {
+      {"uniform", Eigen::ArrayXd::LinSpaced(1001, 0, 10)},
+      {"radial", r_finite},
+      {"two points", Eigen::ArrayXd::LinSpaced(2, 0, 1)},
+      {"three points", Eigen::ArrayXd::LinSpaced(3, 0, 1)},
+  };
+  const struct {
+    const char* name;
+    std::function<double(double)> function;
+    // Exact integral from 0 to x.
+    std::function<double(double)> integral;
+  } integrands[] = {
+      {"1", [](double) { return 1.; }, [](double x) { return x; }},
+      {"x^3", [](double x) { return x * x * x; },
+       [](double x) { return x * x * x * x / 4; }},
+      {"exp(-x)", [](double x) { return std::exp(-x); },
+       [](double x) { return 1 - std::exp(-x); }},
+      {"x^2 exp(-x^2)", [](double x) { return x * x * std::exp(-x * x); },
+       [](double x) {
+         return std::sqrt(M_PI) / 4 * std::erf(x) - x * std::exp(-x * x) / 2;
+       }},
+  };
+
+  for (const auto& mesh : meshes) {
+    const Eigen::ArrayXd weights =
+        chime::radial::SplineQuadratureWeights(mesh.x);
+    for (const auto& integrand : integrands) {
+      const Eigen::ArrayXd y = mesh.x.unaryExpr(integrand.function);
+      const double spline = quadpp::spline::Integrate(mesh.x, y);
+      const double quadrature = (weights * y).sum();
+      const double exact = integrand.integral(mesh.x(mesh.x.size() - 1))
+                           - integrand.integral(mesh.x(0));
+      const double deviation =
+          std::abs(quadrature - spline) / std::max(std::abs(spline), 1.);
+      std::cout << "Mesh " << mesh.name << ", integrand " << integrand.name
+                << ": spline " << spline << ", weights " << quadrature
+                << ", exact " << exact << ", deviation " << deviation << "\n";
+      passed &= (deviation < 1e-13);
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
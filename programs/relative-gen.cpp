@@ -3,6 +3,29 @@
 
  Generates relative matrix elements for defined operators.
 
+ Usage:
+   relative-gen [--npts=N] [--tolerance=EPS] [--max-npts=N]
+     [--screening=THRESHOLD] [--low-rank=TOL] [--low-rank-output=FILE]
+     [--no-analytic] [--cache-dir=DIR] [--cache-max-mb=N] [--no-cache]
+     [--report] [--perf] [--numa] [--sector-file] [--compress] [--trace]
+     [--plan] [--calibration=REPORT]
+
+ Radial integral tables are cached on disk between runs, see options.h.
+
+ With --plan, the resources of the run are printed without calculating the
+ operator, see plan.h.
+
+ Built with CHIME_MPI and run on several MPI processes, e.g.,
+
+   mpirun -np 4 relative-gen
+
+ the sectors are partitioned among the processes, each of which builds and
+ writes its share to the sector file <output_filename>.sectors, see
+ partition.h. A run with --sector-file on one process writes the same file.
+ With --compress, the blocks of the sector file are compressed. Otherwise the
+ text operator file gets the sidecar index <output_filename>.index, from
+ which chime::partition::SectorFileReader reads single sectors.
+
  Input (relative.in):
    J0 g0 T0_min T0_max
    Nmax hw
@@ -32,11 +55,24 @@
  Iowa State University
 *******************************************************************************/
 
+#ifdef CHIME_MPI
+#include <mpi.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <fstream>
 
 #include "chime.h"
+#include "instrument.h"
+#include "libchime.h"
+#include "numa.h"
 #include "mcutils/parsing.h"
-#include "relative_rme.h"
+#include "options.h"
+#include "partition.h"
+#include "plan.h"
 
 // Input parameters for relative operators.
 struct InputParameters {
@@ -117,32 +153,59 @@ InputParameters::InputParameters(std::string input_filename)
   }
 }
 
-// Populate operator.
-void PopulateOperator(
-    const InputParameters &input_params, basis::RelativeSpaceLSJT &rel_space,
-    std::array<basis::RelativeSectorsLSJT, 3> &rel_sectors,
-    std::array<basis::OperatorBlocks<double>, 3> &rel_matrices)
+// Operator request of the input parameters.
+chime::OperatorRequest MakeRequest(const InputParameters &input_params)
 {
-  std::cout << "Populating operator...\n";
-
-  // Set up relative-cm space.
-  rel_space = basis::RelativeSpaceLSJT(input_params.basis_params.Nmax,
-                                       input_params.basis_params.Jmax);
-
-  // Populate operator containers.
-  if (input_params.op_name == "mm") {
-    if (input_params.op_order == "nlo") {
-      if (input_params.op_abody == 2) {
-        chime::relative::ConstructMu2nNLOOperator(
-            input_params.basis_params, rel_space, rel_sectors, rel_matrices,
-            input_params.hbomega, input_params.R);
-      }
-    }
-  }
+  chime::OperatorRequest request;
+  request.name = input_params.op_name;
+  request.order = input_params.op_order;
+  request.abody = int(input_params.op_abody);
+  request.hbomega = input_params.hbomega;
+  request.R = input_params.R;
+  return request;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+  // Read run options first, so that a usage error exits before MPI is
+  // initialized.
+  const chime::RunOptions run_options = chime::ParseRunOptions(argc, argv);
+  if (run_options.lab_frame) {
+    std::cerr << argv[0] << ": --lab-frame applies to relativecm-gen only\n";
+    return EXIT_FAILURE;
+  }
+
+  int rank = 0;
+  int num_ranks = 1;
+#ifdef CHIME_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+#endif
+
+  // Hardware counters are inherited only by threads created after they are
+  // opened, so they are opened before any OpenMP region.
+  if (run_options.perf) {
+    if (!chime::instrument::EnablePerf()) {
+      std::cerr << "WARNING: hardware performance counters unavailable\n";
+    }
+  }
+  else if (run_options.report) {
+    chime::instrument::Enable();
+  }
+  if (run_options.trace) {
+    chime::instrument::EnableTracing();
+  }
+  if (run_options.numa) {
+    if (chime::numa::Enable(chime::numa::ReadTopology())) {
+      std::cout << "  Threads pinned to " << chime::numa::NumNodes()
+                << " NUMA nodes\n";
+    }
+    else {
+      std::cerr << "WARNING: threads could not be pinned\n";
+    }
+  }
+
   // Read parameters.
   InputParameters input_params("relative.in");
   std::cout << "  Operator " << input_params.op_name << " "
@@ -153,14 +216,80 @@ int main()
   std::cout << "  T0_min " << input_params.basis_params.T0_min << " T0_max "
             << input_params.basis_params.T0_max << "\n";
 
-  // Set up operator.
-  basis::RelativeSpaceLSJT rel_space;
-  std::array<basis::RelativeSectorsLSJT, 3> rel_sectors;
-  std::array<basis::OperatorBlocks<double>, 3> rel_matrices;
-  PopulateOperator(input_params, rel_space, rel_sectors, rel_matrices);
+  // Print the plan instead of calculating.
+  if (run_options.plan) {
+    const chime::plan::Plan plan = chime::PlanRelativeOperator(
+        input_params.basis_params, MakeRequest(input_params),
+        run_options.radial);
+    const chime::plan::Calibration calibration =
+        run_options.calibration_report.empty()
+            ? chime::plan::BenchmarkQuadrature(run_options.radial)
+            : chime::plan::ReadCalibration(run_options.calibration_report);
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    if (rank == 0) {
+      chime::plan::PrintPlan(plan, calibration, num_threads);
+    }
+#ifdef CHIME_MPI
+    MPI_Finalize();
+#endif
+    return 0;
+  }
+
+  // Populate and write operator.
+  chime::RelativeOperator op;
+  if (run_options.sector_file || (num_ranks > 1)) {
+    std::cout << "Populating share " << rank << " of " << num_ranks
+              << " of operator...\n";
+    chime::SectorOwners owners;
+    chime::ConstructRelativeOperatorShare(
+        input_params.basis_params, MakeRequest(input_params), rank, num_ranks,
+        op, owners, run_options.radial);
+
+    chime::instrument::ScopedPhase phase(chime::instrument::Phase::kWrite);
+    const std::string filename = input_params.target_filename + ".sectors";
+    const std::vector<chime::partition::SectorRecord> records =
+        chime::partition::SectorLayout(op);
+    const std::vector<const basis::OperatorBlock<double> *> blocks =
+        chime::partition::SectorBlocks(op, records);
+#ifdef CHIME_MPI
+    chime::partition::WriteSectorFile(MPI_COMM_WORLD, filename, records,
+                                      blocks, run_options.compress);
+#else
+    chime::partition::WriteSectorFile(filename, records, blocks,
+                                      run_options.compress);
+#endif
+  }
+  else {
+    std::cout << "Populating operator...\n";
+    chime::ConstructRelativeOperator(
+        input_params.basis_params, MakeRequest(input_params), op,
+        run_options.radial);
+
+    // Write operator.
+    {
+      chime::instrument::ScopedPhase phase(chime::instrument::Phase::kWrite);
+      basis::WriteRelativeOperatorLSJT(
+          input_params.target_filename, op.space, input_params.basis_params,
+          op.sectors, op.matrices, true);
+      chime::partition::IndexTextOperator(input_params.target_filename, op);
+    }
+  }
+
+  // Reports of several processes are written separately.
+  const std::string report_filename =
+      input_params.target_filename
+      + ((num_ranks > 1) ? ".rank" + std::to_string(rank) : "");
+  if (run_options.report) {
+    chime::instrument::WriteReport(report_filename + ".report.json");
+  }
+  if (run_options.trace) {
+    chime::instrument::WriteTrace(report_filename + ".trace.json");
+  }
 
-  // Write operator.
-  basis::WriteRelativeOperatorLSJT(input_params.target_filename, rel_space,
-                                   input_params.basis_params, rel_sectors,
-                                   rel_matrices, true);
+#ifdef CHIME_MPI
+  MPI_Finalize();
+#endif
 }
@@ -1,15 +1,18 @@
 #include "relative_rme.h"
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
-#include "basis_func/ho.h"
 #include "chime.h"
 #include "constants.h"
-#include "quadpp/quadpp.h"
-#include "quadpp/spline.h"
+#include "instrument.h"
+#include "lowrank.h"
+#include "numa.h"
+#include "radial.h"
 #include "tprme.h"
+#include "yukawa.h"
 
 namespace chime {
 namespace relative {
@@ -19,6 +22,225 @@ constexpr double mN = constants::nucleon_mass_fm;
 constexpr double FPi = constants::pion_decay_constant_fm;
 constexpr double gA = constants::gA;
 
+// Kernels of the radial integrals of the 2n NLO magnetic moment operator.
+enum { kZpirYpir, kTpirYpir, kNumKernels };
+
+// The rank 2 spherical harmonic couples L' and L with |L' - L| <= 2.
+constexpr int kMaxDeltaL = 2;
+
+// Maximum radial quantum number for each L in the subspaces of `rel_space`
+// selected by `subspace_mask`, or in all subspaces if it is empty.
+std::vector<int> RadialExtents(const basis::RelativeSpaceLSJT& rel_space,
+                               const std::vector<bool>& subspace_mask = {})
+{
+  std::vector<int> nmax_by_l;
+  for (std::size_t subspace_index = 0; subspace_index < rel_space.size();
+       ++subspace_index) {
+    if (!subspace_mask.empty() && !subspace_mask[subspace_index]) {
+      continue;
+    }
+    const basis::RelativeSubspaceLSJT& subspace =
+        rel_space.GetSubspace(subspace_index);
+    const int L = subspace.L();
+    if (int(nmax_by_l.size()) <= L) {
+      nmax_by_l.resize(L + 1, -1);
+    }
+    for (std::size_t index = 0; index < subspace.size(); ++index) {
+      const basis::RelativeStateLSJT state(subspace, index);
+      nmax_by_l[L] = std::max(nmax_by_l[L], state.n());
+    }
+  }
+  return nmax_by_l;
+}
+
+// Tabulates the radial integrals of the 2n NLO magnetic moment operator up
+// to the radial quantum numbers `nmax_by_l`, or loads them from the cache.
+radial::RadialIntegralTable Mu2nNLORadialIntegrals(
+    const std::vector<int>& nmax_by_l, const double& oscillator_energy,
+    const double& R, const radial::RadialParameters& radial_params)
+{
+  instrument::ScopedPhase phase(instrument::Phase::kRadialIntegrals);
+
+  const int max_delta_l = kMaxDeltaL;
+  const double brel = chime::RelativeOscillatorLength(oscillator_energy);
+
+  cache::KeyBuilder key = radial::RadialIntegralKey(radial_params, brel, R,
+                                                    max_delta_l, nmax_by_l);
+  key.Add(std::string("zpir*ypir,tpir*ypir")).Add(mPi);
+
+  // Unregulated integrals are evaluated analytically, and not cached.
+  const bool analytic = (R == 0) && radial_params.analytic;
+
+  radial::RadialIntegralTable table;
+  if (!analytic
+      && radial::LoadRadialIntegralTable(radial_params.cache, key, table)) {
+    return table;
+  }
+
+  // Radial integral kernels on the dimensionless mesh of `ho_wfs`, evaluated
+  // at r = brel rho. All radial integrals of a matrix element are evaluated
+  // together.
+  auto make_integrator = [&](const radial::WaveFunctionStore& ho_wfs) {
+    instrument::ScopedPhase phase(instrument::Phase::kKernels);
+    const Eigen::ArrayXd rho = ho_wfs.rho();
+    const Eigen::ArrayXd r = brel * rho;
+    // weights for radial integral with transformed dimensionless variable
+    const Eigen::ArrayXd wt = rho * rho * ho_wfs.jacobian();
+
+    Eigen::ArrayXd mpir = mPi * r;
+    Eigen::ArrayXd expmpir = Eigen::exp(-mpir);
+    Eigen::ArrayXd ypir = expmpir / mpir;
+    Eigen::ArrayXd zpir = (1. + mpir);
+    Eigen::ArrayXd tpir = (-1. + 2 * mpir);
+
+    // Semilocal coordinate space regulator.
+    Eigen::ArrayXd scs_reg = chime::SCSRegulator(r, R);
+
+    return radial::FusedIntegrator<kNumKernels>(
+        ho_wfs.x(), wt * scs_reg, {{zpir * ypir, tpir * ypir}},
+        radial_params.window_tolerance);
+  };
+
+  table = radial::RadialIntegralTable(kNumKernels, max_delta_l, nmax_by_l);
+  if ((radial_params.tolerance > 0) && !analytic) {
+    std::cout << "  Tabulating radial integrals adaptively...\n";
+    const radial::AccuracyReport report =
+        radial::TabulateRadialIntegralsAdaptive<kNumKernels>(
+            make_integrator, radial_params, table);
+    radial::PrintAccuracyReport(report, radial_params);
+    radial::StoreRadialIntegralTable(radial_params.cache, key, table);
+    return table;
+  }
+
+  if (analytic) {
+    // The same kernels as exp(-mr) sum_q c_q r^q.
+    std::cout << "  Evaluating radial integrals analytically...\n";
+    const std::vector<radial::YukawaKernel> yukawa_kernels{
+        {mPi, -1, {1 / mPi, 1}}, {mPi, -1, {-1 / mPi, 2}}};
+    const radial::YukawaTabulation tabulation =
+        radial::TabulateYukawaRadialIntegrals<kNumKernels>(
+            yukawa_kernels, brel, radial_params, make_integrator, table);
+    std::cout << "  " << tabulation.num_fallbacks << " of "
+              << tabulation.num_pairs
+              << " radial integral pairs evaluated by quadrature ("
+              << 100. * tabulation.num_fallbacks
+                     / std::max<std::size_t>(tabulation.num_pairs, 1)
+              << "%)\n";
+    return table;
+  }
+
+  // Universal harmonic oscillator basis functions on the dimensionless mesh.
+  const int lmax = int(nmax_by_l.size()) - 1;
+  const int nmax = *std::max_element(nmax_by_l.begin(), nmax_by_l.end());
+  const radial::WaveFunctionStore ho_wfs =
+      radial::WaveFunctionStore::Open(radial_params, nmax, lmax);
+  std::cout << "  Generating integral kernels...\n";
+  const radial::FusedIntegrator<kNumKernels> integrator =
+      make_integrator(ho_wfs);
+
+  std::cout << "  Tabulating radial integrals...\n";
+  radial::PrintTabulationStatistics(radial::TabulateRadialIntegrals(
+      integrator, ho_wfs, table, radial_params.screening_threshold));
+  radial::StoreRadialIntegralTable(radial_params.cache, key, table);
+  return table;
+}
+
+// Checks the selection rules of the 2n NLO magnetic moment operator between
+// two subspaces, beyond those of the J0 = 1, T0 = 1, g0 = 0 sectors.
+bool Mu2nNLOAllowed(const basis::RelativeSubspaceLSJT& bra_subspace,
+                    const basis::RelativeSubspaceLSJT& ket_subspace,
+                    const radial::RadialIntegrals& radial_integrals)
+{
+  return (bra_subspace.T() != ket_subspace.T())
+         && (bra_subspace.S() != ket_subspace.S())
+         && radial_integrals.HasBlock(bra_subspace.L(), ket_subspace.L());
+}
+
+// Spin, isospin and coupling factors of the 2n NLO magnetic moment operator
+// between two allowed subspaces, which only depend on the subspace labels,
+// of the zpir*ypir and tpir*ypir integrals.
+struct Mu2nNLOFactors {
+  double f;
+  double g;
+};
+
+Mu2nNLOFactors Mu2nNLOAngularFactors(
+    const basis::RelativeSubspaceLSJT& bra_subspace,
+    const basis::RelativeSubspaceLSJT& ket_subspace)
+{
+  double prefactor = tp::SpinTensorProductRME<1>(bra_subspace.T(),
+                                                 ket_subspace.T());  // Isospin.
+  prefactor *= -(mN * mPi * gA * gA) / (24 * constants::pi * FPi * FPi);
+
+  Mu2nNLOFactors factors;
+  factors.f = tp::CSpinTensorProductRME<2, 1, 1>(bra_subspace, ket_subspace);
+  factors.f *= std::sqrt(10.) * prefactor;
+
+  // Rank 0 spherical harmonic.
+  factors.g = 0;
+  if (bra_subspace.L() == ket_subspace.L()) {
+    factors.g = tp::CSpinTensorProductRME<0, 1, 1>(bra_subspace, ket_subspace);
+    factors.g *= prefactor;
+  }
+  return factors;
+}
+
+// Reduced matrix element between the states with radial quantum numbers n'
+// and n of two allowed subspaces with orbital angular momenta L' and L.
+double Mu2nNLORME(const Mu2nNLOFactors& factors, const int& bra_L,
+                  const int& bra_n, const int& ket_L, const int& ket_n,
+                  const radial::RadialIntegrals& radial_integrals)
+{
+  double rme =
+      factors.f * radial_integrals(kZpirYpir, bra_L, bra_n, ket_L, ket_n);
+  if (bra_L == ket_L) {
+    rme += factors.g * radial_integrals(kTpirYpir, bra_L, bra_n, ket_L, ket_n);
+  }
+  return rme;
+}
+
+// Calculates the reduced matrix elements of the 2n NLO magnetic moment
+// operator between two allowed subspaces. The angular factors are evaluated
+// once per block.
+void Mu2nNLOBlock(const basis::RelativeSubspaceLSJT& bra_subspace,
+                  const basis::RelativeSubspaceLSJT& ket_subspace,
+                  const radial::RadialIntegrals& radial_integrals,
+                  basis::OperatorBlock<double>& matrix)
+{
+  // Extract subspace labels.
+  const int bra_L = bra_subspace.L();
+  const int ket_L = ket_subspace.L();
+  const Mu2nNLOFactors factors =
+      Mu2nNLOAngularFactors(bra_subspace, ket_subspace);
+
+  // Loop over bra and ket states.
+  const std::size_t bra_subspace_size = bra_subspace.size();
+  const std::size_t ket_subspace_size = ket_subspace.size();
+  matrix.resize(bra_subspace_size, ket_subspace_size);
+#pragma omp parallel
+  {
+    // Share of this thread, traced without the closing barrier. Kets are
+    // outermost, so that each thread fills, and first touches, a contiguous
+    // share of the column-major block.
+    instrument::TraceSpan span("chunk");
+    std::size_t pairs = 0;
+#pragma omp for collapse(2) schedule(static) nowait
+    for (std::size_t ket_index = 0; ket_index < ket_subspace_size;
+         ++ket_index) {
+      for (std::size_t bra_index = 0; bra_index < bra_subspace_size;
+           ++bra_index) {
+        const basis::RelativeStateLSJT bra_state(bra_subspace, bra_index);
+        const basis::RelativeStateLSJT ket_state(ket_subspace, ket_index);
+        matrix(bra_index, ket_index) =
+            Mu2nNLORME(factors, bra_L, bra_state.n(), ket_L, ket_state.n(),
+                       radial_integrals);
+        ++pairs;
+      }
+    }
+    instrument::Count(instrument::Counter::kStatePairs, pairs);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //////////////// Magnetic moment (2n NLO) matrix element //////////////////
 ///////////////////////////////////////////////////////////////////////////
@@ -28,7 +250,8 @@ void ConstructMu2nNLOOperator(
     const basis::RelativeSpaceLSJT& rel_space,
     std::array<basis::RelativeSectorsLSJT, 3>& rel_sectors,
     std::array<basis::OperatorBlocks<double>, 3>& rel_matrices,
-    const double& oscillator_energy, const double& R)
+    const double& oscillator_energy, const double& R,
+    const radial::RadialParameters& radial_params)
 {
   std::cout << " Constructing M1 operator...\n";
   assert(op_params.J0 == 1);
@@ -38,38 +261,28 @@ void ConstructMu2nNLOOperator(
   // Alias isospin rank.
   int T0 = op_params.T0_min;
 
-  // Generate required harmonic oscillator basis functions, and radial
-  // integral weights.
-  int Nmax = op_params.Nmax;
-
-  int npts = 3001;
-  const double low = 0, high = 1;
-  Eigen::ArrayXd x, r, jac, wt;
-  quadpp::SemiInfiniteIntegralMesh(npts, low, high, x, r, jac);
-  wt = r * r * jac;  // weights for radial integral with transformed variable
-
-  std::cout << "  Generating basis functions...\n";
-  std::vector<Eigen::ArrayXXd> ho_wfs;
-  double brel = chime::RelativeOscillatorLength(oscillator_energy);
-  basis_func::ho::WaveFunctionsUptoMaxL(ho_wfs, r, Nmax, Nmax, brel,
-                                        basis_func::Space::coordinate);
-
-  // Radial integral kernels.
-  std::cout << "  Generating integral kernels...\n";
-  Eigen::ArrayXd mpir = mPi * r;
-  Eigen::ArrayXd expmpir = Eigen::exp(-mpir);
-  Eigen::ArrayXd ypir = expmpir / mpir;
-  Eigen::ArrayXd zpir = (1. + mpir);
-  Eigen::ArrayXd tpir = (-1. + 2 * mpir);
-
-  // Semilocal coordinate space regulator.
-  Eigen::ArrayXd scs_reg =
-      r.unaryExpr([&R](double rs) { return chime::SCSRegulator(rs, R); });
+  // Radial integrals.
+  const radial::RadialIntegrals radial_integrals =
+      radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(rel_space), oscillator_energy,
+                                 R, radial_params),
+          radial_params, {"zpir*ypir", "tpir*ypir"});
 
   // Zero initialize operator.
   std::cout << "  Zero initializing operator...\n";
-  basis::ConstructZeroOperatorRelativeLSJT(op_params, rel_space, rel_sectors,
-                                           rel_matrices);
+  {
+    instrument::ScopedPhase phase(instrument::Phase::kZeroInit);
+    for (int T = op_params.T0_min; T <= op_params.T0_max; ++T) {
+      rel_sectors[T] = basis::RelativeSectorsLSJT(rel_space, op_params.J0, T,
+                                                  op_params.g0);
+      if (numa::Enabled()) {
+        numa::SetOperatorToZero(rel_sectors[T], rel_matrices[T]);
+      }
+      else {
+        basis::SetOperatorToZero(rel_sectors[T], rel_matrices[T]);
+      }
+    }
+  }
 
   // Select T0 component.
   const basis::RelativeSectorsLSJT& sectors = rel_sectors[T0];
@@ -77,83 +290,166 @@ void ConstructMu2nNLOOperator(
 
   // Reduced matrix element calculation.
   std::cout << "  Starting matrix element calculation...\n";
+  instrument::ScopedPhase phase(instrument::Phase::kSectorLoop);
   for (std::size_t sector_index = 0; sector_index < sectors.size();
        ++sector_index) {
+    instrument::TraceSpan span("sector", sector_index);
     const basis::RelativeSectorsLSJT::SectorType& sector =
         sectors.GetSector(sector_index);
-    const basis::RelativeSubspaceLSJT& bra_subspace = sector.bra_subspace();
-    const basis::RelativeSubspaceLSJT& ket_subspace = sector.ket_subspace();
-
-    // Alias for matrix.
-    basis::OperatorBlock<double>& matrix = matrices[sector_index];
-
-    // Extract subspace labels.
-    int bra_L = bra_subspace.L();
-    int bra_S = bra_subspace.S();
-    int bra_J = bra_subspace.J();
-    int bra_T = bra_subspace.T();
-    int ket_L = ket_subspace.L();
-    int ket_S = ket_subspace.S();
-    int ket_J = ket_subspace.J();
-    int ket_T = ket_subspace.T();
-
-    if ((bra_T == ket_T) || (bra_S == ket_S)) {
-      continue;
+    if (Mu2nNLOAllowed(sector.bra_subspace(), sector.ket_subspace(),
+                       radial_integrals)) {
+      Mu2nNLOBlock(sector.bra_subspace(), sector.ket_subspace(),
+                   radial_integrals, matrices[sector_index]);
+      instrument::Count(instrument::Counter::kSectorsVisited);
     }
+    else {
+      instrument::Count(instrument::Counter::kSectorsSkipped);
+    }
+  }
+}
 
-    // Loop over bra and ket states.
-    const std::size_t bra_subspace_size = bra_subspace.size();
-    const std::size_t ket_subspace_size = ket_subspace.size();
-#pragma omp parallel for collapse(2)
-    for (std::size_t bra_index = 0; bra_index < bra_subspace_size;
-         ++bra_index) {
-      for (std::size_t ket_index = 0; ket_index < ket_subspace_size;
-           ++ket_index) {
-        const basis::RelativeStateLSJT bra_state(bra_subspace, bra_index);
-        const basis::RelativeStateLSJT ket_state(ket_subspace, ket_index);
-
-        // Extract state labels.
-        int bra_n = bra_state.n();
-        int ket_n = ket_state.n();
-
-        // Common part of all radial integrals.
-        Eigen::ArrayXd common_integrand = wt * scs_reg;
-        common_integrand *=
-            (ho_wfs.at(bra_L).row(bra_n) * ho_wfs.at(ket_L).row(ket_n));
+radial::RadialTableShape Mu2nNLORadialTableShape(
+    const basis::RelativeSpaceLSJT& rel_space)
+{
+  return {kNumKernels, kMaxDeltaL, RadialExtents(rel_space)};
+}
 
-        // Reduced matrix element calculation.
-        double rme = 0;
+double Mu2nNLOSectorCost(const basis::RelativeSectorsLSJT::SectorType& sector)
+{
+  const basis::RelativeSubspaceLSJT& bra_subspace = sector.bra_subspace();
+  const basis::RelativeSubspaceLSJT& ket_subspace = sector.ket_subspace();
+  if ((bra_subspace.T() == ket_subspace.T())
+      || (bra_subspace.S() == ket_subspace.S())
+      || (std::abs(bra_subspace.L() - ket_subspace.L()) > 2)) {
+    return 0;
+  }
+  return double(bra_subspace.size()) * ket_subspace.size();
+}
 
-        double tp_f =
-            tp::CSpinTensorProductRME(bra_subspace, ket_subspace, 2, 1, 1);
-        tp_f *= std::sqrt(10.);
+void ConstructMu2nNLOSectors(const basis::RelativeSpaceLSJT& rel_space,
+                             const basis::RelativeSectorsLSJT& sectors,
+                             const std::vector<std::size_t>& sector_indices,
+                             basis::OperatorBlocks<double>& matrices,
+                             const double& oscillator_energy, const double& R,
+                             const radial::RadialParameters& radial_params)
+{
+  matrices.assign(sectors.size(), basis::OperatorBlock<double>());
+  if (sector_indices.empty()) {
+    return;
+  }
 
-        Eigen::ArrayXd y = common_integrand * zpir * ypir;
-        y.head(1) = 0;  // Required to avoid divide by 0.
-        y.tail(1) = 0;  // Required to avoid divide by 0.
-        double integ_zpir_ypir = quadpp::spline::Integrate(x, y);
+  // Radial integrals of the subspaces of the selected sectors.
+  std::vector<bool> subspace_mask(rel_space.size(), false);
+  for (const std::size_t sector_index : sector_indices) {
+    const basis::RelativeSectorsLSJT::SectorType& sector =
+        sectors.GetSector(sector_index);
+    subspace_mask[sector.bra_subspace_index()] = true;
+    subspace_mask[sector.ket_subspace_index()] = true;
+  }
+  const radial::RadialIntegrals radial_integrals =
+      radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(rel_space, subspace_mask),
+                                 oscillator_energy, R, radial_params),
+          radial_params, {"zpir*ypir", "tpir*ypir"});
 
-        rme = tp_f * integ_zpir_ypir;
+  // Reduced matrix element calculation.
+  instrument::ScopedPhase phase(instrument::Phase::kSectorLoop);
+  for (const std::size_t sector_index : sector_indices) {
+    instrument::TraceSpan span("sector", sector_index);
+    const basis::RelativeSectorsLSJT::SectorType& sector =
+        sectors.GetSector(sector_index);
+    if (Mu2nNLOAllowed(sector.bra_subspace(), sector.ket_subspace(),
+                       radial_integrals)) {
+      Mu2nNLOBlock(sector.bra_subspace(), sector.ket_subspace(),
+                   radial_integrals, matrices[sector_index]);
+      instrument::Count(instrument::Counter::kSectorsVisited);
+    }
+    else {
+      matrices[sector_index].setZero(sector.bra_subspace().size(),
+                                     sector.ket_subspace().size());
+      instrument::Count(instrument::Counter::kSectorsSkipped);
+    }
+  }
+}
 
-        if (bra_L == ket_L) {
-          double tp_g =
-              tp::CSpinTensorProductRME(bra_subspace, ket_subspace, 0, 1, 1);
+Mu2nNLOOperator::Mu2nNLOOperator(const basis::RelativeSpaceLSJT& rel_space,
+                                 const double& oscillator_energy,
+                                 const double& R,
+                                 const radial::RadialParameters& radial_params)
+    : sectors_(rel_space, 1, 1, 0, basis::SectorDirection::kBoth),
+      radial_integrals_(radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(rel_space), oscillator_energy,
+                                 R, radial_params),
+          radial_params, {"zpir*ypir", "tpir*ypir"})),
+      dimension_(0)
+{
+  for (std::size_t subspace_index = 0; subspace_index < rel_space.size();
+       ++subspace_index) {
+    offsets_.push_back(dimension_);
+    dimension_ += rel_space.GetSubspace(subspace_index).size();
+  }
 
-          y = common_integrand * tpir * ypir;
-          y.head(1) = 0;  // Required to avoid divide by 0.
-          y.tail(1) = 0;  // Required to avoid divide by 0.
-          double integ_tpir_ypir = quadpp::spline::Integrate(x, y);
+  sectors_by_bra_.resize(rel_space.size());
+  for (std::size_t sector_index = 0; sector_index < sectors_.size();
+       ++sector_index) {
+    const basis::RelativeSectorsLSJT::SectorType& sector =
+        sectors_.GetSector(sector_index);
+    if (Mu2nNLOAllowed(sector.bra_subspace(), sector.ket_subspace(),
+                       radial_integrals_)) {
+      const Mu2nNLOFactors factors =
+          Mu2nNLOAngularFactors(sector.bra_subspace(), sector.ket_subspace());
+      sectors_by_bra_[sector.bra_subspace_index()].push_back(
+          {sector_index, factors.f, factors.g});
+    }
+  }
+}
 
-          rme += tp_g * integ_tpir_ypir;
-        }
+void Mu2nNLOOperator::ApplySector(const SectorFactors& sector_factors,
+                                  const Eigen::VectorXd& x,
+                                  Eigen::VectorXd& y) const
+{
+  const basis::RelativeSectorsLSJT::SectorType& sector =
+      sectors_.GetSector(sector_factors.sector_index);
+  const basis::RelativeSubspaceLSJT& bra_subspace = sector.bra_subspace();
+  const basis::RelativeSubspaceLSJT& ket_subspace = sector.ket_subspace();
+  const int bra_L = bra_subspace.L();
+  const int ket_L = ket_subspace.L();
+  const Mu2nNLOFactors factors{sector_factors.f, sector_factors.g};
+  const std::size_t bra_offset = offsets_[sector.bra_subspace_index()];
+  const std::size_t ket_offset = offsets_[sector.ket_subspace_index()];
+  for (std::size_t ket_index = 0; ket_index < ket_subspace.size();
+       ++ket_index) {
+    const int ket_n = basis::RelativeStateLSJT(ket_subspace, ket_index).n();
+    const double amplitude = x(ket_offset + ket_index);
+    for (std::size_t bra_index = 0; bra_index < bra_subspace.size();
+         ++bra_index) {
+      const int bra_n = basis::RelativeStateLSJT(bra_subspace, bra_index).n();
+      y(bra_offset + bra_index) +=
+          Mu2nNLORME(factors, bra_L, bra_n, ket_L, ket_n, radial_integrals_)
+          * amplitude;
+    }
+  }
+  instrument::Count(instrument::Counter::kStatePairs,
+                    bra_subspace.size() * ket_subspace.size());
+}
 
-        rme *= tp::SpinTensorProductRME(bra_T, ket_T, 1);  // Isospin.
-        rme *= -(mN * mPi * gA * gA) / (24 * constants::pi * FPi * FPi);
+Eigen::VectorXd Mu2nNLOOperator::Apply(const Eigen::VectorXd& x) const
+{
+  assert(std::size_t(x.size()) == dimension_);
+  Eigen::VectorXd y = Eigen::VectorXd::Zero(dimension_);
 
-        matrix(bra_n, ket_n) = rme;
-      }
+  // Each bra subspace is a disjoint segment of the result, so that threads
+  // never accumulate into the same entries. The sectors are applied
+  // serially within a thread.
+#pragma omp parallel for schedule(dynamic)
+  for (std::size_t bra_index = 0; bra_index < sectors_by_bra_.size();
+       ++bra_index) {
+    instrument::TraceSpan span("apply", bra_index);
+    for (const SectorFactors& sector_factors : sectors_by_bra_[bra_index]) {
+      ApplySector(sector_factors, x, y);
     }
   }
+  return y;
 }
 
 }  // namespace relative
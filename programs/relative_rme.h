@@ -1,9 +1,13 @@
 #ifndef RELATIVE_RME_H_
 #define RELATIVE_RME_H_
 
+#include <Eigen/Dense>
 #include <array>
+#include <vector>
 
 #include "basis/lsjt_operator.h"
+#include "lowrank.h"
+#include "radial.h"
 
 namespace chime {
 namespace relative {
@@ -13,7 +17,78 @@ void ConstructMu2nNLOOperator(
     const basis::RelativeSpaceLSJT& rel_space,
     std::array<basis::RelativeSectorsLSJT, 3>& rel_sectors,
     std::array<basis::OperatorBlocks<double>, 3>& rel_matrices,
-    const double& oscillator_energy, const double& R);
+    const double& oscillator_energy, const double& R,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Shape of the radial integral table of the 2n NLO magnetic moment operator
+// on `rel_space`.
+radial::RadialTableShape Mu2nNLORadialTableShape(
+    const basis::RelativeSpaceLSJT& rel_space);
+
+// Estimated cost of calculating the block of `sector` of the 2n NLO magnetic
+// moment operator, in reduced matrix elements, or 0 if the block vanishes by
+// the selection rules.
+double Mu2nNLOSectorCost(const basis::RelativeSectorsLSJT::SectorType& sector);
+
+// Calculates the blocks of the 2n NLO magnetic moment operator of the sectors
+// `sector_indices` of `sectors`, its T0 = 1 sectors, and leaves the other
+// blocks empty. Only the radial integrals between the subspaces of these
+// sectors are tabulated, so that a share of the sectors costs a share of the
+// work and memory.
+void ConstructMu2nNLOSectors(
+    const basis::RelativeSpaceLSJT& rel_space,
+    const basis::RelativeSectorsLSJT& sectors,
+    const std::vector<std::size_t>& sector_indices,
+    basis::OperatorBlocks<double>& matrices, const double& oscillator_energy,
+    const double& R,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// 2n NLO magnetic moment operator, applied to vectors of the relative space
+// without storing its matrix.
+//
+// A vector holds one amplitude per state of the space, subspace by subspace
+// in the order of the space. The result is in the same space, with the
+// reduced matrix elements <bra||mu||ket> in place of the matrix elements.
+// Only the radial integrals and the angular factors of each sector are kept;
+// the reduced matrix elements are recalculated on each application, in
+// parallel over the bra subspaces.
+class Mu2nNLOOperator {
+ public:
+  Mu2nNLOOperator(
+      const basis::RelativeSpaceLSJT& rel_space,
+      const double& oscillator_energy, const double& R,
+      const radial::RadialParameters& radial_params =
+          radial::RadialParameters());
+
+  // Number of states of the space.
+  std::size_t dimension() const { return dimension_; }
+
+  Eigen::VectorXd Apply(const Eigen::VectorXd& x) const;
+
+ private:
+  // Allowed sector with its spin, isospin and coupling factors of the
+  // zpir*ypir and tpir*ypir integrals.
+  struct SectorFactors {
+    std::size_t sector_index;
+    double f;
+    double g;
+  };
+
+  // Adds the block of a sector times `x` to `y`, serially.
+  void ApplySector(const SectorFactors& sector_factors,
+                   const Eigen::VectorXd& x, Eigen::VectorXd& y) const;
+
+  // Sectors in both directions; only the allowed sectors are listed for
+  // each bra subspace.
+  basis::RelativeSectorsLSJT sectors_;
+  std::vector<std::vector<SectorFactors>> sectors_by_bra_;
+
+  radial::RadialIntegrals radial_integrals_;
+
+  // Offsets of the subspaces in a vector.
+  std::vector<std::size_t> offsets_;
+  std::size_t dimension_;
+};
 
 }  // namespace relative
 }  // namespace chime
@@ -1,15 +1,20 @@
 #include "relativecm_rme.h"
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <cmath>
+#include <map>
+#include <utility>
 #include <vector>
 
-#include "basis_func/ho.h"
 #include "chime.h"
 #include "constants.h"
-#include "quadpp/quadpp.h"
-#include "quadpp/spline.h"
+#include "instrument.h"
+#include "lowrank.h"
+#include "numa.h"
+#include "radial.h"
 #include "tprme.h"
+#include "yukawa.h"
 
 namespace chime {
 namespace relcm {
@@ -19,12 +24,327 @@ constexpr double mN = constants::nucleon_mass_fm;
 constexpr double FPi = constants::pion_decay_constant_fm;
 constexpr double gA = constants::gA;
 
+// Kernels of the relative radial integrals of the 2n NLO magnetic moment
+// operator.
+enum { kExpmpir, kExpmpirWpir, kZpirYpir, kTpirYpir, kNumKernels };
+
+// The rank 3 relative spherical harmonic couples lr' and lr with
+// |lr' - lr| <= 3.
+constexpr int kMaxDeltaL = 3;
+
+// Maximum relative radial quantum number for each lr in the subspaces of
+// `relcm_space` selected by `subspace_mask`, or in all subspaces if it is
+// empty.
+std::vector<int> RadialExtents(const basis::RelativeCMSpaceLSJT& relcm_space,
+                               const std::vector<bool>& subspace_mask = {})
+{
+  std::vector<int> nmax_by_l;
+  for (std::size_t subspace_index = 0; subspace_index < relcm_space.size();
+       ++subspace_index) {
+    if (!subspace_mask.empty() && !subspace_mask[subspace_index]) {
+      continue;
+    }
+    const basis::RelativeCMSubspaceLSJT& subspace =
+        relcm_space.GetSubspace(subspace_index);
+    for (std::size_t index = 0; index < subspace.size(); ++index) {
+      const basis::RelativeCMStateLSJT state(subspace, index);
+      const int lr = state.lr();
+      if (int(nmax_by_l.size()) <= lr) {
+        nmax_by_l.resize(lr + 1, -1);
+      }
+      nmax_by_l[lr] = std::max(nmax_by_l[lr], state.Nr());
+    }
+  }
+  return nmax_by_l;
+}
+
+// Tabulates the relative radial integrals of the 2n NLO magnetic moment
+// operator up to the radial quantum numbers `nmax_by_l`, or loads them from
+// the cache.
+radial::RadialIntegralTable Mu2nNLORadialIntegrals(
+    const std::vector<int>& nmax_by_l, const double& oscillator_energy,
+    const double& R, const radial::RadialParameters& radial_params)
+{
+  instrument::ScopedPhase phase(instrument::Phase::kRadialIntegrals);
+
+  const int max_delta_l = kMaxDeltaL;
+  const double brel = chime::RelativeOscillatorLength(oscillator_energy);
+
+  cache::KeyBuilder key = radial::RadialIntegralKey(radial_params, brel, R,
+                                                    max_delta_l, nmax_by_l);
+  key.Add(std::string("expmpir,expmpir*wpir,zpir*ypir,tpir*ypir")).Add(mPi);
+
+  // Unregulated integrals are evaluated analytically, and not cached.
+  const bool analytic = (R == 0) && radial_params.analytic;
+
+  radial::RadialIntegralTable table;
+  if (!analytic
+      && radial::LoadRadialIntegralTable(radial_params.cache, key, table)) {
+    return table;
+  }
+
+  // Relative radial integral kernels on the dimensionless mesh of `ho_wfs`,
+  // evaluated at r = brel rho. All radial integrals of a matrix element are
+  // evaluated together.
+  auto make_integrator = [&](const radial::WaveFunctionStore& ho_wfs) {
+    instrument::ScopedPhase phase(instrument::Phase::kKernels);
+    const Eigen::ArrayXd rho = ho_wfs.rho();
+    const Eigen::ArrayXd r = brel * rho;
+    // weights for radial integral with transformed dimensionless variable
+    const Eigen::ArrayXd wt = rho * rho * ho_wfs.jacobian();
+
+    Eigen::ArrayXd mpir = mPi * r;
+    Eigen::ArrayXd expmpir = Eigen::exp(-mpir);
+    Eigen::ArrayXd ypir = expmpir / mpir;
+    Eigen::ArrayXd zpir = (1. + mpir);
+    Eigen::ArrayXd tpir = (-1. + 2 * mpir);
+    Eigen::ArrayXd wpir = (1. + (3 * zpir / mpir.square()));
+
+    // Semilocal coordinate space regulator.
+    Eigen::ArrayXd scs_reg = chime::SCSRegulator(r, R);
+
+    return radial::FusedIntegrator<kNumKernels>(
+        ho_wfs.x(), wt * scs_reg,
+        {{expmpir, expmpir * wpir, zpir * ypir, tpir * ypir}},
+        radial_params.window_tolerance);
+  };
+
+  table = radial::RadialIntegralTable(kNumKernels, max_delta_l, nmax_by_l);
+  if ((radial_params.tolerance > 0) && !analytic) {
+    std::cout << "  Tabulating radial integrals adaptively...\n";
+    const radial::AccuracyReport report =
+        radial::TabulateRadialIntegralsAdaptive<kNumKernels>(
+            make_integrator, radial_params, table);
+    radial::PrintAccuracyReport(report, radial_params);
+    radial::StoreRadialIntegralTable(radial_params.cache, key, table);
+    return table;
+  }
+
+  if (analytic) {
+    // The same kernels as exp(-mr) sum_q c_q r^q.
+    std::cout << "  Evaluating radial integrals analytically...\n";
+    const std::vector<radial::YukawaKernel> yukawa_kernels{
+        {mPi, 0, {1}},
+        {mPi, -2, {3 / (mPi * mPi), 3 / mPi, 1}},
+        {mPi, -1, {1 / mPi, 1}},
+        {mPi, -1, {-1 / mPi, 2}}};
+    const radial::YukawaTabulation tabulation =
+        radial::TabulateYukawaRadialIntegrals<kNumKernels>(
+            yukawa_kernels, brel, radial_params, make_integrator, table);
+    std::cout << "  " << tabulation.num_fallbacks << " of "
+              << tabulation.num_pairs
+              << " radial integral pairs evaluated by quadrature ("
+              << 100. * tabulation.num_fallbacks
+                     / std::max<std::size_t>(tabulation.num_pairs, 1)
+              << "%)\n";
+    return table;
+  }
+
+  // Universal harmonic oscillator basis functions on the dimensionless mesh.
+  const int lmax = int(nmax_by_l.size()) - 1;
+  const int nmax = *std::max_element(nmax_by_l.begin(), nmax_by_l.end());
+  const radial::WaveFunctionStore ho_wfs =
+      radial::WaveFunctionStore::Open(radial_params, nmax, lmax);
+  std::cout << "  Generating integration kernels...\n";
+  const radial::FusedIntegrator<kNumKernels> integrator =
+      make_integrator(ho_wfs);
+
+  std::cout << "  Tabulating radial integrals...\n";
+  radial::PrintTabulationStatistics(radial::TabulateRadialIntegrals(
+      integrator, ho_wfs, table, radial_params.screening_threshold));
+  radial::StoreRadialIntegralTable(radial_params.cache, key, table);
+  return table;
+}
+
+// Checks the selection rules of the 2n NLO magnetic moment operator between
+// two subspaces, beyond those of the J0 = 1, T0 = 1, g0 = 0 sectors.
+bool Mu2nNLOAllowed(const basis::RelativeCMSubspaceLSJT& bra_subspace,
+                    const basis::RelativeCMSubspaceLSJT& ket_subspace)
+{
+  return bra_subspace.T() != ket_subspace.T();
+}
+
+// Spin, isospin and coupling factors of the 2n NLO magnetic moment operator
+// between two states of an allowed sector, which only depend on their
+// orbital angular momenta (lr, lc) and the subspace labels. Between equal
+// spins, `first` and `second` multiply the expmpir and expmpir*wpir
+// integrals, and between different spins the zpir*ypir and tpir*ypir
+// integrals.
+struct Mu2nNLOFactors {
+  double first = 0;
+  double second = 0;
+};
+
+Mu2nNLOFactors Mu2nNLOAngularFactors(
+    const basis::RelativeCMStateLSJT& bra_state,
+    const basis::RelativeCMStateLSJT& ket_state)
+{
+  // Isospin and coupling factors.
+  double prefactor =
+      tp::SpinTensorProductRME<1>(bra_state.T(), ket_state.T());
+  prefactor *= -(mN * mPi * gA * gA) / (24 * constants::pi * FPi * FPi);
+
+  // Pauli matrix tensor product in spin space enforces the bra and ket spins
+  // to be the same for the relative-cm part, and to be different for the
+  // purely relative part.
+  Mu2nNLOFactors factors;
+  if (bra_state.S() == ket_state.S()) {
+    // Relative-cm part.
+    double tp_a =
+        tp::CCSpinTensorProductRME<1, 1, 1, 0, 1>(bra_state, ket_state);
+    tp_a *= -std::sqrt(3.);
+    factors.first = tp_a * prefactor;
+
+    if (bra_state.S() == 1) {
+      // Rank 2 Pauli Matrix tensor product.
+      double tp_b =
+          tp::CCSpinTensorProductRME<1, 1, 1, 2, 1>(bra_state, ket_state);
+      tp_b *= std::sqrt(3. / 5.);
+
+      double tp_c =
+          tp::CCSpinTensorProductRME<1, 1, 2, 2, 1>(bra_state, ket_state);
+      tp_c *= std::sqrt(9. / 5.);
+
+      double tp_d =
+          tp::CCSpinTensorProductRME<3, 1, 2, 2, 1>(bra_state, ket_state);
+      tp_d *= std::sqrt(14. / 5.);
+
+      double tp_e =
+          tp::CCSpinTensorProductRME<3, 1, 3, 2, 1>(bra_state, ket_state);
+      tp_e *= std::sqrt(28. / 5.);
+
+      factors.second = (tp_b + tp_c + tp_d + tp_e) * prefactor;
+    }
+  }
+  else if (bra_state.lc() == ket_state.lc()) {
+    // Purely relative part.
+    double tp_f =
+        tp::CCSpinTensorProductRME<2, 0, 2, 1, 1>(bra_state, ket_state);
+    tp_f *= std::sqrt(10.);
+    factors.first = tp_f * prefactor;
+
+    if (bra_state.lr() == ket_state.lr()) {
+      // Rank 0 spherical harmonic.
+      factors.second =
+          tp::CCSpinTensorProductRME<0, 0, 0, 1, 1>(bra_state, ket_state)
+          * prefactor;
+    }
+  }
+  return factors;
+}
+
+// Labels of a relative-cm state entering the reduced matrix elements.
+struct Mu2nNLOLabels {
+  int nr, lr, nc, lc;
+};
+
+Mu2nNLOLabels Labels(const basis::RelativeCMStateLSJT& state)
+{
+  return {state.Nr(), state.lr(), state.Nc(), state.lc()};
+}
+
+// Reduced matrix element between two states of an allowed sector, with
+// spins S' and S, angular factors `factors` and CM oscillator length `bcm`.
+double Mu2nNLORME(const Mu2nNLOFactors& factors, const int& bra_S,
+                  const Mu2nNLOLabels& bra, const int& ket_S,
+                  const Mu2nNLOLabels& ket,
+                  const radial::RadialIntegrals& radial_integrals,
+                  const double& bcm)
+{
+  if ((factors.first == 0) && (factors.second == 0)) {
+    return 0;
+  }
+
+  // Relative radial integrals. Vanishing spherical harmonic reduced matrix
+  // elements take care of |lr' - lr| outside the table.
+  if (!radial_integrals.HasBlock(bra.lr, ket.lr)) {
+    return 0;
+  }
+
+  if (bra_S == ket_S) {
+    // Relative-cm part.
+    double rme =
+        factors.first * radial_integrals(kExpmpir, bra.lr, bra.nr, ket.lr,
+                                         ket.nr);
+    if (factors.second != 0) {
+      rme += factors.second * radial_integrals(kExpmpirWpir, bra.lr, bra.nr,
+                                               ket.lr, ket.nr);
+    }
+
+    double integ_cm = 0;  // CM coordinate integral; analytical result.
+    if (bra.lc == ket.lc + 1) {
+      integ_cm = ((std::sqrt(ket.nc + ket.lc + 1.5) * (bra.nc == ket.nc))
+                  + (std::sqrt(ket.nc) * (bra.nc + 1 == ket.nc)));
+    }
+    else if (bra.lc + 1 == ket.lc) {
+      integ_cm = ((std::sqrt(bra.nc + ket.nc + 1.5)) * (bra.nc == ket.nc)
+                  + (std::sqrt(bra.nc) * (bra.nc == ket.nc + 1)));
+    }
+    return rme * integ_cm * mPi * bcm;
+  }
+
+  // Purely relative part. The cm labels for the bra and ket must be the
+  // same.
+  if ((bra.nc != ket.nc) || (bra.lc != ket.lc)) {
+    return 0;
+  }
+  double rme =
+      factors.first * radial_integrals(kZpirYpir, bra.lr, bra.nr, ket.lr,
+                                       ket.nr);
+  if (bra.lr == ket.lr) {
+    rme += factors.second * radial_integrals(kTpirYpir, bra.lr, bra.nr,
+                                             ket.lr, ket.nr);
+  }
+  return rme;
+}
+
+// Calculates the reduced matrix elements of the 2n NLO magnetic moment
+// operator between two allowed subspaces, with CM oscillator length `bcm`.
+void Mu2nNLOBlock(const basis::RelativeCMSubspaceLSJT& bra_subspace,
+                  const basis::RelativeCMSubspaceLSJT& ket_subspace,
+                  const radial::RadialIntegrals& radial_integrals,
+                  const double& bcm, basis::OperatorBlock<double>& matrix)
+{
+  // Extract subspace labels.
+  const int bra_S = bra_subspace.S();
+  const int ket_S = ket_subspace.S();
+
+  // Loop over bra and ket states.
+  const std::size_t bra_subspace_size = bra_subspace.size();
+  const std::size_t ket_subspace_size = ket_subspace.size();
+  matrix.resize(bra_subspace_size, ket_subspace_size);
+#pragma omp parallel
+  {
+    // Share of this thread, traced without the closing barrier. Kets are
+    // outermost, so that each thread fills, and first touches, a contiguous
+    // share of the column-major block.
+    instrument::TraceSpan span("chunk");
+    std::size_t pairs = 0;
+#pragma omp for collapse(2) schedule(static) nowait
+    for (std::size_t ket_index = 0; ket_index < ket_subspace_size;
+         ++ket_index) {
+      for (std::size_t bra_index = 0; bra_index < bra_subspace_size;
+           ++bra_index) {
+        const basis::RelativeCMStateLSJT bra_state(bra_subspace, bra_index);
+        const basis::RelativeCMStateLSJT ket_state(ket_subspace, ket_index);
+        matrix(bra_index, ket_index) =
+            Mu2nNLORME(Mu2nNLOAngularFactors(bra_state, ket_state), bra_S,
+                       Labels(bra_state), ket_S, Labels(ket_state),
+                       radial_integrals, bcm);
+        ++pairs;
+      }
+    }
+    instrument::Count(instrument::Counter::kStatePairs, pairs);
+  }
+}
+
 void ConstructMu2nNLOOperator(
     const basis::RelativeCMOperatorParametersLSJT& op_params,
     const basis::RelativeCMSpaceLSJT& relcm_space,
     std::array<basis::RelativeCMSectorsLSJT, 3>& relcm_sectors,
     std::array<basis::OperatorBlocks<double>, 3>& relcm_matrices,
-    const double& oscillator_energy, const double& R)
+    const double& oscillator_energy, const double& R,
+    const radial::RadialParameters& radial_params)
 {
   std::cout << " Constructing M1 operator...\n";
   assert(op_params.J0 == 1);
@@ -34,44 +354,29 @@ void ConstructMu2nNLOOperator(
   // Alias isospin rank.
   int T0 = op_params.T0_min;
 
-  // Generate required harmonic oscillator basis functions, and radial
-  // integral weights.
-  int Nmax = op_params.Nmax;
-
-  const int npts = 3001;
-  const double low = 0, high = 1;
-  Eigen::ArrayXd x, r, jac, wt;
-  quadpp::SemiInfiniteIntegralMesh(npts, low, high, x, r, jac);
-  wt = r * r * jac;  // weights for radial integral with transformed variable
-
-  std::cout << "  Generating basis functions...\n";
-  std::vector<Eigen::ArrayXXd> ho_wfs;
-  double brel = chime::RelativeOscillatorLength(oscillator_energy);
+  // Relative radial integrals.
+  const radial::RadialIntegrals radial_integrals =
+      radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(relcm_space),
+                                 oscillator_energy, R, radial_params),
+          radial_params,
+          {"expmpir", "expmpir*wpir", "zpir*ypir", "tpir*ypir"});
   double bcm = chime::CMOscillatorLength(oscillator_energy);
-  basis_func::ho::WaveFunctionsUptoMaxL(ho_wfs, r, Nmax, Nmax, brel,
-                                        basis_func::Space::coordinate);
-
-  // Relative radial integral kernels.
-  std::cout << "  Generating integration kernels...\n";
-  Eigen::ArrayXd mpir = mPi * r;
-  Eigen::ArrayXd expmpir = Eigen::exp(-mpir);
-  Eigen::ArrayXd ypir = expmpir / mpir;
-  Eigen::ArrayXd zpir = (1. + mpir);
-  Eigen::ArrayXd tpir = (-1. + 2 * mpir);
-  Eigen::ArrayXd wpir = (1. + (3 * zpir / mpir.square()));
-
-  // Semilocal coordinate space regulator.
-  Eigen::ArrayXd scs_reg = Eigen::ArrayXd::Ones(npts);
-  if (R != 0) {
-    scs_reg *= Eigen::pow(1. - Eigen::exp(-(r * r) / (R * R)), 6);
-  }
 
   // Zero initialize operator.
   std::cout << "  Zero initializing operator...\n";
-  for (int T = op_params.T0_min; T <= op_params.T0_max; ++T) {
-    relcm_sectors[T] = basis::RelativeCMSectorsLSJT(relcm_space, op_params.J0,
-                                                    T, op_params.g0);
-    basis::SetOperatorToZero(relcm_sectors[T], relcm_matrices[T]);
+  {
+    instrument::ScopedPhase phase(instrument::Phase::kZeroInit);
+    for (int T = op_params.T0_min; T <= op_params.T0_max; ++T) {
+      relcm_sectors[T] = basis::RelativeCMSectorsLSJT(
+          relcm_space, op_params.J0, T, op_params.g0);
+      if (numa::Enabled()) {
+        numa::SetOperatorToZero(relcm_sectors[T], relcm_matrices[T]);
+      }
+      else {
+        basis::SetOperatorToZero(relcm_sectors[T], relcm_matrices[T]);
+      }
+    }
   }
 
   // Select T0 component.
@@ -80,151 +385,228 @@ void ConstructMu2nNLOOperator(
 
   // Reduced matrix element calculation.
   std::cout << "  Starting matrix element calculation...\n";
+  instrument::ScopedPhase phase(instrument::Phase::kSectorLoop);
   for (std::size_t sector_index = 0; sector_index < sectors.size();
        ++sector_index) {
+    instrument::TraceSpan span("sector", sector_index);
     const basis::RelativeCMSectorsLSJT::SectorType& sector =
         sectors.GetSector(sector_index);
     const basis::RelativeCMSubspaceLSJT& bra_subspace = sector.bra_subspace();
     const basis::RelativeCMSubspaceLSJT& ket_subspace = sector.ket_subspace();
 
-    // Alias for matrix.
-    basis::OperatorBlock<double>& matrix = matrices[sector_index];
+    if (Mu2nNLOAllowed(bra_subspace, ket_subspace)) {
+      Mu2nNLOBlock(bra_subspace, ket_subspace, radial_integrals, bcm,
+                   matrices[sector_index]);
+      instrument::Count(instrument::Counter::kSectorsVisited);
+    }
+    else {
+      instrument::Count(instrument::Counter::kSectorsSkipped);
+    }
+  }
+}
 
-    // Extract subspace labels.
-    int bra_L = bra_subspace.L();
-    int bra_S = bra_subspace.S();
-    int bra_J = bra_subspace.J();
-    int bra_T = bra_subspace.T();
-    int ket_L = ket_subspace.L();
-    int ket_S = ket_subspace.S();
-    int ket_J = ket_subspace.J();
-    int ket_T = ket_subspace.T();
+radial::RadialTableShape Mu2nNLORadialTableShape(
+    const basis::RelativeCMSpaceLSJT& relcm_space)
+{
+  return {kNumKernels, kMaxDeltaL, RadialExtents(relcm_space)};
+}
 
-    if (bra_T == ket_T) {
-      continue;
+double Mu2nNLOSectorCost(
+    const basis::RelativeCMSectorsLSJT::SectorType& sector)
+{
+  if (!Mu2nNLOAllowed(sector.bra_subspace(), sector.ket_subspace())) {
+    return 0;
+  }
+  return double(sector.bra_subspace().size()) * sector.ket_subspace().size();
+}
+
+void ConstructMu2nNLOSectors(const basis::RelativeCMSpaceLSJT& relcm_space,
+                             const basis::RelativeCMSectorsLSJT& sectors,
+                             const std::vector<std::size_t>& sector_indices,
+                             basis::OperatorBlocks<double>& matrices,
+                             const double& oscillator_energy, const double& R,
+                             const radial::RadialParameters& radial_params)
+{
+  matrices.assign(sectors.size(), basis::OperatorBlock<double>());
+  if (sector_indices.empty()) {
+    return;
+  }
+
+  // Relative radial integrals of the subspaces of the selected sectors.
+  std::vector<bool> subspace_mask(relcm_space.size(), false);
+  for (const std::size_t sector_index : sector_indices) {
+    const basis::RelativeCMSectorsLSJT::SectorType& sector =
+        sectors.GetSector(sector_index);
+    subspace_mask[sector.bra_subspace_index()] = true;
+    subspace_mask[sector.ket_subspace_index()] = true;
+  }
+  const radial::RadialIntegrals radial_integrals =
+      radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(relcm_space, subspace_mask),
+                                 oscillator_energy, R, radial_params),
+          radial_params,
+          {"expmpir", "expmpir*wpir", "zpir*ypir", "tpir*ypir"});
+  const double bcm = chime::CMOscillatorLength(oscillator_energy);
+
+  // Reduced matrix element calculation.
+  instrument::ScopedPhase phase(instrument::Phase::kSectorLoop);
+  for (const std::size_t sector_index : sector_indices) {
+    instrument::TraceSpan span("sector", sector_index);
+    const basis::RelativeCMSectorsLSJT::SectorType& sector =
+        sectors.GetSector(sector_index);
+    const basis::RelativeCMSubspaceLSJT& bra_subspace = sector.bra_subspace();
+    const basis::RelativeCMSubspaceLSJT& ket_subspace = sector.ket_subspace();
+    if (Mu2nNLOAllowed(bra_subspace, ket_subspace)) {
+      Mu2nNLOBlock(bra_subspace, ket_subspace, radial_integrals, bcm,
+                   matrices[sector_index]);
+      instrument::Count(instrument::Counter::kSectorsVisited);
     }
+    else {
+      matrices[sector_index].setZero(bra_subspace.size(), ket_subspace.size());
+      instrument::Count(instrument::Counter::kSectorsSkipped);
+    }
+  }
+}
 
-    // Loop over bra and ket states.
-    const std::size_t bra_subspace_size = bra_subspace.size();
-    const std::size_t ket_subspace_size = ket_subspace.size();
-#pragma omp parallel for collapse(2)
-    for (std::size_t bra_index = 0; bra_index < bra_subspace_size;
-         ++bra_index) {
-      for (std::size_t ket_index = 0; ket_index < ket_subspace_size;
-           ++ket_index) {
-        const basis::RelativeCMStateLSJT bra_state(bra_subspace, bra_index);
-        const basis::RelativeCMStateLSJT ket_state(ket_subspace, ket_index);
+Mu2nNLOOperator::Mu2nNLOOperator(
+    const basis::RelativeCMSpaceLSJT& relcm_space,
+    const double& oscillator_energy, const double& R,
+    const radial::RadialParameters& radial_params)
+    : sectors_(relcm_space, 1, 1, 0, basis::SectorDirection::kBoth),
+      radial_integrals_(radial::CompressRadialIntegrals(
+          Mu2nNLORadialIntegrals(RadialExtents(relcm_space),
+                                 oscillator_energy, R, radial_params),
+          radial_params,
+          {"expmpir", "expmpir*wpir", "zpir*ypir", "tpir*ypir"})),
+      bcm_(chime::CMOscillatorLength(oscillator_energy)),
+      dimension_(0)
+{
+  for (std::size_t subspace_index = 0; subspace_index < relcm_space.size();
+       ++subspace_index) {
+    offsets_.push_back(dimension_);
+    dimension_ += relcm_space.GetSubspace(subspace_index).size();
+  }
 
-        // Extract state labels.
-        int bra_nr = bra_state.Nr();
-        int bra_lr = bra_state.lr();
-        int bra_nc = bra_state.Nc();
-        int bra_lc = bra_state.lc();
-        int ket_nr = ket_state.Nr();
-        int ket_lr = ket_state.lr();
-        int ket_nc = ket_state.Nc();
-        int ket_lc = ket_state.lc();
-
-        // Common part of all radial integrals.
-        Eigen::ArrayXd common_integrand = wt * scs_reg;
-        common_integrand *=
-            ho_wfs.at(bra_lr).row(bra_nr) * ho_wfs.at(ket_lr).row(ket_nr);
-
-        // Reduced matrix element calculation.
-        // Pauli matrix tensor product in spin space enforces the bra and
-        // ket spins to be the same for the relative-cm part, and to be
-        // different for the purely relative part.
-        double rme = 0;
-
-        if (bra_S == ket_S) {
-          // Relative-cm part.
-          double tp_a =
-              tp::CCSpinTensorProductRME(bra_state, ket_state, 1, 1, 1, 0, 1);
-          tp_a *= -std::sqrt(3.);
-
-          Eigen::ArrayXd y = common_integrand * expmpir;
-          y.head(1) = 0;  // Required to avoid divide by 0.
-          y.tail(1) = 0;  // Required to avoid divide by 0.
-          double integ_expmpir = quadpp::spline::Integrate(x, y);
-
-          rme = tp_a * integ_expmpir;
-
-          if (bra_S == 1) {
-            // Rank 2 Pauli Matrix tensor product.
-
-            double tp_b =
-                tp::CCSpinTensorProductRME(bra_state, ket_state, 1, 1, 1, 2, 1);
-            tp_b *= std::sqrt(3. / 5.);
-
-            double tp_c =
-                tp::CCSpinTensorProductRME(bra_state, ket_state, 1, 1, 2, 2, 1);
-            tp_c *= std::sqrt(9. / 5.);
-
-            double tp_d =
-                tp::CCSpinTensorProductRME(bra_state, ket_state, 3, 1, 2, 2, 1);
-            tp_d *= std::sqrt(14. / 5.);
-
-            double tp_e =
-                tp::CCSpinTensorProductRME(bra_state, ket_state, 3, 1, 3, 2, 1);
-            tp_e *= std::sqrt(28. / 5.);
-
-            y *= wpir;
-            y.head(1) = 0;  // Required to avoid divide by 0.
-            y.tail(1) = 0;  // Required to avoid divide by 0.
-            double integ_expmpir_wpir = quadpp::spline::Integrate(x, y);
-
-            rme += (tp_b + tp_c + tp_d + tp_e) * integ_expmpir_wpir;
-          }
-
-          double integ_cm = 0;  // CM coordinate integral; analytical result.
-          if (bra_lc == ket_lc + 1) {
-            integ_cm = ((std::sqrt(ket_nc + ket_lc + 1.5) * (bra_nc == ket_nc))
-                        + (std::sqrt(ket_nc) * (bra_nc + 1 == ket_nc)));
-          }
-          else if (bra_lc + 1 == ket_lc) {
-            integ_cm = ((std::sqrt(bra_nc + ket_nc + 1.5)) * (bra_nc == ket_nc)
-                        + (std::sqrt(bra_nc) * (bra_nc == ket_nc + 1)));
-          }
-          integ_cm *= mPi * bcm;
-
-          rme *= integ_cm;
-        }
-        else {
-          // Purely relative part. The cm labels for the bra and ket
-          // must be the same.
-          if ((bra_nc == ket_nc) && (bra_lc == ket_lc)) {
-            double tp_f =
-                tp::CCSpinTensorProductRME(bra_state, ket_state, 2, 0, 2, 1, 1);
-            tp_f *= std::sqrt(10.);
-
-            Eigen::ArrayXd y = common_integrand * zpir * ypir;
-            y.head(1) = 0;  // Required to avoid divide by 0.
-            y.tail(1) = 0;  // Required to avoid divide by 0.
-            double integ_zpir_ypir = quadpp::spline::Integrate(x, y);
-
-            rme = tp_f * integ_zpir_ypir;
-
-            if (bra_lr == ket_lr) {
-              // Rank 0 spherical harmonic.
-              double tp_g = tp::CCSpinTensorProductRME(bra_state, ket_state, 0,
-                                                       0, 0, 1, 1);
-
-              y = common_integrand * tpir * ypir;
-              y.head(1) = 0;  // Required to avoid divide by 0.
-              y.tail(1) = 0;  // Required to avoid divide by 0.
-              double integ_tpir_ypir = quadpp::spline::Integrate(x, y);
-
-              rme += tp_g * integ_tpir_ypir;
-            }
-          }
-        }
-        rme *= tp::SpinTensorProductRME(bra_T, ket_T, 1);  // Isospin.
-        rme *= -(mN * mPi * gA * gA) / (24 * constants::pi * FPi * FPi);
-
-        matrix(bra_index, ket_index) = rme;
+  // Distinct (lr, lc) of the states of each subspace.
+  angular_indices_.resize(relcm_space.size());
+  angular_states_.resize(relcm_space.size());
+  for (std::size_t subspace_index = 0; subspace_index < relcm_space.size();
+       ++subspace_index) {
+    const basis::RelativeCMSubspaceLSJT& subspace =
+        relcm_space.GetSubspace(subspace_index);
+    std::map<std::pair<int, int>, int> indices;
+    for (std::size_t index = 0; index < subspace.size(); ++index) {
+      const basis::RelativeCMStateLSJT state(subspace, index);
+      const auto inserted = indices.emplace(
+          std::make_pair(state.lr(), state.lc()), int(indices.size()));
+      if (inserted.second) {
+        angular_states_[subspace_index].push_back(index);
       }
+      angular_indices_[subspace_index].push_back(inserted.first->second);
+    }
+  }
+
+  // Angular factors of the allowed sectors, for each pair of the distinct
+  // (lr, lc) of their subspaces.
+  std::vector<SectorFactors> allowed;
+  for (std::size_t sector_index = 0; sector_index < sectors_.size();
+       ++sector_index) {
+    const basis::RelativeCMSectorsLSJT::SectorType& sector =
+        sectors_.GetSector(sector_index);
+    if (Mu2nNLOAllowed(sector.bra_subspace(), sector.ket_subspace())) {
+      allowed.push_back({sector_index, Eigen::MatrixXd(), Eigen::MatrixXd()});
+    }
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (std::size_t allowed_index = 0; allowed_index < allowed.size();
+       ++allowed_index) {
+    SectorFactors& sector_factors = allowed[allowed_index];
+    const basis::RelativeCMSectorsLSJT::SectorType& sector =
+        sectors_.GetSector(sector_factors.sector_index);
+    const std::vector<std::size_t>& bra_states =
+        angular_states_[sector.bra_subspace_index()];
+    const std::vector<std::size_t>& ket_states =
+        angular_states_[sector.ket_subspace_index()];
+    sector_factors.first.resize(bra_states.size(), ket_states.size());
+    sector_factors.second.resize(bra_states.size(), ket_states.size());
+    for (std::size_t ket = 0; ket < ket_states.size(); ++ket) {
+      const basis::RelativeCMStateLSJT ket_state(sector.ket_subspace(),
+                                                 ket_states[ket]);
+      for (std::size_t bra = 0; bra < bra_states.size(); ++bra) {
+        const basis::RelativeCMStateLSJT bra_state(sector.bra_subspace(),
+                                                   bra_states[bra]);
+        const Mu2nNLOFactors factors =
+            Mu2nNLOAngularFactors(bra_state, ket_state);
+        sector_factors.first(bra, ket) = factors.first;
+        sector_factors.second(bra, ket) = factors.second;
+      }
+    }
+  }
+  sectors_by_bra_.resize(relcm_space.size());
+  for (SectorFactors& sector_factors : allowed) {
+    const std::size_t bra_subspace_index =
+        sectors_.GetSector(sector_factors.sector_index).bra_subspace_index();
+    sectors_by_bra_[bra_subspace_index].push_back(std::move(sector_factors));
+  }
+}
+
+void Mu2nNLOOperator::ApplySector(const SectorFactors& sector_factors,
+                                  const Eigen::VectorXd& x,
+                                  Eigen::VectorXd& y) const
+{
+  const basis::RelativeCMSectorsLSJT::SectorType& sector =
+      sectors_.GetSector(sector_factors.sector_index);
+  const basis::RelativeCMSubspaceLSJT& bra_subspace = sector.bra_subspace();
+  const basis::RelativeCMSubspaceLSJT& ket_subspace = sector.ket_subspace();
+  const int bra_S = bra_subspace.S();
+  const int ket_S = ket_subspace.S();
+  const std::vector<int>& bra_angular =
+      angular_indices_[sector.bra_subspace_index()];
+  const std::vector<int>& ket_angular =
+      angular_indices_[sector.ket_subspace_index()];
+  const std::size_t bra_offset = offsets_[sector.bra_subspace_index()];
+  const std::size_t ket_offset = offsets_[sector.ket_subspace_index()];
+  for (std::size_t ket_index = 0; ket_index < ket_subspace.size();
+       ++ket_index) {
+    const Mu2nNLOLabels ket =
+        Labels(basis::RelativeCMStateLSJT(ket_subspace, ket_index));
+    const double amplitude = x(ket_offset + ket_index);
+    for (std::size_t bra_index = 0; bra_index < bra_subspace.size();
+         ++bra_index) {
+      const Mu2nNLOFactors factors{
+          sector_factors.first(bra_angular[bra_index], ket_angular[ket_index]),
+          sector_factors.second(bra_angular[bra_index],
+                                ket_angular[ket_index])};
+      if ((factors.first == 0) && (factors.second == 0)) {
+        continue;
+      }
+      const Mu2nNLOLabels bra =
+          Labels(basis::RelativeCMStateLSJT(bra_subspace, bra_index));
+      y(bra_offset + bra_index) +=
+          Mu2nNLORME(factors, bra_S, bra, ket_S, ket, radial_integrals_, bcm_)
+          * amplitude;
+    }
+  }
+  instrument::Count(instrument::Counter::kStatePairs,
+                    bra_subspace.size() * ket_subspace.size());
+}
+
+Eigen::VectorXd Mu2nNLOOperator::Apply(const Eigen::VectorXd& x) const
+{
+  assert(std::size_t(x.size()) == dimension_);
+  Eigen::VectorXd y = Eigen::VectorXd::Zero(dimension_);
+
+  // Each bra subspace is a disjoint segment of the result. The sectors are
+  // applied serially within a thread.
+#pragma omp parallel for schedule(dynamic)
+  for (std::size_t bra_index = 0; bra_index < sectors_by_bra_.size();
+       ++bra_index) {
+    instrument::TraceSpan span("apply", bra_index);
+    for (const SectorFactors& sector_factors : sectors_by_bra_[bra_index]) {
+      ApplySector(sector_factors, x, y);
     }
   }
+  return y;
 }
 
 }  // namespace relcm
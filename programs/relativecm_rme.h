@@ -1,9 +1,13 @@
 #ifndef RELATIVECM_RME_H_
 #define RELATIVECM_RME_H_
 
+#include <Eigen/Dense>
 #include <array>
+#include <vector>
 
 #include "basis/lsjt_operator.h"
+#include "lowrank.h"
+#include "radial.h"
 
 namespace chime {
 namespace relcm {
@@ -13,7 +17,75 @@ void ConstructMu2nNLOOperator(
     const basis::RelativeCMSpaceLSJT& relcm_space,
     std::array<basis::RelativeCMSectorsLSJT, 3>& relcm_sectors,
     std::array<basis::OperatorBlocks<double>, 3>& relcm_matrices,
-    const double& oscillator_energy, const double& R);
+    const double& oscillator_energy, const double& R,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// Shape of the relative radial integral table of the 2n NLO magnetic moment
+// operator on `relcm_space`.
+radial::RadialTableShape Mu2nNLORadialTableShape(
+    const basis::RelativeCMSpaceLSJT& relcm_space);
+
+// Estimated cost of calculating the block of `sector`, as
+// relative::Mu2nNLOSectorCost.
+double Mu2nNLOSectorCost(
+    const basis::RelativeCMSectorsLSJT::SectorType& sector);
+
+// Calculates the blocks of the sectors `sector_indices` only, with the
+// relative radial integrals of their subspaces, as
+// relative::ConstructMu2nNLOSectors.
+void ConstructMu2nNLOSectors(
+    const basis::RelativeCMSpaceLSJT& relcm_space,
+    const basis::RelativeCMSectorsLSJT& sectors,
+    const std::vector<std::size_t>& sector_indices,
+    basis::OperatorBlocks<double>& matrices, const double& oscillator_energy,
+    const double& R,
+    const radial::RadialParameters& radial_params = radial::RadialParameters());
+
+// 2n NLO magnetic moment operator, applied to vectors of the relative-cm space
+// without storing its matrix, as relative::Mu2nNLOOperator.
+class Mu2nNLOOperator {
+ public:
+  Mu2nNLOOperator(
+      const basis::RelativeCMSpaceLSJT& relcm_space,
+      const double& oscillator_energy, const double& R,
+      const radial::RadialParameters& radial_params =
+          radial::RadialParameters());
+
+  // Number of states of the space.
+  std::size_t dimension() const { return dimension_; }
+
+  Eigen::VectorXd Apply(const Eigen::VectorXd& x) const;
+
+ private:
+  // Allowed sector with its spin, isospin and coupling factors, for each
+  // pair of the distinct (lr, lc) of its bra and ket subspaces. Between
+  // equal spins, `first` and `second` are the factors of the expmpir and
+  // expmpir*wpir integrals, and between different spins of the zpir*ypir
+  // and tpir*ypir integrals.
+  struct SectorFactors {
+    std::size_t sector_index;
+    Eigen::MatrixXd first;
+    Eigen::MatrixXd second;
+  };
+
+  // Adds the block of a sector times `x` to `y`, serially.
+  void ApplySector(const SectorFactors& sector_factors,
+                   const Eigen::VectorXd& x, Eigen::VectorXd& y) const;
+
+  basis::RelativeCMSectorsLSJT sectors_;
+  std::vector<std::vector<SectorFactors>> sectors_by_bra_;
+
+  // Index of the (lr, lc) of each state among the distinct ones of its
+  // subspace, and the first state of each of these.
+  std::vector<std::vector<int>> angular_indices_;
+  std::vector<std::vector<std::size_t>> angular_states_;
+
+  radial::RadialIntegrals radial_integrals_;
+  double bcm_;
+
+  std::vector<std::size_t> offsets_;
+  std::size_t dimension_;
+};
 
 }  // namespace relcm
 }  // namespace chime
@@ -1,6 +1,9 @@
 #include "relativecm_rme.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <vector>
 
 #include "basis_func/ho.h"
 #include "chime.h"
@@ -8,6 +11,52 @@
 #include "quadpp/quadpp.h"
 #include "quadpp/spline.h"
 
+// Checks that the matrix-free operator applies the stored operator, with the
+// blocks of the sectors in both directions, at small Nmax.
+bool CheckMatrixFreeOperator()
+{
+  const basis::RelativeCMSpaceLSJT space(4);
+  const double oscillator_energy = 20, R = 1.;
+  chime::radial::RadialParameters radial_params;
+  radial_params.npts = 1001;
+
+  const basis::RelativeCMSectorsLSJT sectors(space, 1, 1, 0,
+                                             basis::SectorDirection::kBoth);
+  std::vector<std::size_t> sector_indices(sectors.size());
+  for (std::size_t index = 0; index < sectors.size(); ++index) {
+    sector_indices[index] = index;
+  }
+  basis::OperatorBlocks<double> matrices;
+  chime::relcm::ConstructMu2nNLOSectors(space, sectors, sector_indices,
+                                        matrices, oscillator_energy, R,
+                                        radial_params);
+  const chime::relcm::Mu2nNLOOperator op(space, oscillator_energy, R,
+                                         radial_params);
+
+  std::vector<std::size_t> offsets;
+  std::size_t dimension = 0;
+  for (std::size_t index = 0; index < space.size(); ++index) {
+    offsets.push_back(dimension);
+    dimension += space.GetSubspace(index).size();
+  }
+  const Eigen::VectorXd x = Eigen::VectorXd::Random(dimension);
+  Eigen::VectorXd expected = Eigen::VectorXd::Zero(dimension);
+  for (std::size_t index = 0; index < sectors.size(); ++index) {
+    const basis::RelativeCMSectorsLSJT::SectorType& sector =
+        sectors.GetSector(index);
+    expected.segment(offsets[sector.bra_subspace_index()],
+                     matrices[index].rows()) +=
+        matrices[index]
+        * x.segment(offsets[sector.ket_subspace_index()],
+                    matrices[index].cols());
+  }
+  const double deviation = (op.Apply(x) - expected).cwiseAbs().maxCoeff();
+  std::cout << "Matrix-free operator deviation: " << deviation << " (norm "
+            << expected.norm() << ")\n";
+  return (op.dimension() == dimension)
+         && (deviation <= 1e-12 * std::max(1., expected.norm()));
+}
+
 int main()
 {
   int Nmax = 20;
@@ -94,4 +143,6 @@ int main()
   // file.open("integrand.txt");
   // file << output.format(fmt) << "\n";
   // file.close();
+
+  return CheckMatrixFreeOperator() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,264 @@
+#include "simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CHIME_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace chime {
+namespace simd {
+
+// Kernels are instantiated for up to this many weights per sweep. Larger
+// kernel sets are processed in groups.
+constexpr int kMaxKernels = 4;
+
+///////////////////////////////////////////////////////////////////////////
+/////////////////////////////// Scalar kernels ////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+template <int K>
+void FusedProductSumsScalar(const double* a, const double* b,
+                            const double* const* weights, const int& begin,
+                            const int& end, double* sums)
+{
+  double acc[K] = {};
+  for (int i = begin; i < end; ++i) {
+    const double product = a[i] * b[i];
+    for (int k = 0; k < K; ++k) {
+      acc[k] += product * weights[k][i];
+    }
+  }
+  for (int k = 0; k < K; ++k) {
+    sums[k] = acc[k];
+  }
+}
+
+#ifdef CHIME_SIMD_X86
+
+///////////////////////////////////////////////////////////////////////////
+//////////////////////////////// AVX2 kernels /////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2,fma"))) inline double HorizontalSum(
+    const __m256d& v)
+{
+  __m128d low = _mm256_castpd256_pd128(v);
+  __m128d high = _mm256_extractf128_pd(v, 1);
+  low = _mm_add_pd(low, high);
+  return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+}
+
+// Two independent accumulator sets hide the latency of the fused
+// multiply-add for small kernel sets.
+template <int K>
+__attribute__((target("avx2,fma"))) void FusedProductSumsAVX2(
+    const double* a, const double* b, const double* const* weights,
+    const int& begin, const int& end, double* sums)
+{
+  __m256d acc0[K], acc1[K];
+  for (int k = 0; k < K; ++k) {
+    acc0[k] = _mm256_setzero_pd();
+    acc1[k] = _mm256_setzero_pd();
+  }
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256d p0 =
+        _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+    const __m256d p1 =
+        _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+    for (int k = 0; k < K; ++k) {
+      acc0[k] = _mm256_fmadd_pd(p0, _mm256_loadu_pd(weights[k] + i), acc0[k]);
+      acc1[k] =
+          _mm256_fmadd_pd(p1, _mm256_loadu_pd(weights[k] + i + 4), acc1[k]);
+    }
+  }
+  for (int k = 0; k < K; ++k) {
+    sums[k] = HorizontalSum(_mm256_add_pd(acc0[k], acc1[k]));
+  }
+  for (; i < end; ++i) {
+    const double product = a[i] * b[i];
+    for (int k = 0; k < K; ++k) {
+      sums[k] += product * weights[k][i];
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+/////////////////////////////// AVX-512 kernels ///////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx512f"))) inline double HorizontalSum(
+    const __m512d& v)
+{
+  double lanes[8];
+  _mm512_storeu_pd(lanes, v);
+  return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5]))
+         + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+template <int K>
+__attribute__((target("avx512f"))) void FusedProductSumsAVX512(
+    const double* a, const double* b, const double* const* weights,
+    const int& begin, const int& end, double* sums)
+{
+  __m512d acc0[K], acc1[K];
+  for (int k = 0; k < K; ++k) {
+    acc0[k] = _mm512_setzero_pd();
+    acc1[k] = _mm512_setzero_pd();
+  }
+  int i = begin;
+  for (; i + 16 <= end; i += 16) {
+    const __m512d p0 =
+        _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+    const __m512d p1 =
+        _mm512_mul_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+    for (int k = 0; k < K; ++k) {
+      acc0[k] = _mm512_fmadd_pd(p0, _mm512_loadu_pd(weights[k] + i), acc0[k]);
+      acc1[k] =
+          _mm512_fmadd_pd(p1, _mm512_loadu_pd(weights[k] + i + 8), acc1[k]);
+    }
+  }
+  // Masked tail, fewer than 16 points.
+  for (; i < end; i += 8) {
+    const int remaining = end - i;
+    const __mmask8 mask =
+        (remaining >= 8) ? __mmask8(0xFF) : __mmask8((1u << remaining) - 1);
+    const __m512d p = _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, a + i),
+                                    _mm512_maskz_loadu_pd(mask, b + i));
+    for (int k = 0; k < K; ++k) {
+      acc0[k] = _mm512_fmadd_pd(
+          p, _mm512_maskz_loadu_pd(mask, weights[k] + i), acc0[k]);
+    }
+  }
+  for (int k = 0; k < K; ++k) {
+    sums[k] = HorizontalSum(_mm512_add_pd(acc0[k], acc1[k]));
+  }
+}
+
+#endif  // CHIME_SIMD_X86
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////// Dispatch ////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+using KernelFunction = void (*)(const double*, const double*,
+                                const double* const*, const int&, const int&,
+                                double*);
+
+// Kernel of instruction set `isa` for `K` weights.
+template <int K>
+KernelFunction SelectKernel(const InstructionSet& isa)
+{
+#ifdef CHIME_SIMD_X86
+  if (isa == InstructionSet::kAVX512) {
+    return FusedProductSumsAVX512<K>;
+  }
+  if (isa == InstructionSet::kAVX2) {
+    return FusedProductSumsAVX2<K>;
+  }
+#endif
+  return FusedProductSumsScalar<K>;
+}
+
+KernelFunction SelectKernel(const InstructionSet& isa, const int& num_kernels)
+{
+  assert((num_kernels >= 1) && (num_kernels <= kMaxKernels));
+  switch (num_kernels) {
+    case 1:
+      return SelectKernel<1>(isa);
+    case 2:
+      return SelectKernel<2>(isa);
+    case 3:
+      return SelectKernel<3>(isa);
+    default:
+      return SelectKernel<kMaxKernels>(isa);
+  }
+}
+
+bool Supported(const InstructionSet& isa)
+{
+  switch (isa) {
+    case InstructionSet::kScalar:
+      return true;
+#ifdef CHIME_SIMD_X86
+    case InstructionSet::kAVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case InstructionSet::kAVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+std::string InstructionSetName(const InstructionSet& isa)
+{
+  switch (isa) {
+    case InstructionSet::kAVX2:
+      return "avx2";
+    case InstructionSet::kAVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+// Detects the widest supported instruction set, unless overridden by the
+// environment variable CHIME_SIMD.
+InstructionSet DetectInstructionSet()
+{
+  const char* requested = std::getenv("CHIME_SIMD");
+  if (requested != nullptr) {
+    for (const auto& isa : {InstructionSet::kScalar, InstructionSet::kAVX2,
+                            InstructionSet::kAVX512}) {
+      if (InstructionSetName(isa) == requested) {
+        if (Supported(isa)) {
+          return isa;
+        }
+        std::cout << "  Instruction set " << requested
+                  << " not supported, ignoring CHIME_SIMD.\n";
+      }
+    }
+  }
+  if (Supported(InstructionSet::kAVX512)) {
+    return InstructionSet::kAVX512;
+  }
+  if (Supported(InstructionSet::kAVX2)) {
+    return InstructionSet::kAVX2;
+  }
+  return InstructionSet::kScalar;
+}
+
+InstructionSet ActiveInstructionSet()
+{
+  static const InstructionSet isa = DetectInstructionSet();
+  return isa;
+}
+
+void FusedProductSums(const InstructionSet& isa, const double* a,
+                      const double* b, const double* const* weights,
+                      const int& num_kernels, const int& begin, const int& end,
+                      double* sums)
+{
+  assert(Supported(isa));
+  for (int k = 0; k < num_kernels; k += kMaxKernels) {
+    const int group_size = std::min(kMaxKernels, num_kernels - k);
+    SelectKernel(isa, group_size)(a, b, weights + k, begin, end, sums + k);
+  }
+}
+
+void FusedProductSums(const double* a, const double* b,
+                      const double* const* weights, const int& num_kernels,
+                      const int& begin, const int& end, double* sums)
+{
+  FusedProductSums(ActiveInstructionSet(), a, b, weights, num_kernels, begin,
+                   end, sums);
+}
+
+}  // namespace simd
+}  // namespace chime
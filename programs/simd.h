@@ -0,0 +1,63 @@
+/*******************************************************************************
+ simd.h
+
+ Defines the explicitly vectorized kernels of the radial integration hot loop.
+ The instruction set is selected at runtime from the features of the CPU, so
+ that the same executable runs on any x86-64 machine, and uses AVX2 or AVX-512
+ where available. On other architectures only the scalar kernels are built.
+
+ The detected instruction set can be overridden with the environment variable
+ CHIME_SIMD, set to one of "scalar", "avx2" or "avx512".
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <string>
+
+namespace chime {
+namespace simd {
+
+enum class InstructionSet { kScalar, kAVX2, kAVX512 };
+
+// Instruction set used by the dispatched kernels. Detected on first call.
+InstructionSet ActiveInstructionSet();
+
+// Whether the kernels for instruction set `isa` are built in and supported by
+// the CPU.
+bool Supported(const InstructionSet& isa);
+
+// Name of instruction set, e.g. "avx2".
+std::string InstructionSetName(const InstructionSet& isa);
+
+// Calculates the fused products sums
+//
+//   sums[k] = sum_{begin <= i < end} a[i] * b[i] * weights[k][i],
+//
+// for 0 <= k < num_kernels, reading `a` and `b` once.
+//
+// Arguments:
+//   a, b (const double*): wave functions on the mesh
+//   weights (const double* const*): `num_kernels` folded kernel weights
+//   num_kernels (int): number of kernels
+//   begin, end (int): range of mesh points
+//   sums (double*): output, `num_kernels` sums
+void FusedProductSums(const double* a, const double* b,
+                      const double* const* weights, const int& num_kernels,
+                      const int& begin, const int& end, double* sums);
+
+// Same as above, with an explicitly chosen instruction set, which must be
+// supported.
+void FusedProductSums(const InstructionSet& isa, const double* a,
+                      const double* b, const double* const* weights,
+                      const int& num_kernels, const int& begin, const int& end,
+                      double* sums);
+
+}  // namespace simd
+}  // namespace chime
+
+#endif
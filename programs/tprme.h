@@ -12,10 +12,15 @@
 #ifndef TPRME_H_
 #define TPRME_H_
 
+#include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <type_traits>
 
 #include "am/rme.h"
 #include "basis/lsjt_scheme.h"
+#include "instrument.h"
+#include "wigner.h"
 
 namespace chime {
 namespace tp {
@@ -84,8 +89,10 @@ inline double CSpinTensorProductRME(const basis::RelativeSubspaceLSJT& bra,
   int ket_J = ket.J();
 
   if (am::AllowedTriangle(bra_L, a, ket_L)) {
+    instrument::Count(instrument::Counter::kWigner9J);
     double result = HatProduct(bra_L, bra_S, ket_J, c);
-    result *= am::Wigner9J(ket_L, ket_S, ket_J, a, b, c, bra_L, bra_S, bra_J);
+    result *=
+        wigner::Wigner9J(ket_L, ket_S, ket_J, a, b, c, bra_L, bra_S, bra_J);
     result *= am::SphericalHarmonicCRME(bra_L, ket_L, a);
     result *= SpinTensorProductRME(bra_S, ket_S, b);
     return result;
@@ -130,11 +137,13 @@ inline double CCSpinTensorProductRME(const basis::RelativeCMStateLSJT& bra,
 
   if (am::AllowedTriangle(bra_lr, a, ket_lr)
       && am::AllowedTriangle(bra_lc, b, ket_lc)) {
+    instrument::Count(instrument::Counter::kWigner9J, 2);
     double result =
         HatProduct(bra_L, bra_S, ket_J, e, bra_lr, bra_lc, ket_L, c);
-    result *= am::Wigner9J(ket_L, ket_S, ket_J, c, d, e, bra_L, bra_S, bra_J);
     result *=
-        am::Wigner9J(ket_lr, ket_lc, ket_L, a, b, c, bra_lr, bra_lc, bra_L);
+        wigner::Wigner9J(ket_L, ket_S, ket_J, c, d, e, bra_L, bra_S, bra_J);
+    result *= wigner::Wigner9J(ket_lr, ket_lc, ket_L, a, b, c, bra_lr, bra_lc,
+                               bra_L);
     result *= am::SphericalHarmonicCRME(bra_lr, ket_lr, a);
     result *= am::SphericalHarmonicCRME(bra_lc, ket_lc, b);
     result *= SpinTensorProductRME(bra_S, ket_S, d);
@@ -142,6 +151,155 @@ inline double CCSpinTensorProductRME(const basis::RelativeCMStateLSJT& bra,
   }
   return 0;
 }
+
+// Compile-time versions of the above, for ranks that are constants at the
+// call site. The selection rules of the spin tensor product and the hat
+// factors of the ranks are resolved at compile time, 9j symbols with a rank
+// 0 argument reduce to 6j symbols, and sectors ruled out by the spin
+// selection rules return before any 9j symbol is evaluated. The results are
+// those of the versions above.
+
+// Whether the rank `rank` tensor product of Pauli matrices connects the
+// spins `sp` and `s`.
+template <int rank>
+inline bool AllowedSpins(const int& sp, const int& s)
+{
+  static_assert((rank >= 0) && (rank <= 2), "Pauli rank must be 0, 1 or 2");
+  if (rank == 0) {
+    return sp == s;
+  }
+  else if (rank == 1) {
+    return sp != s;
+  }
+  else {
+    return (sp == 1) && (s == 1);
+  }
+}
+
+template <int rank>
+inline double SpinTensorProductRME(const int& sp, const int& s)
+{
+  static_assert((rank >= 0) && (rank <= 2), "Pauli rank must be 0, 1 or 2");
+  if (!AllowedSpins<rank>(sp, s)) {
+    return 0;
+  }
+  if (rank == 0) {
+    return ParitySign(s) * Hat(1 - s) / Hat(s);
+  }
+  else if (rank == 1) {
+    return std::sqrt(2) * Hat(s);
+  }
+  else {
+    return std::sqrt(20. / 3.);
+  }
+}
+
+namespace detail {
+
+// 9j symbol {ket1 ket2 ket3; x y z; bra1 bra2 bra3} of the coupling of
+// tensors of ranks x and y to rank z, with a rank 0 argument reduced to a
+// 6j symbol, which is not counted as a 9j symbol,
+//
+//   {a b c; d 0 d; g b i} = (-)^(b+c+d+g) {a c b; i g d} / Hat(b) Hat(d),
+//
+// after swapping the first two columns for x = 0.
+template <int x, int y, int z>
+inline double Coupling9J(const int& ket1, const int& ket2, const int& ket3,
+                         const int& bra1, const int& bra2, const int& bra3,
+                         std::false_type /* no rank 0 */)
+{
+  instrument::Count(instrument::Counter::kWigner9J);
+  return wigner::Wigner9J(ket1, ket2, ket3, x, y, z, bra1, bra2, bra3);
+}
+
+template <int x, int y, int z>
+inline double Coupling9J(const int& ket1, const int& ket2, const int& ket3,
+                         const int& bra1, const int& bra2, const int& bra3,
+                         std::true_type /* rank 0 */)
+{
+  if (y != 0) {
+    // x = 0. Swapping two columns changes the sign by the parity of the
+    // sum of the arguments.
+    return ParitySign(ket1 + ket2 + ket3 + y + z + bra1 + bra2 + bra3)
+           * Coupling9J<y, x, z>(ket2, ket1, ket3, bra2, bra1, bra3,
+                                 std::true_type());
+  }
+  if ((x != z) || (ket2 != bra2)) {
+    return 0;
+  }
+  return ParitySign(ket2 + ket3 + x + bra1)
+         * wigner::Wigner6J(ket1, ket3, ket2, bra3, bra1, x)
+         / (Hat(ket2) * Hat(x));
+}
+
+template <int x, int y, int z>
+inline double Coupling9J(const int& ket1, const int& ket2, const int& ket3,
+                         const int& bra1, const int& bra2, const int& bra3)
+{
+  static_assert((x >= 0) && (y >= 0) && (z >= (x > y ? x - y : y - x))
+                    && (z <= x + y),
+                "ranks must satisfy the triangle rule");
+  return Coupling9J<x, y, z>(
+      ket1, ket2, ket3, bra1, bra2, bra3,
+      std::integral_constant<bool, (x == 0) || (y == 0)>());
+}
+
+}  // namespace detail
+
+template <int a, int b, int c>
+inline double CSpinTensorProductRME(const basis::RelativeSubspaceLSJT& bra,
+                                    const basis::RelativeSubspaceLSJT& ket)
+{
+  const int bra_L = bra.L();
+  const int bra_S = bra.S();
+  const int bra_J = bra.J();
+  const int ket_L = ket.L();
+  const int ket_S = ket.S();
+  const int ket_J = ket.J();
+
+  if (!AllowedSpins<b>(bra_S, ket_S) || !am::AllowedTriangle(bra_L, a, ket_L)) {
+    return 0;
+  }
+  double result = HatProduct(bra_L, bra_S, ket_J) * Hat(c);
+  result *= detail::Coupling9J<a, b, c>(ket_L, ket_S, ket_J, bra_L, bra_S,
+                                        bra_J);
+  result *= am::SphericalHarmonicCRME(bra_L, ket_L, a);
+  result *= SpinTensorProductRME<b>(bra_S, ket_S);
+  return result;
+}
+
+template <int a, int b, int c, int d, int e>
+inline double CCSpinTensorProductRME(const basis::RelativeCMStateLSJT& bra,
+                                     const basis::RelativeCMStateLSJT& ket)
+{
+  const int bra_lr = bra.lr();
+  const int bra_lc = bra.lc();
+  const int bra_L = bra.L();
+  const int bra_S = bra.S();
+  const int bra_J = bra.J();
+  const int ket_lr = ket.lr();
+  const int ket_lc = ket.lc();
+  const int ket_L = ket.L();
+  const int ket_S = ket.S();
+  const int ket_J = ket.J();
+
+  if (!AllowedSpins<d>(bra_S, ket_S)
+      || !am::AllowedTriangle(bra_lr, a, ket_lr)
+      || !am::AllowedTriangle(bra_lc, b, ket_lc)) {
+    return 0;
+  }
+  double result = HatProduct(bra_L, bra_S, ket_J, bra_lr, bra_lc, ket_L)
+                  * (Hat(e) * Hat(c));
+  result *= detail::Coupling9J<c, d, e>(ket_L, ket_S, ket_J, bra_L, bra_S,
+                                        bra_J);
+  result *= detail::Coupling9J<a, b, c>(ket_lr, ket_lc, ket_L, bra_lr,
+                                        bra_lc, bra_L);
+  result *= am::SphericalHarmonicCRME(bra_lr, ket_lr, a);
+  result *= am::SphericalHarmonicCRME(bra_lc, ket_lc, b);
+  result *= SpinTensorProductRME<d>(bra_S, ket_S);
+  return result;
+}
+
 }  // namespace tp
 }  // namespace chime
 
@@ -0,0 +1,142 @@
+#include "wigner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace chime {
+namespace wigner {
+
+namespace {
+
+// Largest factorial in the table, enough for the 6j symbols of angular
+// momenta up to 255.
+constexpr int kMaxFactorial = 1024;
+
+// log(n!), from the table unless n is beyond it.
+double LogFactorial(const int& n)
+{
+  static const std::vector<double> table = [] {
+    std::vector<double> values(kMaxFactorial + 1, 0.);
+    for (int k = 1; k <= kMaxFactorial; ++k) {
+      values[k] = values[k - 1] + std::log(double(k));
+    }
+    return values;
+  }();
+  return (n <= kMaxFactorial) ? table[n] : std::lgamma(n + 1.);
+}
+
+bool Triangle(const int& a, const int& b, const int& c)
+{
+  return (c >= std::abs(a - b)) && (c <= a + b);
+}
+
+// log of the triangle coefficient of (a b c).
+double LogDelta(const int& a, const int& b, const int& c)
+{
+  return 0.5 * (LogFactorial(a + b - c) + LogFactorial(a - b + c)
+                + LogFactorial(-a + b + c) - LogFactorial(a + b + c + 1));
+}
+
+// 6j symbol with its triangles already checked.
+double Racah6J(const int& j1, const int& j2, const int& j3, const int& j4,
+               const int& j5, const int& j6)
+{
+  const int a1 = j1 + j2 + j3;
+  const int a2 = j1 + j5 + j6;
+  const int a3 = j4 + j2 + j6;
+  const int a4 = j4 + j5 + j3;
+  const int b1 = j1 + j2 + j4 + j5;
+  const int b2 = j2 + j3 + j5 + j6;
+  const int b3 = j3 + j1 + j6 + j4;
+  const int t_min = std::max(std::max(a1, a2), std::max(a3, a4));
+  const int t_max = std::min(std::min(b1, b2), b3);
+  const double log_prefactor = LogDelta(j1, j2, j3) + LogDelta(j1, j5, j6)
+                               + LogDelta(j4, j2, j6) + LogDelta(j4, j5, j3);
+  double sum = 0;
+  for (int t = t_min; t <= t_max; ++t) {
+    const double log_term =
+        log_prefactor + LogFactorial(t + 1) - LogFactorial(t - a1)
+        - LogFactorial(t - a2) - LogFactorial(t - a3) - LogFactorial(t - a4)
+        - LogFactorial(b1 - t) - LogFactorial(b2 - t) - LogFactorial(b3 - t);
+    sum += ((t % 2) ? -1. : 1.) * std::exp(log_term);
+  }
+  return sum;
+}
+
+}  // namespace
+
+double Wigner6J(const int& j1, const int& j2, const int& j3, const int& j4,
+                const int& j5, const int& j6)
+{
+  if (!Triangle(j1, j2, j3) || !Triangle(j1, j5, j6) || !Triangle(j4, j2, j6)
+      || !Triangle(j4, j5, j3)) {
+    return 0;
+  }
+  return Racah6J(j1, j2, j3, j4, j5, j6);
+}
+
+double Wigner9J(const int& j1, const int& j2, const int& j3, const int& j4,
+                const int& j5, const int& j6, const int& j7, const int& j8,
+                const int& j9)
+{
+  int j[3][3] = {{j1, j2, j3}, {j4, j5, j6}, {j7, j8, j9}};
+  for (int row = 0; row < 3; ++row) {
+    if (!Triangle(j[row][0], j[row][1], j[row][2])
+        || !Triangle(j[0][row], j[1][row], j[2][row])) {
+      return 0;
+    }
+  }
+
+  // Smallest argument to j9. Each exchange of two rows or two columns
+  // changes the sign by the parity of the sum of the arguments.
+  int min_row = 2, min_col = 2;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      if (j[row][col] < j[min_row][min_col]) {
+        min_row = row;
+        min_col = col;
+      }
+    }
+  }
+  const int sum = j1 + j2 + j3 + j4 + j5 + j6 + j7 + j8 + j9;
+  double sign = 1;
+  if (min_row != 2) {
+    std::swap(j[min_row], j[2]);
+    sign = (sum % 2) ? -sign : sign;
+  }
+  if (min_col != 2) {
+    for (int row = 0; row < 3; ++row) {
+      std::swap(j[row][min_col], j[row][2]);
+    }
+    sign = (sum % 2) ? -sign : sign;
+  }
+
+  // {a b c; d e f; g h 0} = (-)^(b+c+d+g) {a b c; e d g} / Hat(c) Hat(g),
+  // with c = f and g = h by the triangles.
+  if (j[2][2] == 0) {
+    const int phase = j[0][1] + j[0][2] + j[1][0] + j[2][0];
+    return sign * ((phase % 2) ? -1. : 1.)
+           * Racah6J(j[0][0], j[0][1], j[0][2], j[1][1], j[1][0], j[2][0])
+           / std::sqrt((2. * j[0][2] + 1.) * (2. * j[2][0] + 1.));
+  }
+
+  const int x_min = std::max(std::max(std::abs(j[0][0] - j[2][2]),
+                                      std::abs(j[1][0] - j[2][1])),
+                             std::abs(j[0][1] - j[1][2]));
+  const int x_max = std::min(std::min(j[0][0] + j[2][2], j[1][0] + j[2][1]),
+                             j[0][1] + j[1][2]);
+  double result = 0;
+  for (int x = x_min; x <= x_max; ++x) {
+    result += (2 * x + 1)
+              * Racah6J(j[0][0], j[1][0], j[2][0], j[2][1], j[2][2], x)
+              * Racah6J(j[0][1], j[1][1], j[2][1], j[1][0], x, j[1][2])
+              * Racah6J(j[0][2], j[1][2], j[2][2], x, j[0][0], j[0][1]);
+  }
+  return sign * result;
+}
+
+}  // namespace wigner
+}  // namespace chime
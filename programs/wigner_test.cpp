@@ -1,9 +1,143 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
 #include "am/am.h"
 #include "am/wigner_gsl.h"
 #include "tprme.h"
+#include "wigner.h"
+
+// Appends the allowed 9j symbols {ket1 ket2 ket3; x y z; bra1 bra2 bra3}
+// that the tensor products evaluate for the ranks (x, y, z), with ket2 and
+// bra2 up to `max2` and the other arguments up to 8.
+void AppendCallSiteSymbols(const int& x, const int& y, const int& z,
+                           const int& max2,
+                           std::vector<std::array<int, 9>>& symbols)
+{
+  for (int ket1 = 0; ket1 <= 8; ++ket1) {
+    for (int ket2 = 0; ket2 <= max2; ++ket2) {
+      for (int ket3 = std::abs(ket1 - ket2); ket3 <= ket1 + ket2; ++ket3) {
+        for (int bra1 = std::abs(ket1 - x); bra1 <= std::min(ket1 + x, 8);
+             ++bra1) {
+          for (int bra2 = std::abs(ket2 - y);
+               bra2 <= std::min(ket2 + y, max2); ++bra2) {
+            for (int bra3 = std::abs(ket3 - z); bra3 <= ket3 + z; ++bra3) {
+              if (am::AllowedTriangle(bra1, bra2, bra3)) {
+                symbols.push_back(
+                    {ket1, ket2, ket3, x, y, z, bra1, bra2, bra3});
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Seconds of at least `calls` evaluations of the 9j symbol `function`, on
+// `symbols` in turn, with the number of evaluations in `calls` and the sum
+// of the symbols in `checksum`.
+template <typename Function>
+double Time9J(const Function& function,
+              const std::vector<std::array<int, 9>>& symbols, int& calls,
+              double& checksum)
+{
+  const auto start = std::chrono::steady_clock::now();
+  checksum = 0;
+  int evaluated = 0;
+  while (evaluated < calls) {
+    for (const std::array<int, 9>& j : symbols) {
+      checksum +=
+          function(j[0], j[1], j[2], j[3], j[4], j[5], j[6], j[7], j[8]);
+    }
+    evaluated += symbols.size();
+  }
+  calls = evaluated;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - start)
+      .count();
+}
+
+// Largest deviation of the compile-time tensor product RMEs with the ranks
+// of the call sites from the runtime versions, over the relative subspaces
+// and relative-cm states of Nmax `Nmax`.
+double TensorProductDeviation(const int& Nmax)
+{
+  double deviation = 0;
+  const basis::RelativeSpaceLSJT relative_space(Nmax, Nmax + 1);
+  for (std::size_t bra_index = 0; bra_index < relative_space.size();
+       ++bra_index) {
+    const basis::RelativeSubspaceLSJT& bra =
+        relative_space.GetSubspace(bra_index);
+    for (std::size_t ket_index = 0; ket_index < relative_space.size();
+         ++ket_index) {
+      const basis::RelativeSubspaceLSJT& ket =
+          relative_space.GetSubspace(ket_index);
+      const double differences[] = {
+          chime::tp::CSpinTensorProductRME<2, 1, 1>(bra, ket)
+              - chime::tp::CSpinTensorProductRME(bra, ket, 2, 1, 1),
+          chime::tp::CSpinTensorProductRME<0, 1, 1>(bra, ket)
+              - chime::tp::CSpinTensorProductRME(bra, ket, 0, 1, 1)};
+      for (const double& difference : differences) {
+        deviation = std::max(deviation, std::abs(difference));
+      }
+    }
+  }
+
+  const basis::RelativeCMSpaceLSJT relative_cm_space(Nmax);
+  for (std::size_t bra_index = 0; bra_index < relative_cm_space.size();
+       ++bra_index) {
+    const basis::RelativeCMSubspaceLSJT& bra_subspace =
+        relative_cm_space.GetSubspace(bra_index);
+    for (std::size_t ket_index = 0; ket_index < relative_cm_space.size();
+         ++ket_index) {
+      const basis::RelativeCMSubspaceLSJT& ket_subspace =
+          relative_cm_space.GetSubspace(ket_index);
+      for (std::size_t bra_state = 0; bra_state < bra_subspace.size();
+           ++bra_state) {
+        const basis::RelativeCMStateLSJT bra(bra_subspace, bra_state);
+        for (std::size_t ket_state = 0; ket_state < ket_subspace.size();
+             ++ket_state) {
+          const basis::RelativeCMStateLSJT ket(ket_subspace, ket_state);
+          const double differences[] = {
+              chime::tp::CCSpinTensorProductRME<1, 1, 1, 0, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 1, 1, 1, 0,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<1, 1, 1, 2, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 1, 1, 1, 2,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<1, 1, 2, 2, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 1, 1, 2, 2,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<3, 1, 2, 2, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 3, 1, 2, 2,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<3, 1, 3, 2, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 3, 1, 3, 2,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<2, 0, 2, 1, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 2, 0, 2, 1,
+                                                      1),
+              chime::tp::CCSpinTensorProductRME<0, 0, 0, 1, 1>(bra, ket)
+                  - chime::tp::CCSpinTensorProductRME(bra, ket, 0, 0, 0, 1,
+                                                      1)};
+          for (const double& difference : differences) {
+            deviation = std::max(deviation, std::abs(difference));
+          }
+        }
+      }
+    }
+  }
+  return deviation;
+}
 
 int main()
 {
+  bool passed = true;
   std::cout << am::Wigner9J(0, 1, 1, 0, 1, 1, 0, 0, 0) << "\n";
 
   int lp = 0, sp = 0, jp = 0, tp = 1;
@@ -21,4 +155,85 @@ int main()
   double C2S1s = ParitySign(lp + l) * am::Wigner6J(2, 1, 1, j, l, lp);
   C2S1s *= Hat(j) * std::sqrt(6) * am::SphericalHarmonicCRME(lp, l, 2);
   std::cout << C2S1s << "\n";
+  passed &= (std::abs(C2S1n - C2S1s) < 1e-12);
+
+  // 9j symbols of wigner.h against the library, for all arguments up to 3,
+  // which covers the ranks of the tensor products, and for arguments up to
+  // 12 with one of rank 0 to 3.
+  double deviation = 0;
+  for (int index = 0; index < (1 << 18); ++index) {
+    int j9[9];
+    for (int k = 0, rest = index; k < 9; ++k, rest /= 4) {
+      j9[k] = rest % 4;
+    }
+    deviation = std::max(
+        deviation,
+        std::abs(chime::wigner::Wigner9J(j9[0], j9[1], j9[2], j9[3], j9[4],
+                                         j9[5], j9[6], j9[7], j9[8])
+                 - am::Wigner9J(j9[0], j9[1], j9[2], j9[3], j9[4], j9[5],
+                                j9[6], j9[7], j9[8])));
+  }
+  for (int rank = 0; rank <= 3; ++rank) {
+    for (int L = 0; L <= 12; ++L) {
+      for (int Lp = std::max(L - rank, 0); Lp <= L + rank; ++Lp) {
+        for (int S = 0; S <= 1; ++S) {
+          for (int J = std::abs(L - S); J <= L + S; ++J) {
+            for (int Jp = std::abs(Lp - S); Jp <= Lp + S; ++Jp) {
+              deviation = std::max(
+                  deviation,
+                  std::abs(
+                      chime::wigner::Wigner9J(L, S, J, rank, 1, rank, Lp, S,
+                                              Jp)
+                      - am::Wigner9J(L, S, J, rank, 1, rank, Lp, S, Jp)));
+            }
+          }
+        }
+      }
+    }
+  }
+  std::cout << "Largest deviation of the 9j symbols " << deviation << "\n";
+  passed &= (deviation < 1e-12);
+
+  const double tensor_product_deviation = TensorProductDeviation(6);
+  std::cout << "Largest deviation of the compile-time tensor products "
+            << tensor_product_deviation << "\n";
+  passed &= (tensor_product_deviation < 1e-12);
+
+  // Throughput on the allowed symbols of the ranks at the call sites of
+  // tprme.h, spin couplings with S <= 1 and orbital couplings with l <= 8.
+  std::vector<std::array<int, 9>> symbols;
+  for (const std::array<int, 3>& ranks :
+       {std::array<int, 3>{2, 1, 1}, {0, 1, 1}, {1, 0, 1}, {1, 2, 1},
+        {2, 2, 1}, {3, 2, 1}}) {
+    AppendCallSiteSymbols(ranks[0], ranks[1], ranks[2], 1, symbols);
+  }
+  for (const std::array<int, 3>& ranks :
+       {std::array<int, 3>{1, 1, 1}, {1, 1, 2}, {3, 1, 2}, {3, 1, 3},
+        {2, 0, 2}, {0, 0, 0}}) {
+    AppendCallSiteSymbols(ranks[0], ranks[1], ranks[2], 8, symbols);
+  }
+  int calls = 1 << 18, library_calls = 1 << 18;
+  double checksum, library_checksum;
+  const double seconds = Time9J(
+      [](int j1, int j2, int j3, int j4, int j5, int j6, int j7, int j8,
+         int j9) {
+        return chime::wigner::Wigner9J(j1, j2, j3, j4, j5, j6, j7, j8, j9);
+      },
+      symbols, calls, checksum);
+  const double library_seconds = Time9J(
+      [](int j1, int j2, int j3, int j4, int j5, int j6, int j7, int j8,
+         int j9) { return am::Wigner9J(j1, j2, j3, j4, j5, j6, j7, j8, j9); },
+      symbols, library_calls, library_checksum);
+  const double speedup =
+      (library_seconds / library_calls) / (seconds / calls);
+  std::cout << "Call-site 9j symbols " << symbols.size() << ", per second "
+            << calls / seconds << ", library "
+            << library_calls / library_seconds << ", speedup " << speedup
+            << " (checksums " << checksum << ", " << library_checksum
+            << ")\n";
+  if (speedup < 10) {
+    std::cout << "WARNING: speedup below 10 over the library\n";
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,148 @@
+#include "yukawa.h"
+
+#include <cfloat>
+
+#include "basis_func/ho.h"
+
+namespace chime {
+namespace radial {
+
+// Coefficients of rho^(l + 2j) in the normalized radial function
+//
+//   R_nl(rho) = N_nl rho^l L_n^(l + 1/2)(rho^2) exp(-rho^2 / 2),
+//   N_nl = sqrt(2 n! / Gamma(n + l + 3/2)).
+std::vector<long double> RadialPolynomial(const int& n, const int& l)
+{
+  const long double alpha = l + 0.5L;
+  const long double log_norm =
+      0.5L * (std::log(2.0L) + std::lgamma(n + 1.0L)
+              - std::lgamma(n + alpha + 1));
+  std::vector<long double> coefficients(n + 1);
+  for (int j = 0; j <= n; ++j) {
+    const long double log_binomial = std::lgamma(n + alpha + 1)
+                                     - std::lgamma(n - j + 1.0L)
+                                     - std::lgamma(alpha + j + 1)
+                                     - std::lgamma(j + 1.0L);
+    coefficients[j] =
+        ((j % 2) ? -1 : 1) * std::exp(log_norm + log_binomial);
+  }
+  return coefficients;
+}
+
+// Calculates the moments J_k(mu), k = 0, ..., kmax.
+std::vector<long double> YukawaMoments(const long double& mu, const int& kmax)
+{
+  // Start the downward recurrence at an order high enough for the
+  // trapezoidal rule to be exact to rounding, since the integrand vanishes
+  // to high order at t = 0.
+  const int top = std::max(kmax, 24) + 1;
+  std::vector<long double> moments(top + 1);
+  for (const int k : {top - 1, top}) {
+    const long double peak = (-mu + std::sqrt(mu * mu + 8.0L * k)) / 4;
+    const long double step = 0.01L;
+    const int num_steps = int((peak + 12) / step);
+    long double sum = 0;
+    for (int i = 1; i <= num_steps; ++i) {
+      const long double t = i * step;
+      sum += std::exp(k * std::log(t) - t * t - mu * t);
+    }
+    moments[k] = sum * step;
+  }
+  for (int k = top - 1; k >= 1; --k) {
+    moments[k - 1] = (2 * moments[k + 1] + mu * moments[k]) / k;
+  }
+  moments.resize(kmax + 1);
+  return moments;
+}
+
+YukawaIntegrator::YukawaIntegrator(const std::vector<YukawaKernel>& kernels,
+                                   const double& b, const int& nmax,
+                                   const int& lmax)
+{
+  polynomials_.resize(lmax + 1);
+  for (int l = 0; l <= lmax; ++l) {
+    for (int n = 0; n <= nmax; ++n) {
+      polynomials_[l].push_back(RadialPolynomial(n, l));
+    }
+  }
+
+  for (const auto& kernel : kernels) {
+    assert(kernel.min_power >= -2);
+    const int max_power =
+        kernel.min_power + int(kernel.coefficients.size()) - 1;
+    std::vector<long double> coefficients;
+    for (std::size_t i = 0; i < kernel.coefficients.size(); ++i) {
+      const int power = kernel.min_power + int(i);
+      coefficients.push_back(kernel.coefficients[i]
+                             * std::pow((long double)b, power));
+    }
+    coefficients_.push_back(coefficients);
+    min_powers_.push_back(kernel.min_power);
+    moments_.push_back(YukawaMoments((long double)kernel.mass * b,
+                                     2 + 2 * lmax + 4 * nmax + max_power));
+  }
+}
+
+double YukawaIntegrator::Integrate(const int& kernel, const int& bra_n,
+                                   const int& bra_l, const int& ket_n,
+                                   const int& ket_l, double& error) const
+{
+  const std::vector<long double>& bra_polynomial = polynomials_[bra_l][bra_n];
+  const std::vector<long double>& ket_polynomial = polynomials_[ket_l][ket_n];
+  const std::vector<long double>& coefficients = coefficients_[kernel];
+  const std::vector<long double>& moments = moments_[kernel];
+
+  // rho^2 R_n'l' R_nl = sum_s product_s rho^(2 + l' + l + 2s) exp(-rho^2).
+  std::vector<long double> product(bra_n + ket_n + 1, 0);
+  for (int i = 0; i <= bra_n; ++i) {
+    for (int j = 0; j <= ket_n; ++j) {
+      product[i + j] += bra_polynomial[i] * ket_polynomial[j];
+    }
+  }
+
+  long double sum = 0, magnitude = 0;
+  for (std::size_t s = 0; s < product.size(); ++s) {
+    for (std::size_t q = 0; q < coefficients.size(); ++q) {
+      const int power =
+          2 + bra_l + ket_l + 2 * int(s) + min_powers_[kernel] + int(q);
+      assert(power >= 0);
+      const long double term = product[s] * coefficients[q] * moments[power];
+      sum += term;
+      magnitude += std::abs(term);
+    }
+  }
+  // Rounding of the alternating sum dominates the error of the moments.
+  error = double(4 * LDBL_EPSILON * magnitude);
+  return double(sum);
+}
+
+std::vector<std::vector<int>> WaveFunctionPhases(const int& nmax,
+                                                 const int& lmax)
+{
+  // The sign of the first nonzero value on a short mesh at small rho, well
+  // before the first node, in the convention of WaveFunctionStore.
+  Eigen::ArrayXd rho(13);
+  for (int i = 0; i < rho.size(); ++i) {
+    rho(i) = std::pow(10., -3 + 0.25 * i);
+  }
+  std::vector<Eigen::ArrayXXd> ho_wfs;
+  basis_func::ho::WaveFunctionsUptoMaxL(ho_wfs, rho, nmax, lmax, 1.,
+                                        basis_func::Space::coordinate);
+  std::vector<std::vector<int>> phases(lmax + 1, std::vector<int>(nmax + 1));
+  for (int l = 0; l <= lmax; ++l) {
+    for (int n = 0; n <= nmax; ++n) {
+      int phase = 1;
+      for (int i = 0; i < rho.size(); ++i) {
+        if (ho_wfs[l](n, i) != 0) {
+          phase = (ho_wfs[l](n, i) > 0) ? 1 : -1;
+          break;
+        }
+      }
+      phases[l][n] = phase;
+    }
+  }
+  return phases;
+}
+
+}  // namespace radial
+}  // namespace chime
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ yukawa.h
+
+ Defines the analytic evaluation of unregulated radial integrals of Yukawa
+ type kernels between harmonic oscillator radial functions.
+
+ With rho = r / b the integrand of
+
+   int drho rho^2 R_n'l'(rho) exp(-m b rho) (b rho)^q R_nl(rho)
+
+ is a polynomial in rho times exp(-rho^2 - mu rho), mu = m b, so that the
+ integral is a finite sum over the moments
+
+   J_k(mu) = int_0^infinity dt t^k exp(-t^2 - mu t),
+
+   J_0(mu) = sqrt(pi) / 2 exp(mu^2 / 4) erfc(mu / 2),
+   2 J_{k+1}(mu) + mu J_k(mu) = k J_{k-1}(mu).
+
+ The recurrence is evaluated downwards, where all terms are positive, starting
+ from two moments of high order obtained by trapezoidal quadrature. The
+ polynomial sums alternate in sign, so their rounding error is estimated, and
+ integrals that would lose too many digits are left to the quadrature path.
+ The mesh and wave functions of the quadrature path are only set up if there
+ are such integrals. For the relative M1 kernels with b of about 1 fm, all
+ integrals are analytic up to Nmax = 20, while about 40% of them fall back to
+ quadrature at Nmax = 40, and about 70% at Nmax = 60. The builders report
+ this fraction.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#ifndef YUKAWA_H_
+#define YUKAWA_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "radial.h"
+
+namespace chime {
+namespace radial {
+
+// Kernel exp(-m r) sum_q c_q r^q, with q = min_power, min_power + 1, ...
+// The radial measure r^2 allows min_power >= -2.
+struct YukawaKernel {
+  double mass;
+  int min_power;
+  std::vector<double> coefficients;
+};
+
+// Evaluates the radial integrals of a set of Yukawa kernels between harmonic
+// oscillator radial functions with oscillator length b, for n <= nmax and
+// l <= lmax. The radial functions follow the phase convention in which they
+// are positive near the origin.
+class YukawaIntegrator {
+ public:
+  YukawaIntegrator(const std::vector<YukawaKernel>& kernels, const double& b,
+                   const int& nmax, const int& lmax);
+
+  // Calculates <n' l'| kernel |n l>.
+  //
+  // Arguments:
+  //   kernel (int): index of the kernel
+  //   bra_n, bra_l, ket_n, ket_l (int): radial quantum numbers
+  //   error (double, output): estimated absolute rounding error
+  // Returns:
+  //   integral
+  double Integrate(const int& kernel, const int& bra_n, const int& bra_l,
+                   const int& ket_n, const int& ket_l, double& error) const;
+
+ private:
+  // Coefficients of rho^(l + 2j) in R_nl(rho), indexed by [l][n][j].
+  std::vector<std::vector<std::vector<long double>>> polynomials_;
+
+  // Moments J_k(m b) for each kernel.
+  std::vector<std::vector<long double>> moments_;
+
+  // Kernel coefficients c_q b^q, and minimum powers.
+  std::vector<std::vector<long double>> coefficients_;
+  std::vector<int> min_powers_;
+};
+
+// Numbers of radial integral pairs (n' l', n l) of a table.
+struct YukawaTabulation {
+  std::size_t num_pairs = 0;
+  // Pairs calculated by quadrature.
+  std::size_t num_fallbacks = 0;
+};
+
+// Calculates all entries of `table` analytically. Entries whose estimated
+// rounding error exceeds `tolerance` times max(1, |integral|) are calculated
+// by quadrature instead, with the wave functions of
+// WaveFunctionStore::Open(params, ...) and the integrator returned by
+// `make_integrator(store)`. Both are only set up if there are such entries.
+//
+// Arguments:
+//   kernels (std::vector<YukawaKernel>): kernels, one per table kernel
+//   b (double): oscillator length
+//   params (RadialParameters): mesh of the quadrature fallback
+//   make_integrator (callable): FusedIntegrator<K> for a WaveFunctionStore
+//   table (RadialIntegralTable, output): radial integrals
+// Returns:
+//   numbers of pairs, and of pairs calculated by quadrature
+template <int K, typename MakeIntegrator>
+YukawaTabulation TabulateYukawaRadialIntegrals(
+    const std::vector<YukawaKernel>& kernels, const double& b,
+    const RadialParameters& params, const MakeIntegrator& make_integrator,
+    RadialIntegralTable& table, const double& tolerance = 1e-10);
+
+// Signs of the radial functions R_nl of WaveFunctionStore near the origin,
+// indexed by [l][n], for n <= nmax and l <= lmax.
+std::vector<std::vector<int>> WaveFunctionPhases(const int& nmax,
+                                                 const int& lmax);
+
+template <int K, typename MakeIntegrator>
+YukawaTabulation TabulateYukawaRadialIntegrals(
+    const std::vector<YukawaKernel>& kernels, const double& b,
+    const RadialParameters& params, const MakeIntegrator& make_integrator,
+    RadialIntegralTable& table, const double& tolerance)
+{
+  assert((table.num_kernels() == K) && (int(kernels.size()) == K));
+  int nmax = 0;
+  for (int l = 0; l <= table.lmax(); ++l) {
+    nmax = std::max(nmax, table.nmax(l));
+  }
+  const YukawaIntegrator yukawa(kernels, b, nmax, table.lmax());
+  const std::vector<std::vector<int>> phases =
+      WaveFunctionPhases(nmax, table.lmax());
+
+  struct Pair {
+    int bra_l, ket_l, bra_n, ket_n;
+  };
+  std::vector<Pair> pairs;
+  for (int bra_l = 0; bra_l <= table.lmax(); ++bra_l) {
+    for (int ket_l = 0; ket_l <= table.lmax(); ++ket_l) {
+      if (!table.HasBlock(bra_l, ket_l)) {
+        continue;
+      }
+      for (int bra_n = 0; bra_n <= table.nmax(bra_l); ++bra_n) {
+        for (int ket_n = 0; ket_n <= table.nmax(ket_l); ++ket_n) {
+          pairs.push_back({bra_l, ket_l, bra_n, ket_n});
+        }
+      }
+    }
+  }
+
+  std::vector<char> fallback(pairs.size(), 0);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (std::size_t index = 0; index < pairs.size(); ++index) {
+    const Pair& pair = pairs[index];
+    std::array<double, K> integrals;
+    for (int k = 0; k < K; ++k) {
+      double error;
+      integrals[k] = yukawa.Integrate(k, pair.bra_n, pair.bra_l, pair.ket_n,
+                                      pair.ket_l, error);
+      if (error > tolerance * std::max(1., std::abs(integrals[k]))) {
+        fallback[index] = 1;
+      }
+    }
+    if (fallback[index]) {
+      continue;
+    }
+    instrument::Count(instrument::Counter::kIntegrals, K);
+    const int phase =
+        phases[pair.bra_l][pair.bra_n] * phases[pair.ket_l][pair.ket_n];
+    for (int k = 0; k < K; ++k) {
+      table.mutable_block(k, pair.bra_l, pair.ket_l)(pair.bra_n, pair.ket_n) =
+          phase * integrals[k];
+    }
+  }
+
+  YukawaTabulation tabulation;
+  tabulation.num_pairs = pairs.size();
+  tabulation.num_fallbacks =
+      std::count(fallback.begin(), fallback.end(), char(1));
+  if (tabulation.num_fallbacks == 0) {
+    return tabulation;
+  }
+
+  const WaveFunctionStore store =
+      WaveFunctionStore::Open(params, nmax, table.lmax());
+  const FusedIntegrator<K> integrator = make_integrator(store);
+#pragma omp parallel for schedule(dynamic, 64)
+  for (std::size_t index = 0; index < pairs.size(); ++index) {
+    if (!fallback[index]) {
+      continue;
+    }
+    const Pair& pair = pairs[index];
+    const std::array<double, K> integrals =
+        integrator.Integrate(store.wave_functions(pair.bra_l).col(pair.bra_n),
+                             store.wave_functions(pair.ket_l).col(pair.ket_n));
+    for (int k = 0; k < K; ++k) {
+      table.mutable_block(k, pair.bra_l, pair.ket_l)(pair.bra_n, pair.ket_n) =
+          integrals[k];
+    }
+  }
+  return tabulation;
+}
+
+}  // namespace radial
+}  // namespace chime
+
+#endif
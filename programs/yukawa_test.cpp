@@ -0,0 +1,77 @@
+/*******************************************************************************
+ yukawa_test.cpp
+
+ Compares the analytic unregulated Yukawa radial integrals with the
+ quadrature path. The quadrature path drops the point r = 0, where the
+ integrand of the 1/r^2 kernel between two s waves is finite, so that kernel
+ only agrees to first order in the mesh spacing.
+
+ Language: C++14
+ Soham Pal
+ Iowa State University
+*******************************************************************************/
+
+#include <cmath>
+#include <iostream>
+
+#include "constants.h"
+#include "yukawa.h"
+
+int main()
+{
+  const double mPi = chime::constants::pion_mass_fm;
+  const double b = 1.4;
+  const int nmax = 10, lmax = 10;
+
+  // Kernels of the 2n NLO magnetic moment operators: exp(-mr),
+  // exp(-mr)(1 + 3 (1 + mr) / (mr)^2) and (1 + mr) exp(-mr) / (mr).
+  const std::vector<chime::radial::YukawaKernel> kernels{
+      {mPi, 0, {1}},
+      {mPi, -2, {3 / (mPi * mPi), 3 / mPi, 1}},
+      {mPi, -1, {1 / mPi, 1}}};
+
+  chime::radial::RadialParameters params;
+  params.npts = 6001;
+  const chime::radial::WaveFunctionStore store =
+      chime::radial::WaveFunctionStore::Open(params, nmax, lmax);
+  auto make_integrator = [&](const chime::radial::WaveFunctionStore& store) {
+    const Eigen::ArrayXd rho = store.rho();
+    const Eigen::ArrayXd mpir = mPi * b * rho;
+    const Eigen::ArrayXd expmpir = Eigen::exp(-mpir);
+    return chime::radial::FusedIntegrator<3>(
+        store.x(), rho * rho * store.jacobian(),
+        {{expmpir, expmpir * (1. + 3 * (1. + mpir) / mpir.square()),
+          (1. + mpir) * expmpir / mpir}});
+  };
+  const chime::radial::FusedIntegrator<3> integrator = make_integrator(store);
+
+  const std::vector<int> nmax_by_l(lmax + 1, nmax);
+  chime::radial::RadialIntegralTable analytic(3, 2, nmax_by_l);
+  chime::radial::RadialIntegralTable quadrature(3, 2, nmax_by_l);
+  const chime::radial::YukawaTabulation tabulation =
+      chime::radial::TabulateYukawaRadialIntegrals<3>(
+          kernels, b, params, make_integrator, analytic);
+  chime::radial::TabulateRadialIntegrals(integrator, store, quadrature);
+
+  std::cout << "Quadrature fallbacks: " << tabulation.num_fallbacks << " of "
+            << tabulation.num_pairs << "\n";
+  for (int kernel = 0; kernel < 3; ++kernel) {
+    double max_difference = 0;
+    for (int bra_l = 0; bra_l <= lmax; ++bra_l) {
+      for (int ket_l = 0; ket_l <= lmax; ++ket_l) {
+        if (analytic.HasBlock(bra_l, ket_l)) {
+          max_difference = std::max(
+              max_difference, (analytic.block(kernel, bra_l, ket_l)
+                               - quadrature.block(kernel, bra_l, ket_l))
+                                  .cwiseAbs()
+                                  .maxCoeff());
+        }
+      }
+    }
+    std::cout << "Kernel " << kernel
+              << " max difference analytic - quadrature: " << max_difference
+              << "\n";
+  }
+  std::cout << "<0 0| exp(-mr) |0 0> analytic " << analytic(0, 0, 0, 0, 0)
+            << " quadrature " << quadrature(0, 0, 0, 0, 0) << "\n";
+}